@@ -0,0 +1,601 @@
+#include "AsyncIO.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "threadpool.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef TLGML_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+namespace gistool {
+
+bool parse_io_backend(const std::string& name, IoBackend& backend) {
+  if (name == "sync") {
+    backend = IoBackend::Sync;
+  } else if (name == "pread") {
+    backend = IoBackend::Pread;
+  } else if (name == "uring") {
+    backend = IoBackend::Uring;
+  } else if (name == "auto") {
+    backend = IoBackend::Auto;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* to_string(IoBackend backend) {
+  switch (backend) {
+    case IoBackend::Sync:
+      return "sync";
+    case IoBackend::Pread:
+      return "pread";
+    case IoBackend::Uring:
+      return "uring";
+    case IoBackend::Auto:
+      return "auto";
+  }
+  return "unknown";
+}
+
+#ifdef _WIN32
+std::error_code read_file(const fs::path& path, IoBuffer& buffer) {
+  std::ifstream stream(path, std::ios::binary | std::ios::ate);
+  if (!stream) return std::make_error_code(std::errc::no_such_file_or_directory);
+  auto size = static_cast<size_t>(stream.tellg());
+  stream.seekg(0);
+  buffer.resize(size + 1);
+  stream.read(buffer.data(), static_cast<std::streamsize>(size));
+  if (!stream) return std::make_error_code(std::errc::io_error);
+  buffer[size] = 0;
+  return {};
+}
+
+std::error_code write_file(const fs::path& path, const void* data,
+                           std::size_t size) {
+  HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr,
+                         CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (h == INVALID_HANDLE_VALUE) {
+    return std::error_code(GetLastError(), std::system_category());
+  }
+  const char* p = static_cast<const char*>(data);
+  std::error_code ec;
+  while (size > 0 && !ec) {
+    const DWORD chunk = static_cast<DWORD>(
+        std::min<std::size_t>(size, std::size_t{1} << 30));
+    DWORD n = 0;
+    if (!WriteFile(h, p, chunk, &n, nullptr)) {
+      ec = std::error_code(GetLastError(), std::system_category());
+    } else if (n == 0) {
+      ec = std::make_error_code(std::errc::io_error);
+    }
+    p += n;
+    size -= n;
+  }
+  if (!ec && !FlushFileBuffers(h)) {
+    ec = std::error_code(GetLastError(), std::system_category());
+  }
+  CloseHandle(h);
+  return ec;
+}
+
+std::error_code sync_file(const fs::path& path) {
+  HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (h == INVALID_HANDLE_VALUE) {
+    return std::error_code(GetLastError(), std::system_category());
+  }
+  std::error_code ec;
+  if (!FlushFileBuffers(h)) {
+    ec = std::error_code(GetLastError(), std::system_category());
+  }
+  CloseHandle(h);
+  return ec;
+}
+
+std::error_code sync_directory(const fs::path&) { return {}; }
+#else
+namespace {
+std::error_code last_error() {
+  return std::error_code(errno, std::system_category());
+}
+}  // namespace
+
+std::error_code read_file(const fs::path& path, IoBuffer& buffer) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return last_error();
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    auto ec = last_error();
+    ::close(fd);
+    return ec;
+  }
+  auto size = static_cast<size_t>(st.st_size);
+  buffer.resize(size + 1);
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = ::pread(fd, buffer.data() + done, size - done,
+                        static_cast<off_t>(done));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      auto ec = n < 0 ? last_error() : std::make_error_code(std::errc::io_error);
+      ::close(fd);
+      return ec;
+    }
+    done += static_cast<size_t>(n);
+  }
+  buffer[size] = 0;
+  ::close(fd);
+  return {};
+}
+
+std::error_code write_file(const fs::path& path, const void* data,
+                           std::size_t size) {
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) return last_error();
+  const char* p = static_cast<const char*>(data);
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = ::pwrite(fd, p + done, size - done, static_cast<off_t>(done));
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) {
+      auto ec = last_error();
+      ::close(fd);
+      return ec;
+    }
+    done += static_cast<size_t>(n);
+  }
+  if (::fdatasync(fd) != 0) {
+    auto ec = last_error();
+    ::close(fd);
+    return ec;
+  }
+  if (::close(fd) != 0) return last_error();
+  return {};
+}
+
+std::error_code sync_file(const fs::path& path) {
+  int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd < 0) return last_error();
+  std::error_code ec;
+  if (::fdatasync(fd) != 0) ec = last_error();
+  ::close(fd);
+  return ec;
+}
+
+std::error_code sync_directory(const fs::path& path) {
+  int fd = ::open(path.empty() ? "." : path.c_str(),
+                  O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) return last_error();
+  std::error_code ec;
+  if (::fsync(fd) != 0) ec = last_error();
+  ::close(fd);
+  return ec;
+}
+#endif
+
+fs::path partial_path(const fs::path& output) {
+  fs::path partial = output;
+  partial += ".partial";
+  return partial;
+}
+
+namespace {
+
+/**
+ * @brief Group commit of directory fsyncs. Outputs land in few directories,
+ * many at a time; a caller whose rename happened before a running fsync of
+ * the same directory started waits for the next one, which then covers every
+ * rename made meanwhile.
+ */
+class DirectorySync {
+ public:
+  std::error_code sync(const fs::path& dir) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto& state = dirs_[dir.string()];
+    const auto ticket = ++state.requested;
+    while (state.synced < ticket) {
+      if (state.running) {
+        cv_.wait(lock);
+        continue;
+      }
+      state.running = true;
+      const auto covered = state.requested;
+      lock.unlock();
+      auto ec = sync_directory(dir);
+      lock.lock();
+      state.running = false;
+      state.synced = covered;
+      state.error = ec;
+      cv_.notify_all();
+    }
+    return state.error;
+  }
+
+ private:
+  struct State {
+    std::uint64_t requested = 0;
+    std::uint64_t synced = 0;
+    bool running = false;
+    std::error_code error;
+  };
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::unordered_map<std::string, State> dirs_;
+};
+
+}  // namespace
+
+std::error_code commit_file(const fs::path& partial, const fs::path& output) {
+  static DirectorySync directories;
+  std::error_code ec;
+  fs::rename(partial, output, ec);
+  if (ec) return ec;
+  return directories.sync(output.parent_path());
+}
+
+namespace {
+
+/**
+ * @brief Portable backend: blocking pread/pwrite on queue_depth threads.
+ */
+class PreadFileIO : public AsyncFileIO {
+ public:
+  explicit PreadFileIO(unsigned queue_depth) : pool_(queue_depth) {}
+
+  void read(const fs::path& path, ReadCallback callback) override {
+    pool_.post([path, callback = std::move(callback)]() {
+      IoBuffer buffer;
+      auto ec = read_file(path, buffer);
+      callback(std::move(buffer), ec);
+    });
+  }
+
+  void write(const fs::path& path, ByteBuffer data, std::size_t size,
+             WriteCallback callback) override {
+    auto shared = std::make_shared<ByteBuffer>(std::move(data));
+    pool_.post([path, shared, size, callback = std::move(callback)]() {
+      auto ec = write_file(path, shared->get(), size);
+      shared->reset();
+      callback(ec);
+    });
+  }
+
+  IoBackend backend() const override { return IoBackend::Pread; }
+
+ private:
+  concurrent::ThreadPoolExecutor pool_;
+};
+
+#ifdef TLGML_HAVE_LIBURING
+/**
+ * @brief io_uring backend.
+ *
+ * A single thread owns the ring and keeps up to queue_depth requests in
+ * flight. Nothing blocks that thread: files are opened (openat) and sized
+ * (statx) through the ring, and each write is linked to an fdatasync
+ * (IORING_FSYNC_DATASYNC) which only runs once the write completed in full.
+ * Callbacks run as requests finish.
+ */
+class UringFileIO : public AsyncFileIO {
+  enum class Op { Open, Stat, Transfer, Sync };
+
+  struct Request;
+
+  /// user_data of an SQE: which step of which request completed.
+  struct Tag {
+    Request* request;
+    Op op;
+  };
+
+  struct Request {
+    bool is_write = false;
+    fs::path path;
+    int fd = -1;
+    IoBuffer buffer;
+    ByteBuffer data{nullptr, ::free};
+    std::size_t size = 0;
+    std::size_t done = 0;
+    struct statx stx;
+    /// CQEs still expected for the SQEs queued last.
+    unsigned outstanding = 0;
+    std::error_code error;
+    /// The last write came back short; its linked fdatasync was cancelled.
+    bool short_write = false;
+    Tag open_tag{this, Op::Open};
+    Tag stat_tag{this, Op::Stat};
+    Tag transfer_tag{this, Op::Transfer};
+    Tag sync_tag{this, Op::Sync};
+    ReadCallback read_callback;
+    WriteCallback write_callback;
+  };
+
+ public:
+  explicit UringFileIO(unsigned queue_depth) : depth_(queue_depth) {
+    // A write and its fdatasync take two SQEs.
+    ok_ = io_uring_queue_init(2 * depth_, &ring_, 0) == 0;
+    if (ok_) thread_ = std::thread(&UringFileIO::loop, this);
+  }
+
+  ~UringFileIO() override {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    if (thread_.joinable()) thread_.join();
+    if (ok_) io_uring_queue_exit(&ring_);
+  }
+
+  bool ok() const { return ok_; }
+
+  void read(const fs::path& path, ReadCallback callback) override {
+    auto r = std::make_unique<Request>();
+    r->path = path;
+    r->read_callback = std::move(callback);
+    enqueue(std::move(r));
+  }
+
+  void write(const fs::path& path, ByteBuffer data, std::size_t size,
+             WriteCallback callback) override {
+    auto r = std::make_unique<Request>();
+    r->is_write = true;
+    r->path = path;
+    r->data = std::move(data);
+    r->size = size;
+    r->write_callback = std::move(callback);
+    enqueue(std::move(r));
+  }
+
+  IoBackend backend() const override { return IoBackend::Uring; }
+
+ private:
+  void enqueue(std::unique_ptr<Request> r) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_.push_back(std::move(r));
+    }
+    cv_.notify_one();
+  }
+
+  void loop() {
+    unsigned inflight = 0;
+    for (;;) {
+      std::deque<std::unique_ptr<Request>> batch;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (inflight == 0) {
+          cv_.wait(lock, [&] { return stop_ || !pending_.empty(); });
+          if (stop_ && pending_.empty()) return;
+        }
+        while (!pending_.empty() && inflight + batch.size() < depth_) {
+          batch.push_back(std::move(pending_.front()));
+          pending_.pop_front();
+        }
+      }
+
+      for (auto& r : batch) {
+        queue_open(r.release());
+        ++inflight;
+      }
+      io_uring_submit(&ring_);
+
+      if (inflight == 0) continue;
+      struct io_uring_cqe* cqe = nullptr;
+      // Wake up regularly to pick up requests queued meanwhile.
+      struct __kernel_timespec ts = {0, 1000 * 1000};
+      io_uring_wait_cqe_timeout(&ring_, &cqe, &ts);
+
+      unsigned head;
+      unsigned seen = 0;
+      io_uring_for_each_cqe(&ring_, head, cqe) {
+        ++seen;
+        auto tag = static_cast<Tag*>(io_uring_cqe_get_data(cqe));
+        if (!on_completion(*tag, cqe->res)) --inflight;
+      }
+      io_uring_cq_advance(&ring_, seen);
+    }
+  }
+
+  /**
+   * @brief An SQE, submitting queued ones first when fewer than n are free,
+   * so the n SQEs of a linked chain go to the kernel together.
+   */
+  struct io_uring_sqe* get_sqe(unsigned n = 1) {
+    if (io_uring_sq_space_left(&ring_) < n) io_uring_submit(&ring_);
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+    while (!sqe) {
+      io_uring_submit(&ring_);
+      sqe = io_uring_get_sqe(&ring_);
+    }
+    return sqe;
+  }
+
+  void queue_open(Request* r) {
+    auto sqe = get_sqe();
+    if (r->is_write) {
+      io_uring_prep_openat(sqe, AT_FDCWD, r->path.c_str(),
+                           O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    } else {
+      io_uring_prep_openat(sqe, AT_FDCWD, r->path.c_str(),
+                           O_RDONLY | O_CLOEXEC, 0);
+    }
+    io_uring_sqe_set_data(sqe, &r->open_tag);
+    r->outstanding = 1;
+  }
+
+  void queue_stat(Request* r) {
+    auto sqe = get_sqe();
+    io_uring_prep_statx(sqe, r->fd, "", AT_EMPTY_PATH, STATX_SIZE, &r->stx);
+    io_uring_sqe_set_data(sqe, &r->stat_tag);
+    r->outstanding = 1;
+  }
+
+  void queue_read(Request* r) {
+    auto sqe = get_sqe();
+    io_uring_prep_read(sqe, r->fd, r->buffer.data() + r->done,
+                       static_cast<unsigned>(r->size - r->done), r->done);
+    io_uring_sqe_set_data(sqe, &r->transfer_tag);
+    r->outstanding = 1;
+  }
+
+  /**
+   * @brief The rest of the data, then fdatasync. A short or failed write
+   * breaks the link and the fdatasync completes with -ECANCELED.
+   */
+  void queue_write(Request* r) {
+    r->short_write = false;
+    r->outstanding = 0;
+    if (r->done < r->size) {
+      auto sqe = get_sqe(2);
+      io_uring_prep_write(sqe, r->fd, r->data.get() + r->done,
+                          static_cast<unsigned>(r->size - r->done), r->done);
+      io_uring_sqe_set_flags(sqe, IOSQE_IO_LINK);
+      io_uring_sqe_set_data(sqe, &r->transfer_tag);
+      ++r->outstanding;
+    }
+    auto sqe = get_sqe();
+    io_uring_prep_fsync(sqe, r->fd, IORING_FSYNC_DATASYNC);
+    io_uring_sqe_set_data(sqe, &r->sync_tag);
+    ++r->outstanding;
+  }
+
+  /**
+   * @brief Returns true while the request is still in flight.
+   */
+  bool on_completion(const Tag& tag, int res) {
+    Request* r = tag.request;
+    switch (tag.op) {
+      case Op::Open:
+        if (res < 0) {
+          r->error = std::error_code(-res, std::system_category());
+        } else {
+          r->fd = res;
+        }
+        break;
+      case Op::Stat:
+        if (res < 0) {
+          r->error = std::error_code(-res, std::system_category());
+        } else {
+          r->size = static_cast<size_t>(r->stx.stx_size);
+          r->buffer.resize(r->size + 1);
+        }
+        break;
+      case Op::Transfer:
+        if (res < 0) {
+          if (!r->error) r->error = std::error_code(-res, std::system_category());
+        } else if (res == 0) {
+          if (!r->error) r->error = std::make_error_code(std::errc::io_error);
+        } else {
+          r->done += static_cast<size_t>(res);
+          r->short_write = r->is_write && r->done < r->size;
+        }
+        break;
+      case Op::Sync:
+        if (res == -ECANCELED && (r->short_write || r->error)) break;
+        if (res < 0 && !r->error) {
+          r->error = std::error_code(-res, std::system_category());
+        }
+        break;
+    }
+    if (--r->outstanding > 0) return true;
+
+    // Every CQE of the last step is in; move on to the next one.
+    if (r->error) {
+      finish(r);
+      return false;
+    }
+    switch (tag.op) {
+      case Op::Open:
+        if (r->is_write) {
+          queue_write(r);
+        } else {
+          queue_stat(r);
+        }
+        return true;
+      case Op::Stat:
+        if (r->size == 0) break;
+        queue_read(r);
+        return true;
+      case Op::Transfer:
+      case Op::Sync:
+        if (r->is_write && r->short_write) {
+          queue_write(r);
+          return true;
+        }
+        if (!r->is_write && r->done < r->size) {
+          queue_read(r);
+          return true;
+        }
+        break;
+    }
+    finish(r);
+    return false;
+  }
+
+  void finish(Request* r) {
+    std::unique_ptr<Request> owned(r);
+    auto ec = r->error;
+    if (r->fd >= 0 && ::close(r->fd) != 0 && !ec) {
+      ec = std::error_code(errno, std::system_category());
+    }
+    if (r->is_write) {
+      r->data.reset();
+      r->write_callback(ec);
+    } else {
+      if (ec) {
+        r->buffer.clear();
+      } else {
+        r->buffer[r->size] = 0;
+      }
+      r->read_callback(std::move(r->buffer), ec);
+    }
+  }
+
+  struct io_uring ring_;
+  bool ok_ = false;
+  const unsigned depth_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::unique_ptr<Request>> pending_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+#endif
+
+}  // namespace
+
+std::unique_ptr<AsyncFileIO> AsyncFileIO::create(IoBackend backend,
+                                                 unsigned queue_depth) {
+  if (backend == IoBackend::Sync) return nullptr;
+  if (queue_depth == 0) queue_depth = 32;
+#ifdef TLGML_HAVE_LIBURING
+  if (backend == IoBackend::Uring || backend == IoBackend::Auto) {
+    auto uring = std::make_unique<UringFileIO>(queue_depth);
+    if (uring->ok()) return uring;
+  }
+#endif
+  return std::make_unique<PreadFileIO>(queue_depth);
+}
+
+}  // namespace gistool
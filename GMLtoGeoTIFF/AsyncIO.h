@@ -0,0 +1,97 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+
+#include "numa_alloc.h"
+
+namespace gistool {
+namespace fs = std::filesystem;
+
+/// Zero terminated file contents, ready for rapidxml.
+using IoBuffer = concurrent::local_vector<char>;
+
+/// Bytes to be written, released through the stored deleter.
+using ByteBuffer = std::unique_ptr<unsigned char, void (*)(void*)>;
+
+enum class IoBackend {
+  Sync,   /// Workers read and GDAL writes directly; no I/O stage.
+  Pread,  /// Blocking reads/writes on a dedicated thread pool.
+  Uring,  /// io_uring with many requests in flight (Linux, liburing).
+  Auto,   /// Uring when available, Pread otherwise.
+};
+
+bool parse_io_backend(const std::string& name, IoBackend& backend);
+const char* to_string(IoBackend backend);
+
+/**
+ * @brief Read the whole file into a zero terminated buffer.
+ */
+std::error_code read_file(const fs::path& path, IoBuffer& buffer);
+
+/**
+ * @brief Write size bytes to path, replacing it, and flush them to disk.
+ */
+std::error_code write_file(const fs::path& path, const void* data,
+                           std::size_t size);
+
+/**
+ * @brief Flush a file written by someone else (GDAL) to disk.
+ */
+std::error_code sync_file(const fs::path& path);
+
+/**
+ * @brief Flush a directory's entries, making renames into it durable. A no-op
+ * on Windows, where NTFS journals renames itself.
+ */
+std::error_code sync_directory(const fs::path& path);
+
+/**
+ * @brief Temporary name an output is written under until it is complete.
+ */
+fs::path partial_path(const fs::path& output);
+
+/**
+ * @brief Atomically move a completed partial file to its final name and
+ * flush the directory entry. Concurrent commits into one directory share
+ * its fsync.
+ */
+std::error_code commit_file(const fs::path& partial, const fs::path& output);
+
+/**
+ * @brief Asynchronous whole-file reads and writes.
+ *
+ * Callbacks run on the I/O backend's threads and should only hand the buffer
+ * over to the conversion pool.
+ */
+class AsyncFileIO {
+ public:
+  using ReadCallback = std::function<void(IoBuffer&&, std::error_code)>;
+  using WriteCallback = std::function<void(std::error_code)>;
+
+  /**
+   * @brief Create a backend. Auto and an unavailable Uring fall back to
+   * Pread. Returns nullptr for Sync.
+   *
+   * @param queue_depth requests kept in flight.
+   */
+  static std::unique_ptr<AsyncFileIO> create(IoBackend backend,
+                                             unsigned queue_depth);
+
+  virtual ~AsyncFileIO() = default;
+
+  virtual void read(const fs::path& path, ReadCallback callback) = 0;
+  virtual void write(const fs::path& path, ByteBuffer data, std::size_t size,
+                     WriteCallback callback) = 0;
+
+  virtual IoBackend backend() const = 0;
+};
+
+}  // namespace gistool
+
+#endif  // !ASYNC_IO_H
@@ -0,0 +1,145 @@
+#include "ConvertResult.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+namespace gistool {
+
+const char* to_string(ConvertStatus status) {
+  switch (status) {
+    case ConvertStatus::Ok:
+      return "ok";
+    case ConvertStatus::OpenFailed:
+      return "open_failed";
+    case ConvertStatus::ParseFailed:
+      return "parse_failed";
+    case ConvertStatus::InvalidHeader:
+      return "invalid_header";
+    case ConvertStatus::WriteFailed:
+      return "write_failed";
+    case ConvertStatus::TooLarge:
+      return "too_large";
+  }
+  return "unknown";
+}
+
+void ResultCollector::add(ConvertResult result) {
+  if (observer_) observer_(result);
+  if (result.skipped) {
+    ++skipped_;
+  } else if (result.ok()) {
+    ++succeeded_;
+  } else {
+    ++failed_;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto key = result.source.string();
+  auto found = index_.find(key);
+  if (found == index_.end()) {
+    index_.emplace(std::move(key), results_.size());
+    results_.push_back(std::move(result));
+    return;
+  }
+  /// The replaced attempt still read and wrote its bytes.
+  auto& previous = results_[found->second];
+  if (!previous.ok()) --failed_;
+  released_bytes_read_ += previous.bytes_read;
+  released_bytes_written_ += previous.bytes_written;
+  released_seconds_ += previous.seconds;
+  previous = std::move(result);
+}
+
+void ResultCollector::reindex() {
+  index_.clear();
+  for (std::size_t i = 0; i < results_.size(); ++i) {
+    index_.emplace(results_[i].source.string(), i);
+  }
+}
+
+void ResultCollector::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  results_.clear();
+  index_.clear();
+  released_bytes_read_ = 0;
+  released_bytes_written_ = 0;
+  released_seconds_ = 0.0;
+  succeeded_ = 0;
+  failed_ = 0;
+  skipped_ = 0;
+}
+
+void ResultCollector::release_succeeded() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = std::stable_partition(results_.begin(), results_.end(),
+                                  [](const auto& r) { return !r.ok(); });
+  for (auto r = it; r != results_.end(); ++r) {
+    released_bytes_read_ += r->bytes_read;
+    released_bytes_written_ += r->bytes_written;
+    released_seconds_ += r->seconds;
+  }
+  results_.erase(it, results_.end());
+  reindex();
+}
+
+std::vector<ConvertResult> ResultCollector::take_retryable(
+    std::uint32_t max_attempts) {
+  std::vector<ConvertResult> ret;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = std::stable_partition(
+      results_.begin(), results_.end(), [max_attempts](const auto& r) {
+        return r.ok() || !r.transient() || r.attempts >= max_attempts;
+      });
+  std::move(it, results_.end(), std::back_inserter(ret));
+  results_.erase(it, results_.end());
+  reindex();
+  failed_ -= ret.size();
+  return ret;
+}
+
+std::vector<ConvertResult> ResultCollector::snapshot() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return results_;
+}
+
+std::vector<ConvertResult> ResultCollector::failures() const {
+  std::vector<ConvertResult> ret;
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::copy_if(results_.begin(), results_.end(), std::back_inserter(ret),
+               [](const auto& r) { return !r.ok(); });
+  return ret;
+}
+
+void ResultCollector::print_summary(std::ostream& os) const {
+  std::uint64_t bytes_read = 0, bytes_written = 0;
+  double seconds = 0.0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bytes_read = released_bytes_read_;
+    bytes_written = released_bytes_written_;
+    seconds = released_seconds_;
+    for (const auto& r : results_) {
+      bytes_read += r.bytes_read;
+      bytes_written += r.bytes_written;
+      seconds += r.seconds;
+    }
+  }
+  os << "Converted: " << succeeded_ << ", Skipped: " << skipped_
+     << ", Failed: " << failed_ << std::endl;
+  os << "Read " << bytes_read << " bytes, wrote " << bytes_written
+     << " bytes, " << std::fixed << std::setprecision(3) << seconds
+     << " s in tasks" << std::endl;
+}
+
+bool ResultCollector::write_failures(const fs::path& path) const {
+  std::ofstream ofs(path, std::ios::binary);
+  if (!ofs) return false;
+  ofs << "source\tstatus\tattempts\tmessage\n";
+  for (const auto& r : failures()) {
+    ofs << r.source.string() << '\t' << to_string(r.status) << '\t'
+        << r.attempts << '\t' << r.message << '\n';
+  }
+  return static_cast<bool>(ofs);
+}
+
+}  // namespace gistool
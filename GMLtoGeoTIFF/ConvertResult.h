@@ -0,0 +1,153 @@
+#ifndef CONVERT_RESULT_H
+#define CONVERT_RESULT_H
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace gistool {
+namespace fs = std::filesystem;
+
+enum class ConvertStatus {
+  Ok,
+  OpenFailed,     /// Input could not be opened or read.
+  ParseFailed,    /// rapidxml rejected the document.
+  InvalidHeader,  /// Envelope / GridEnvelope / tupleList missing or broken.
+  WriteFailed,    /// GDAL could not create or write the output.
+  TooLarge,       /// Needs more memory than could be allocated.
+};
+
+const char* to_string(ConvertStatus status);
+
+/**
+ * @brief A source queued for conversion.
+ */
+struct SourceFile {
+  fs::path path;
+  std::uint64_t size = 0;
+  std::int64_t mtime = 0;
+  /// When non-zero, the conversion is skipped if the content hashes to this
+  /// value and the output already exists.
+  std::uint64_t expected_hash = 0;
+};
+
+/**
+ * @brief Outcome of converting one source file.
+ */
+struct ConvertResult {
+  fs::path source;
+  fs::path output;
+  ConvertStatus status = ConvertStatus::Ok;
+  std::string message;
+  std::uint64_t bytes_read = 0;
+  std::uint64_t bytes_written = 0;
+  double seconds = 0.0;
+  std::uint32_t attempts = 1;
+  std::uint64_t source_size = 0;
+  std::int64_t source_mtime = 0;
+  std::uint64_t content_hash = 0;
+  /// Output was already up to date; nothing was written.
+  bool skipped = false;
+
+  bool ok() const { return status == ConvertStatus::Ok; }
+
+  /**
+   * @brief I/O failures may succeed on a later attempt (network shares,
+   * transient ENOSPC, ...). Broken documents and inputs too large to
+   * allocate never do.
+   */
+  bool transient() const {
+    return status == ConvertStatus::OpenFailed ||
+           status == ConvertStatus::WriteFailed;
+  }
+};
+
+/**
+ * @brief Thread-safe sink for per-file results.
+ *
+ * Workers push their result when they finish, so the producer never waits on
+ * individual futures. Only the latest result per source is kept: a source
+ * reported again (a retry, or a file rewritten under --watch) replaces its
+ * earlier result, and a replaced failure no longer counts as failed.
+ */
+class ResultCollector {
+ public:
+  using Observer = std::function<void(const ConvertResult&)>;
+
+  void add(ConvertResult result);
+
+  /**
+   * @brief Called from the worker for every result before it is stored.
+   * Set before any work is queued.
+   */
+  void set_observer(Observer observer) { observer_ = std::move(observer); }
+
+  std::size_t succeeded() const { return succeeded_; }
+  std::size_t failed() const { return failed_; }
+  std::size_t skipped() const { return skipped_; }
+
+  /**
+   * @brief Count a source that was skipped without being queued.
+   */
+  void add_skipped() { ++skipped_; }
+
+  std::vector<ConvertResult> snapshot() const;
+
+  /**
+   * @brief Drop the stored results and counters, for collectors reused
+   * across batches. Not while work is queued.
+   */
+  void clear();
+
+  /**
+   * @brief Drop the stored results that succeeded or were skipped, once the
+   * caller has recorded them elsewhere, so a long running collector (--watch)
+   * keeps only failures. Counters and summary totals are kept. A failure
+   * stays until its source is reported again.
+   */
+  void release_succeeded();
+
+  /**
+   * @brief Remove and return failed results which are worth another attempt.
+   */
+  std::vector<ConvertResult> take_retryable(std::uint32_t max_attempts);
+
+  /**
+   * @brief The failed results, one per source.
+   */
+  std::vector<ConvertResult> failures() const;
+
+  void print_summary(std::ostream& os) const;
+
+  /**
+   * @brief Write a tab separated report of all failures. Returns false when
+   * the report could not be written.
+   */
+  bool write_failures(const fs::path& path) const;
+
+ private:
+  void reindex();
+
+  mutable std::mutex mutex_;
+  Observer observer_;
+  std::vector<ConvertResult> results_;
+  /// Source path to position in results_.
+  std::unordered_map<std::string, std::size_t> index_;
+  /// Totals of released results, for print_summary.
+  std::uint64_t released_bytes_read_ = 0;
+  std::uint64_t released_bytes_written_ = 0;
+  double released_seconds_ = 0.0;
+  std::atomic<std::size_t> succeeded_{0};
+  std::atomic<std::size_t> failed_{0};
+  std::atomic<std::size_t> skipped_{0};
+};
+
+}  // namespace gistool
+
+#endif  // !CONVERT_RESULT_H
@@ -0,0 +1,219 @@
+#include "ConverterManager.h"
+
+#include <new>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include "GdalWorker.h"
+#include "GmlDoc.h"
+#include "MemoryStats.h"
+#include "Metrics.h"
+#include "ZipArchive.h"
+
+namespace gistool {
+namespace {
+
+/// Result for an exception escaping a conversion step. Tasks must not throw:
+/// the executor would terminate the process.
+ConvertResult exception_result(const fs::path& source,
+                               const std::exception& e) {
+  ConvertResult r;
+  r.source = source;
+  r.message = e.what();
+  if (dynamic_cast<const std::bad_alloc*>(&e) ||
+      dynamic_cast<const std::length_error*>(&e)) {
+    // The same input fails the same way on every attempt.
+    r.status = ConvertStatus::TooLarge;
+  } else if (dynamic_cast<const std::system_error*>(&e)) {
+    // filesystem_error and other OS errors: worth retrying.
+    r.status = ConvertStatus::WriteFailed;
+  } else {
+    // runtime_error and the like come from the document's contents.
+    r.status = ConvertStatus::InvalidHeader;
+  }
+  return r;
+}
+
+}  // namespace
+
+std::uint32_t ConverterOptions::resolved_threads() const {
+  return thread_count ? thread_count : std::thread::hardware_concurrency();
+}
+
+std::uint32_t ConverterOptions::resolved_inflight() const {
+  return max_inflight ? max_inflight : 4 * resolved_threads();
+}
+
+ConverterManager::ConverterManager(const ConverterOptions& opts,
+                                   ResultCollector& collector)
+    : options(opts),
+      spatialref(OGRSpatialReference()),
+      results(collector),
+      inflight(opts.resolved_inflight()),
+      inflight_bytes(opts.max_inflight_bytes),
+      executor(std::make_unique<concurrent::ThreadPoolExecutor>(
+          opts.resolved_threads(), opts.pin_threads)),
+      io(AsyncFileIO::create(opts.io_backend, opts.io_depth)) {
+  this->spatialref.importFromEPSG(options.epsg);
+}
+
+ConverterManager::~ConverterManager() {
+  wait();
+  // Stop the I/O stage first; its callbacks post into the executor.
+  io.reset();
+  executor.reset();
+}
+
+void ConverterManager::add_queue(SourceFile source, std::uint32_t attempts) {
+  inflight.acquire();
+  const std::uint64_t charged =
+      options.max_inflight_bytes ? estimate_task_bytes(source.size) : 0;
+  if (charged) inflight_bytes.acquire(charged);
+  Job job{std::move(source), attempts, std::chrono::steady_clock::now(),
+          charged};
+  if (!io) {
+    executor->post([this, job = std::move(job)]() mutable {
+      convert_sync(job);
+    });
+    return;
+  }
+  if (is_archive_member(job.source.path)) {
+    // Members are inflated on the worker; only the central directory and the
+    // compressed bytes are read, so there is nothing to overlap here.
+    executor->post([this, job = std::move(job)]() mutable {
+      IoBuffer data;
+      std::error_code ec;
+      try {
+        StageTimer timer(Stage::Read);
+        ec = read_source(job.source.path, data);
+      } catch (std::exception& e) {
+        finish(job, exception_result(job.source.path, e));
+        return;
+      }
+      convert_buffer(job, std::move(data), ec);
+    });
+    return;
+  }
+  auto path = job.source.path;
+  // Async stages are timed from request to completion, queueing included:
+  // that is how long a conversion waits on them.
+  io->read(path, [this, job = std::move(job)](IoBuffer&& data,
+                                                std::error_code ec) mutable {
+    Metrics::record_async(Stage::Read, job.start);
+    executor->post(
+        [this, job = std::move(job), data = std::move(data), ec]() mutable {
+          convert_buffer(job, std::move(data), ec);
+        });
+  });
+}
+
+bool ConverterManager::skip_unchanged(Job& job, GmlDoc& gdoc) {
+  if (job.source.expected_hash == 0 ||
+      gdoc.content_hash() != job.source.expected_hash) {
+    return false;
+  }
+  auto output = gdoc.output_path(options.target_directory);
+  std::error_code ec;
+  if (!fs::exists(output, ec)) return false;
+
+  ConvertResult r;
+  r.source = job.source.path;
+  r.output = output;
+  r.content_hash = job.source.expected_hash;
+  r.skipped = true;
+  finish(job, std::move(r));
+  return true;
+}
+
+void ConverterManager::convert_sync(Job& job) {
+  TaskMemoryScope memory(job.source.size);
+  ConvertResult r;
+  try {
+    // content_hash in skip_unchanged reads the source too.
+    GmlDoc gdoc(job.source.path);
+    if (skip_unchanged(job, gdoc)) return;
+    gdoc.set_gdaldriver(thread_gtiff_driver());
+    gdoc.set_spatialref(spatialref);
+    r = gdoc.write_gtiff(options.target_directory);
+  } catch (std::exception& e) {
+    r = exception_result(job.source.path, e);
+  }
+  finish(job, std::move(r));
+}
+
+void ConverterManager::convert_buffer(Job& job, IoBuffer&& data,
+                                      std::error_code ec) {
+  if (ec) {
+    ConvertResult r;
+    r.source = job.source.path;
+    r.status = ConvertStatus::OpenFailed;
+    r.message = ec.message();
+    finish(job, std::move(r));
+    return;
+  }
+
+  ByteBuffer encoded(nullptr, ::free);
+  size_t size = 0;
+  ConvertResult r;
+  {
+    TaskMemoryScope memory(job.source.size);
+    try {
+      GmlDoc gdoc(job.source.path);
+      gdoc.set_buffer(std::move(data));
+      if (skip_unchanged(job, gdoc)) return;
+      gdoc.set_gdaldriver(thread_gtiff_driver());
+      gdoc.set_spatialref(spatialref);
+      r = gdoc.write_gtiff_memory(options.target_directory, encoded, size);
+    } catch (std::exception& e) {
+      r = exception_result(job.source.path, e);
+      encoded.reset();
+      size = 0;
+    }
+    // The encoded file coexists with the document until the document goes.
+    MemoryCharge encoded_charge(MemoryKind::Encoded, size);
+  }
+  if (!r.ok()) {
+    finish(job, std::move(r));
+    return;
+  }
+
+  auto output = r.output;
+  auto shared = std::make_shared<std::pair<Job, ConvertResult>>(
+      std::move(job), std::move(r));
+  auto partial = partial_path(output);
+  const auto requested = std::chrono::steady_clock::now();
+  io->write(partial, std::move(encoded), size,
+            [this, shared, partial, requested](std::error_code ec) {
+              auto& [job, r] = *shared;
+              if (!ec) ec = commit_file(partial, r.output);
+              Metrics::record_async(Stage::Commit, requested);
+              if (ec) {
+                std::error_code ignored;
+                fs::remove(partial, ignored);
+                r.status = ConvertStatus::WriteFailed;
+                r.message = ec.message();
+                r.bytes_written = 0;
+              }
+              finish(job, std::move(r));
+            });
+}
+
+void ConverterManager::finish(Job& job, ConvertResult r) {
+  r.attempts = job.attempts;
+  r.source_size = job.source.size;
+  r.source_mtime = job.source.mtime;
+  r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            job.start)
+                  .count();
+  if (r.ok() && !r.skipped) {
+    Metrics::add(Counter::Files, 1);
+    Metrics::add(Counter::BytesRead, r.bytes_read);
+    Metrics::add(Counter::BytesWritten, r.bytes_written);
+  }
+  results.add(std::move(r));
+  if (job.charged) inflight_bytes.release(job.charged);
+  inflight.release();
+}
+
+}  // namespace gistool
@@ -0,0 +1,96 @@
+#ifndef CONVERTER_MANAGER_H
+#define CONVERTER_MANAGER_H
+#include <ogr_spatialref.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+#include "AsyncIO.h"
+#include "ConvertResult.h"
+#include "threadpool.h"
+#include "throttle.h"
+
+namespace gistool {
+namespace fs = std::filesystem;
+class GmlDoc;
+
+struct ConverterOptions {
+  fs::path target_directory{"out"};
+  int epsg = 6668;
+  /// 0: hardware concurrency.
+  std::uint32_t thread_count = 0;
+  bool pin_threads = false;
+  IoBackend io_backend = IoBackend::Auto;
+  /// Reads and writes kept in flight by the I/O backend.
+  unsigned io_depth = 64;
+  /// Files admitted at once (read, parsed or being written). 0: 4 per worker.
+  std::uint32_t max_inflight = 0;
+  /// Bound on the estimated memory of admitted files (estimate_task_bytes).
+  /// 0: only max_inflight applies.
+  std::uint64_t max_inflight_bytes = 0;
+
+  /// thread_count and max_inflight with their defaults applied.
+  std::uint32_t resolved_threads() const;
+  std::uint32_t resolved_inflight() const;
+};
+
+/**
+ * @brief Runs conversions on the thread pool, optionally with an async read
+ * and write stage around them, and reports every file to a ResultCollector.
+ */
+class ConverterManager {
+ public:
+  ConverterManager(const ConverterOptions& options, ResultCollector& results);
+  ~ConverterManager();
+
+  ConverterManager(const ConverterManager&) = delete;
+  ConverterManager& operator=(const ConverterManager&) = delete;
+
+  /**
+   * @brief Queue a source. Blocks while max_inflight files, or
+   * max_inflight_bytes of estimated memory, are in flight.
+   */
+  void add_queue(SourceFile source, std::uint32_t attempts = 1);
+  void add_queue(fs::path path, std::uint32_t attempts = 1) {
+    add_queue(SourceFile{std::move(path)}, attempts);
+  }
+
+  /**
+   * @brief Block until every queued file has been reported.
+   */
+  void wait() { inflight.wait_idle(); }
+
+  std::uint32_t thread_count() const { return executor->thread_count(); }
+  std::chrono::nanoseconds busy_time() const { return executor->busy_time(); }
+  IoBackend io_backend() const {
+    return io ? io->backend() : IoBackend::Sync;
+  }
+
+ private:
+  struct Job {
+    SourceFile source;
+    std::uint32_t attempts;
+    std::chrono::steady_clock::time_point start;
+    /// Taken from inflight_bytes at admission.
+    std::uint64_t charged = 0;
+  };
+
+  void convert_sync(Job& job);
+  void convert_buffer(Job& job, IoBuffer&& data, std::error_code ec);
+  bool skip_unchanged(Job& job, GmlDoc& gdoc);
+  void finish(Job& job, ConvertResult result);
+
+  ConverterOptions options;
+  OGRSpatialReference spatialref;
+  ResultCollector& results;
+  concurrent::Throttle inflight;
+  concurrent::Throttle inflight_bytes;
+  std::unique_ptr<concurrent::ThreadPoolExecutor> executor;
+  std::unique_ptr<AsyncFileIO> io;
+};
+
+}  // namespace gistool
+
+#endif  // !CONVERTER_MANAGER_H
@@ -0,0 +1,133 @@
+#include "Crawler.h"
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace gistool {
+namespace {
+
+#ifdef _WIN32
+// FindFirstFile/FindNextFile already return the attributes, so the cached
+// directory_entry queries below do not touch the file again.
+std::error_code list_directory(const fs::path& dir, bool recursive,
+                               std::vector<fs::path>& subdirs,
+                               const DirectoryCrawler::Visitor& visit) {
+  std::error_code ec;
+  fs::directory_iterator it(dir, ec), end;
+  if (ec) return ec;
+  for (; it != end; it.increment(ec)) {
+    if (ec) return ec;
+    std::error_code type_ec;
+    if (it->is_directory(type_ec)) {
+      if (recursive && !it->is_symlink(type_ec)) subdirs.push_back(it->path());
+    } else if (it->is_regular_file(type_ec)) {
+      visit(it->path());
+    }
+  }
+  return ec;
+}
+#else
+std::error_code list_directory(const fs::path& dir, bool recursive,
+                               std::vector<fs::path>& subdirs,
+                               const DirectoryCrawler::Visitor& visit) {
+  // Closed on every exit, including a visit that throws.
+  std::unique_ptr<DIR, int (*)(DIR*)> d(::opendir(dir.c_str()), ::closedir);
+  if (!d) return std::error_code(errno, std::system_category());
+  const int dfd = ::dirfd(d.get());
+
+  // readdir is safe on distinct streams; each directory has its own.
+  while (const dirent* e = ::readdir(d.get())) {
+    const char* name = e->d_name;
+    if (name[0] == '.' &&
+        (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+      continue;
+    }
+    unsigned char type = e->d_type;
+    if (type == DT_UNKNOWN || type == DT_LNK) {
+      struct stat st;
+      if (::fstatat(dfd, name, &st, 0) != 0) continue;
+      if (S_ISDIR(st.st_mode)) {
+        if (type == DT_LNK) continue;
+        type = DT_DIR;
+      } else if (S_ISREG(st.st_mode)) {
+        type = DT_REG;
+      } else {
+        continue;
+      }
+    }
+    // FIFOs, sockets and devices are not inputs (opening a FIFO blocks).
+    if (type == DT_DIR) {
+      if (recursive) subdirs.push_back(dir / name);
+    } else if (type == DT_REG) {
+      visit(dir / name);
+    }
+  }
+  return {};
+}
+#endif
+
+}  // namespace
+
+std::error_code DirectoryCrawler::crawl(const fs::path& root, bool recursive,
+                                        const Visitor& visit) const {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<fs::path> pending{root};
+  std::uint32_t busy = 0;
+  std::error_code first_error;
+  std::exception_ptr failure;
+
+  auto work = [&]() {
+    std::vector<fs::path> found;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      cv.wait(lock, [&] { return !pending.empty() || busy == 0; });
+      if (pending.empty()) return;
+      // Depth first: the newest directory is likely still in the dentry cache.
+      auto dir = std::move(pending.back());
+      pending.pop_back();
+      ++busy;
+      lock.unlock();
+
+      found.clear();
+      std::error_code ec;
+      try {
+        ec = list_directory(dir, recursive, found, visit);
+      } catch (...) {
+        lock.lock();
+        if (!failure) failure = std::current_exception();
+        lock.unlock();
+      }
+
+      lock.lock();
+      if (ec && !first_error) first_error = ec;
+      if (!failure) {
+        for (auto& p : found) pending.push_back(std::move(p));
+      }
+      --busy;
+      if (failure) pending.clear();
+      cv.notify_all();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  const auto n = recursive ? threads : 1u;
+  for (std::uint32_t i = 1; i < n; ++i) workers.emplace_back(work);
+  work();
+  for (auto& t : workers) t.join();
+
+  if (failure) std::rethrow_exception(failure);
+  return first_error;
+}
+
+}  // namespace gistool
@@ -0,0 +1,46 @@
+#ifndef CRAWLER_H
+#define CRAWLER_H
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <system_error>
+
+namespace gistool {
+namespace fs = std::filesystem;
+
+/**
+ * @brief Walks a directory tree on several threads.
+ *
+ * Subdirectories are handed to idle threads as soon as they are found, and
+ * entry types come from readdir's d_type, so listing a directory costs its
+ * getdents calls rather than a stat per entry. Only entries whose type the
+ * filesystem does not report (and symlinks) are stat'ed. Like
+ * recursive_directory_iterator, symlinked directories are not followed.
+ */
+class DirectoryCrawler {
+ public:
+  using Visitor = std::function<void(const fs::path&)>;
+
+  explicit DirectoryCrawler(std::uint32_t thread_count)
+      : threads(thread_count ? thread_count : 1) {}
+
+  /**
+   * @brief Call visit for every regular file (or symlink to one) under
+   * root, concurrently from the crawler threads and in no particular order.
+   * visit may block (e.g. on a full conversion queue), which simply slows the
+   * walk down.
+   *
+   * Unreadable subdirectories are skipped; the first such error is returned
+   * after the walk completes.
+   */
+  std::error_code crawl(const fs::path& root, bool recursive,
+                        const Visitor& visit) const;
+
+ private:
+  std::uint32_t threads;
+};
+
+}  // namespace gistool
+
+#endif  // !CRAWLER_H
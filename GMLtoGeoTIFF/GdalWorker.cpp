@@ -0,0 +1,20 @@
+#include "GdalWorker.h"
+
+#include <cpl_conv.h>
+
+namespace gistool {
+
+void apply_gdal_tuning(const GdalTuning& tuning) {
+  if (tuning.cache_mb > 0) GDALSetCacheMax64(tuning.cache_mb * 1024 * 1024);
+  if (!tuning.num_threads.empty()) {
+    CPLSetConfigOption("GDAL_NUM_THREADS", tuning.num_threads.c_str());
+  }
+}
+
+GDALDriver* thread_gtiff_driver() {
+  thread_local GDALDriver* driver =
+      GetGDALDriverManager()->GetDriverByName("GTiff");
+  return driver;
+}
+
+}  // namespace gistool
@@ -0,0 +1,35 @@
+#ifndef GDAL_WORKER_H
+#define GDAL_WORKER_H
+#include <gdal_priv.h>
+
+#include <cstdint>
+#include <string>
+
+namespace gistool {
+
+/**
+ * @brief Process-wide GDAL settings.
+ */
+struct GdalTuning {
+  /// GDAL block cache in MB, shared by all workers. 0 keeps GDAL's default.
+  std::int64_t cache_mb = 0;
+  /// Value for GDAL_NUM_THREADS ("ALL_CPUS", "1", ...). Empty keeps default.
+  std::string num_threads;
+};
+
+/**
+ * @brief Apply the tuning before the workers start.
+ */
+void apply_gdal_tuning(const GdalTuning& tuning);
+
+/**
+ * @brief GTiff driver handle cached per thread.
+ *
+ * GDALDriverManager::GetDriverByName takes the driver manager mutex on every
+ * call; this looks the driver up once per worker.
+ */
+GDALDriver* thread_gtiff_driver();
+
+}  // namespace gistool
+
+#endif  // !GDAL_WORKER_H
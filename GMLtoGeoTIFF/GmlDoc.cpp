@@ -1,6 +1,21 @@
 #include "GmlDoc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include "Manifest.h"
+#include "MemoryStats.h"
+#include "Metrics.h"
+#include "ZipArchive.h"
 namespace gistool {
-rx::xml_node<>* GmlDoc::find_node(rx::xml_node<>* node, std::string& name) {
+rx::xml_node<>* GmlDoc::find_node(rx::xml_node<>* node,
+                                  const std::string& name) {
   if (node == nullptr) return nullptr;
   std::queue<rx::xml_node<>*> que;
   que.push(node);
@@ -35,14 +50,7 @@ double GmlDoc::brx() { return 0.0; }
 
 double GmlDoc::bry() { return 0.0; }
 
-bool GmlDoc::write_gtiff(const fs::path path) {
-  if (!this->try_parse()) return false;
-  using namespace std;
-  double transform[6] = {0};
-  this->get_transform(transform);
-  auto node = this->find_node_by_name(string("gml:tupleList"));
-  if (!node) return false;
-  auto cells = this->size_cells();
+fs::path GmlDoc::output_path(const fs::path& path) const {
   fs::path outpath = path;
   {
     fs::path parentpath = file_path.parent_path();
@@ -50,54 +58,301 @@ bool GmlDoc::write_gtiff(const fs::path path) {
     std::advance(b, 1);
     auto l = parentpath.end();
     std::for_each(b, l, [&outpath](const fs::path& elem) {
-      outpath.append(elem.string());
+      // Members of "x.zip" go to a directory named "x".
+      auto name = elem.string();
+      if (!name.empty() && name.back() == '!') {
+        fs::path archive = name.substr(0, name.size() - 1);
+        if (is_zip_path(archive)) name = archive.stem().string();
+      }
+      outpath.append(name);
     });
   }
-  if (!fs::exists(outpath)) fs::create_directories(outpath);
-
   outpath.append(file_path.filename().c_str());
   outpath.replace_extension(".tiff");
-  cout << outpath.string() << endl;
-  this->dataset = gdriver->Create(outpath.string().c_str(), cells[0], cells[1],
-                                  1, GDT_Float32, NULL);
-
-  std::stringstream ss{node->value()};
-  std::string buf;
-  std::getline(ss, buf);
-  float* val = new float[cells[0]];
-  for (uint32_t row = 0; row < cells[1]; row++) {
-    for (uint32_t col = 0; col < cells[0]; col++) {
-      if (std::getline(ss, buf)) {
-        std::stringstream splited(buf);
-        std::string h_buf("");
-        for (size_t i = 0; i < 2; i++) {
-          getline(splited, h_buf, ',');
-          if (i == 1) val[col] = stof(h_buf);
-        }
-      } else {
-        val[col] = -9999.f;
-      }
+  return outpath;
+}
+
+fs::path GmlDoc::prepare_output(const fs::path& path) const {
+  auto outpath = output_path(path);
+  std::error_code ec;
+  fs::create_directories(outpath.parent_path(), ec);
+  return outpath;
+}
+
+std::uint64_t GmlDoc::content_hash() {
+  if (hash == 0 && this->load()) {
+    hash = hash_bytes(buffer.data(), buffer.size() - 1);
+  }
+  return hash;
+}
+
+ConvertResult GmlDoc::write_dataset(const std::string& name) {
+  using namespace std;
+  ConvertResult result;
+  result.source = file_path;
+  if (!this->load()) {
+    result.status = ConvertStatus::OpenFailed;
+    result.message = "cannot open file";
+    return result;
+  }
+  result.bytes_read = buffer.size() - 1;
+  result.content_hash = this->content_hash();
+  bool parsed;
+  {
+    StageTimer timer(Stage::Parse);
+    parsed = this->try_parse();
+  }
+  if (!parsed) {
+    result.status = ConvertStatus::ParseFailed;
+    result.message = "xml parse error";
+    return result;
+  }
+  double transform[6] = {0};
+  GridHeader header;
+  auto node = this->find_node_by_name(string("gml:tupleList"));
+  if (!this->read_header(header, result.message)) {
+    result.status = ConvertStatus::InvalidHeader;
+    return result;
+  }
+  header.transform(transform);
+  const uint32_t cells[2] = {header.cols, header.rows};
+  if (!node) {
+    result.status = ConvertStatus::InvalidHeader;
+    result.message = "gml:tupleList not found";
+    return result;
+  }
+  {
+    StageTimer timer(Stage::Write);
+    this->dataset = gdriver->Create(name.c_str(), cells[0], cells[1], 1,
+                                    GDT_Float32, NULL);
+  }
+  if (!this->dataset) {
+    result.status = ConvertStatus::WriteFailed;
+    result.message = CPLGetLastErrorMsg();
+    return result;
+  }
+
+  concurrent::local_vector<float> val(static_cast<size_t>(cells[0]) *
+                                      cells[1]);
+  MemoryCharge raster_charge(MemoryKind::Raster, val.size() * sizeof(float));
+  bool write_ok = true;
+  {
+    StageTimer timer(Stage::Decode);
+    std::string error;
+    if (decode_tuple_list(node->value(), cells[0], cells[1], header.start,
+                          val.data(), error)) {
+      Metrics::add(Counter::Cells, static_cast<std::uint64_t>(cells[0]) *
+                                       cells[1]);
+    } else {
+      result.status = ConvertStatus::InvalidHeader;
+      result.message = "bad tuple: " + error;
     }
+  }
 
-    dataset->GetRasterBand(1)->RasterIO(GF_Write, 0, row, cells[0], 1, val,
-                                        cells[0], 1, GDT_Float32, 0, 0);
+  {
+    StageTimer timer(Stage::Write);
+    if (result.ok()) {
+      write_ok = dataset->GetRasterBand(1)->RasterIO(
+                     GF_Write, 0, 0, cells[0], cells[1], val.data(), cells[0],
+                     cells[1], GDT_Float32, 0, 0) == CE_None;
+    }
+    dataset->SetGeoTransform(transform);
+    dataset->GetRasterBand(1)->SetNoDataValue(-9999);
+    dataset->SetSpatialRef(spatialref);
   }
+  {
+    StageTimer timer(Stage::Close);
+    GDALClose(dataset);
+  }
+  this->dataset = nullptr;
+
+  if (!write_ok) {
+    result.status = ConvertStatus::WriteFailed;
+    result.message = CPLGetLastErrorMsg();
+  }
+  return result;
+}
 
-  dataset->SetGeoTransform(transform);
-  dataset->GetRasterBand(1)->SetNoDataValue(-9999);
-  dataset->SetSpatialRef(spatialref);
-  GDALClose(dataset);
-  delete[] val;
 
-  return true;
+ConvertResult GmlDoc::write_gtiff(const fs::path path) {
+  auto outpath = prepare_output(path);
+  // Write under a temporary name so a crash never leaves a valid looking,
+  // truncated GeoTIFF at the final path.
+  auto partial = partial_path(outpath);
+  auto result = write_dataset(partial.string());
+  result.output = outpath;
+  std::error_code ec;
+  if (result.ok()) {
+    StageTimer timer(Stage::Commit);
+    result.bytes_written = fs::file_size(partial, ec);
+    if (!ec) ec = sync_file(partial);
+    if (!ec) ec = commit_file(partial, outpath);
+    if (ec) {
+      result.status = ConvertStatus::WriteFailed;
+      result.message = ec.message();
+      result.bytes_written = 0;
+    }
+  }
+  if (!result.ok()) fs::remove(partial, ec);
+  return result;
+}
+
+ConvertResult GmlDoc::write_gtiff_memory(const fs::path path, ByteBuffer& data,
+                                         size_t& size) {
+  static std::atomic<uint64_t> counter{0};
+  std::string name =
+      "/vsimem/tlgml_" + std::to_string(counter.fetch_add(1)) + ".tiff";
+  auto outpath = prepare_output(path);
+  auto result = write_dataset(name);
+  result.output = outpath;
+
+  // Take ownership of the encoded file; this also unlinks it from /vsimem.
+  vsi_l_offset length = 0;
+  GByte* bytes = VSIGetMemFileBuffer(name.c_str(), &length, TRUE);
+  data = ByteBuffer(bytes, VSIFree);
+  size = static_cast<size_t>(length);
+  if (result.ok() && !bytes) {
+    result.status = ConvertStatus::WriteFailed;
+    result.message = "in-memory dataset not found";
+  }
+  if (!result.ok()) {
+    data.reset();
+    size = 0;
+    return result;
+  }
+  result.bytes_written = size;
+  return result;
 }
 
 void GmlDoc::cellsize_internal(int* nx, int* ny) {}
 
-std::vector<double> GmlDoc::size_lat_lon() {
-  using namespace std;
+namespace {
+
+bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/// Whitespace separated numbers of a node's text, e.g. "35.0 139.0".
+/// Returns false when the node is missing or a value is not a finite number.
+bool parse_doubles(const rx::xml_node<>* node, double* out, std::size_t n) {
+  if (node == nullptr) return false;
+  const char* p = node->value();
+  for (std::size_t i = 0; i < n; i++) {
+    char* end = nullptr;
+    out[i] = std::strtod(p, &end);
+    if (end == p || !std::isfinite(out[i])) return false;
+    if (*end != '\0' && !is_space(*end)) return false;
+    p = end;
+  }
+  return true;
+}
+
+bool parse_indices(const rx::xml_node<>* node, long* out, std::size_t n) {
+  if (node == nullptr) return false;
+  const char* p = node->value();
+  for (std::size_t i = 0; i < n; i++) {
+    char* end = nullptr;
+    errno = 0;
+    out[i] = std::strtol(p, &end, 10);
+    if (end == p || errno == ERANGE || out[i] < 0) return false;
+    if (*end != '\0' && !is_space(*end)) return false;
+    p = end;
+  }
+  return true;
+}
+
+}  // namespace
+
+void GridHeader::transform(double out[6]) const {
+  out[0] = lat_lon[1];
+  out[1] = (lat_lon[3] - lat_lon[1]) / cols;
+  out[2] = 0;
+  out[3] = lat_lon[2];
+  out[4] = 0;
+  out[5] = (lat_lon[0] - lat_lon[2]) / rows;
+}
+
+bool decode_tuple_list(const char* text, std::uint32_t cols,
+                       std::uint32_t rows, std::uint64_t start, float* dst,
+                       std::string& error) {
+  // The first line is the rest of the <gml:tupleList> line.
+  const char* p = std::strchr(text, '\n');
+  p = p ? p + 1 : text + std::strlen(text);
+  const std::uint64_t cells = static_cast<std::uint64_t>(cols) * rows;
+  if (start > cells) start = cells;
+  std::fill(dst, dst + start, -9999.f);
+  dst += start;
+  for (std::uint64_t i = start; i < cells; i++, dst++) {
+    if (*p == '\0') {
+      *dst = -9999.f;
+      continue;
+    }
+    const char* eol = std::strchr(p, '\n');
+    if (!eol) eol = p + std::strlen(p);
+    // "type,value": the value is the second field.
+    const char* comma =
+        static_cast<const char*>(std::memchr(p, ',', eol - p));
+    char* end = nullptr;
+    if (comma) *dst = std::strtof(comma + 1, &end);
+    // Out of float range (std::stof threw), "inf" and "nan" are no heights
+    // either.
+    if (!comma || end == comma + 1 || end > eol ||
+        (end < eol && *end != ',' && !is_space(*end)) || !std::isfinite(*dst)) {
+      error = "tuple " + std::to_string(i - start + 1) + " (row " +
+              std::to_string(i / cols + 1) + ", col " +
+              std::to_string(i % cols + 1) + ") has no numeric value";
+      return false;
+    }
+    p = *eol ? eol + 1 : eol;
+  }
+  return true;
+}
+
+bool GmlDoc::read_header(GridHeader& header, std::string& error) {
   auto envnode = this->find_node_by_name(std::string("gml:Envelope"));
-  std::vector<double> ret(4);
+  if (!envnode) {
+    error = "gml:Envelope not found";
+    return false;
+  }
+  if (!parse_doubles(envnode->first_node("gml:lowerCorner"), header.lat_lon,
+                     2) ||
+      !parse_doubles(envnode->first_node("gml:upperCorner"),
+                     header.lat_lon + 2, 2)) {
+    error = "gml:lowerCorner / gml:upperCorner missing or malformed";
+    return false;
+  }
+
+  auto gridnode = this->find_node_by_name(std::string("gml:GridEnvelope"));
+  long high[2];
+  if (!gridnode || !parse_indices(gridnode->first_node("gml:high"), high, 2)) {
+    error = "gml:GridEnvelope/gml:high missing or malformed";
+    return false;
+  }
+  const std::uint64_t cols = static_cast<std::uint64_t>(high[0]) + 1;
+  const std::uint64_t rows = static_cast<std::uint64_t>(high[1]) + 1;
+  if (cols * rows > max_grid_cells || cols > INT32_MAX || rows > INT32_MAX) {
+    error = "grid of " + std::to_string(cols) + " x " + std::to_string(rows) +
+            " cells is too large";
+    return false;
+  }
+  header.cols = static_cast<std::uint32_t>(cols);
+  header.rows = static_cast<std::uint32_t>(rows);
+
+  header.start = 0;
+  if (auto startnode = this->find_node_by_name(std::string("gml:startPoint"))) {
+    long start[2];
+    if (!parse_indices(startnode, start, 2) ||
+        static_cast<std::uint64_t>(start[0]) >= cols ||
+        static_cast<std::uint64_t>(start[1]) >= rows) {
+      error = "gml:startPoint malformed or outside the grid";
+      return false;
+    }
+    header.start = static_cast<std::uint64_t>(start[1]) * cols + start[0];
+  }
+  return true;
+}
+
+std::vector<double> GmlDoc::size_lat_lon() {
   /// ֋X㉺ƏƐĂ邪͈ႤB
   /// n\ɋ``ƂǍoxAܓxꂼ
   /// ret[1]Aret[2]ɓĂB
@@ -107,68 +362,74 @@ std::vector<double> GmlDoc::size_lat_lon() {
   /// ret[1] ox̉
   /// ret[2] ܓx̏
   /// ret[3] ox̏
-  std::stringstream ss_lowercorner{
-      envnode->first_node("gml:lowerCorner")->value()};
-  std::string b;
-  // getline(ss_lowercorner, b);
-  for (size_t i = 0; i < 2; i++) {
-    std::string buff("");
-    std::getline(ss_lowercorner, buff, ' ');
-    cout << buff << endl;
-    ret[i] = std::stod(buff);
-  }
-
-  std::stringstream ss_uppercorner{
-      envnode->first_node("gml:upperCorner")->value()};
-  for (size_t i = 0; i < 2; i++) {
-    std::string buff("");
-    std::getline(ss_uppercorner, buff, ' ');
-    ret[i + 2] = std::stod(buff);
-  }
-  return ret;
+  GridHeader header;
+  std::string error;
+  if (!read_header(header, error)) throw std::runtime_error(error);
+  return std::vector<double>(header.lat_lon, header.lat_lon + 4);
 }
 
 std::vector<uint32_t> GmlDoc::size_cells() {
-  auto envnode = this->find_node_by_name(std::string("gml:GridEnvelope"));
-  std::vector<uint32_t> ret(2);
-
-  std::stringstream ss_uppercorner{envnode->first_node("gml:high")->value()};
-  for (size_t i = 0; i < 2; i++) {
-    std::string buff("");
-    std::getline(ss_uppercorner, buff, ' ');
-    ret[i] = std::stoi(buff) + 1;
-  }
-  return ret;
+  GridHeader header;
+  std::string error;
+  if (!read_header(header, error)) throw std::runtime_error(error);
+  return {header.cols, header.rows};
 }
 
 GmlDoc::GmlDoc(fs::path filename)
     : document(new rx::xml_document<>()),
-      file(new rx::file<>(filename.string().c_str())),
+      buffer(),
       dataset(nullptr),
       gdriver(nullptr),
       file_path(filename),
-      spatialref(nullptr) {}
+      spatialref(nullptr) {
+  document_account = TaskMemory::current();
+  if (document_account) {
+    document_account->charge(MemoryKind::XmlPool, sizeof(*document));
+    document->set_allocator(TaskMemory::pool_alloc, TaskMemory::pool_free);
+  }
+}
 
 GmlDoc::~GmlDoc() {
   delete document;
-  delete file;
+  if (document_account) document_account->release(sizeof(rx::xml_document<>));
+  if (buffer_account) buffer_account->release(buffer_charged);
+}
+
+void GmlDoc::charge_buffer() {
+  if (buffer_account) buffer_account->release(buffer_charged);
+  buffer_account = TaskMemory::current();
+  buffer_charged = buffer.capacity();
+  if (buffer_account) {
+    buffer_account->charge(MemoryKind::FileBuffer, buffer_charged);
+  }
+}
+
+void GmlDoc::set_buffer(IoBuffer&& data) {
+  buffer = std::move(data);
+  charge_buffer();
+}
+
+bool GmlDoc::load() {
+  if (!buffer.empty()) return true;
+  StageTimer timer(Stage::Read);
+  // Resizing zero fills the buffer from this thread, which also places its
+  // pages (first touch) on the worker's node.
+  if (read_source(file_path, buffer)) {
+    buffer.clear();
+    return false;
+  }
+  charge_buffer();
+  return true;
 }
 
 bool GmlDoc::try_parse() {
+  if (!this->load()) return false;
   try {
-    this->document->parse<0>(this->file->data());
+    this->document->parse<0>(buffer.data());
     return true;
   } catch (rx::parse_error& err) {
     return false;
   }
 }
-ConverterManager::ConverterManager(int epsg = 6668)
-    : spatialref(OGRSpatialReference()) {
-  this->spatialref.importFromEPSG(epsg);
-}
-
-void ConverterManager::add_queue(fs::path path) {
-  // doque.emplace(path.string());
-}
 
 }  // namespace gistool
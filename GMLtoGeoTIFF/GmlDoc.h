@@ -9,9 +9,14 @@
 #include <iostream>
 #include <queue>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+#include "AsyncIO.h"
+#include "ConvertResult.h"
+#include "MemoryStats.h"
+#include "numa_alloc.h"
 #include "rapidxml.hpp"
 #include "rapidxml_utils.hpp"
 
@@ -29,29 +34,85 @@ class GmlDoc;
 
 namespace helper {}  // namespace helper
 
+/// Grids above this many cells are rejected as a malformed header rather
+/// than allocated (a JPGIS DEM10B tile, the largest, is 1125 x 750).
+constexpr std::uint64_t max_grid_cells = std::uint64_t(1) << 26;
+
+/**
+ * @brief Georeferencing of a DEM: the gml:Envelope corners in
+ * size_lat_lon() order and the gml:GridEnvelope size in cells.
+ */
+struct GridHeader {
+  double lat_lon[4] = {0};
+  std::uint32_t cols = 0;
+  std::uint32_t rows = 0;
+  /// Cell of the first tuple, from gml:startPoint (x + y * cols). GSI omits
+  /// the tuples before it in tiles that start over the sea.
+  std::uint64_t start = 0;
+
+  /** @brief GDAL geotransform, north up. */
+  void transform(double out[6]) const;
+};
+
+/**
+ * @brief Decode the "type,value" lines of a gml:tupleList into cols * rows
+ * cells, row major, the first tuple going to cell start (GridHeader::start).
+ * Cells without a tuple are -9999. On a malformed or non-finite value returns
+ * false with error naming the tuple; dst is then partly written.
+ */
+bool decode_tuple_list(const char* text, std::uint32_t cols,
+                       std::uint32_t rows, std::uint64_t start, float* dst,
+                       std::string& error);
+
 class GmlDoc {
  private:
   rx::xml_document<>* document;
-  rx::file<>* file;
+  /// Zero terminated file contents, allocated on the worker's NUMA node.
+  IoBuffer buffer;
+  /// Task charged for buffer (--memory-stats), released with the document.
+  TaskMemory* buffer_account = nullptr;
+  std::size_t buffer_charged = 0;
+  /// Task charged for document, which embeds rapidxml's first pool block.
+  TaskMemory* document_account = nullptr;
+  void charge_buffer();
   void cellsize_internal(int* nx, int* ny);
+  fs::path prepare_output(const fs::path& path) const;
+  ConvertResult write_dataset(const std::string& name);
   GDALDataset* dataset;
   GDALDriver* gdriver;
   OGRSpatialReference* spatialref;
 
   fs::path file_path;
+  std::uint64_t hash = 0;
 
  public:
   GmlDoc() = delete;
   explicit GmlDoc(fs::path filename);
 
   virtual ~GmlDoc();
+  bool load();
+  /// Use contents read elsewhere (async I/O) instead of reading the file.
+  void set_buffer(IoBuffer&& data);
+  /// Hash of the file contents (loads the file). 0 when it cannot be read.
+  std::uint64_t content_hash();
+  /// Output file under root, mirroring the source's parent directories.
+  fs::path output_path(const fs::path& root) const;
   bool try_parse();
-  rx::xml_node<>* find_node(rx::xml_node<>* node, std::string& name);
-  rx::xml_node<>* find_node_by_name(std::string& name) {
+  rx::xml_node<>* find_node(rx::xml_node<>* node, const std::string& name);
+  rx::xml_node<>* find_node_by_name(const std::string& name) {
     return this->find_node(document->first_node(), name);
   }
 
+  /**
+   * @brief Read the envelope, grid size and start point of the parsed
+   * document. Missing nodes, unparsable or non-finite numbers, oversized
+   * grids and start points outside the grid return false with a message in
+   * error instead of throwing. A missing gml:startPoint means 0 0.
+   */
+  bool read_header(GridHeader& header, std::string& error);
+  /** @brief read_header's corners; throws std::runtime_error on failure. */
   std::vector<double> size_lat_lon();
+  /** @brief read_header's cols, rows; throws std::runtime_error on failure. */
   std::vector<uint32_t> size_cells();
   double sizex();
   double sizey();
@@ -63,17 +124,22 @@ class GmlDoc {
   double brx();
   double bry();
 
-  bool write_gtiff(const fs::path path = fs::current_path().append("out"));
+  /// Failures are reported through the result instead of being swallowed.
+  ConvertResult write_gtiff(
+      const fs::path path = fs::current_path().append("out"));
+
+  /// Encode the GeoTIFF in /vsimem and hand the bytes over in data, so the
+  /// caller can write them asynchronously to result.output.
+  ConvertResult write_gtiff_memory(const fs::path path, ByteBuffer& data,
+                                   size_t& size);
+
+  const fs::path& source_path() const { return file_path; }
 
   inline void get_transform(double transform[6]) {
-    auto env_latlon = this->size_lat_lon();
-    auto env_grid = this->size_cells();
-    transform[0] = env_latlon[1];
-    transform[1] = (env_latlon[3] - env_latlon[1]) / env_grid[0];
-    transform[2] = 0;
-    transform[3] = env_latlon[2];
-    transform[4] = 0;
-    transform[5] = (env_latlon[0] - env_latlon[2]) / env_grid[1];
+    GridHeader header;
+    std::string error;
+    if (!read_header(header, error)) throw std::runtime_error(error);
+    header.transform(transform);
   }
 
   inline void set_transform(double transform[6]) {
@@ -85,16 +151,6 @@ class GmlDoc {
   inline void set_gdaldriver(GDALDriver* driver) { this->gdriver = driver; }
 };
 
-class ConverterManager {
- private:
-  OGRSpatialReference spatialref;
-  std::queue<std::unique_ptr<GmlDoc>>
-      doque;  /// documentqueueVсB
- public:
-  explicit ConverterManager(int epsg);
-  void add_queue(fs::path path);
-};
-
 }  // namespace gistool
 
 #endif  // !GML_DOC_H
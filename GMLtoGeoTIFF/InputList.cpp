@@ -0,0 +1,62 @@
+#include "InputList.h"
+
+#include <algorithm>
+#include <cctype>
+
+#include "Manifest.h"
+
+namespace gistool {
+
+bool InputList::read_record(std::string& record) {
+  record.clear();
+  if (separator_known) {
+    if (!std::getline(in, record, separator)) return false;
+    ++count;
+    return true;
+  }
+  // Until the first separator, accept both.
+  std::istream::int_type c;
+  while ((c = in.get()) != std::istream::traits_type::eof()) {
+    const char ch = static_cast<char>(c);
+    if (ch == '\n' || ch == '\0') {
+      separator = ch;
+      separator_known = true;
+      ++count;
+      return true;
+    }
+    record.push_back(ch);
+  }
+  if (record.empty()) return false;
+  ++count;
+  return true;
+}
+
+bool InputList::next(SourceFile& source) {
+  std::string record;
+  while (read_record(record)) {
+    if (separator == '\n' && !record.empty() && record.back() == '\r') {
+      record.pop_back();
+    }
+    if (record.empty()) continue;
+
+    source = SourceFile{};
+    auto tab = record.rfind('\t');
+    if (tab != std::string::npos && tab + 1 < record.size() &&
+        record.size() - tab - 1 <= 19 &&
+        std::all_of(record.begin() + tab + 1, record.end(), [](char c) {
+          return std::isdigit(static_cast<unsigned char>(c));
+        })) {
+      source.size = std::stoull(record.substr(tab + 1));
+      record.resize(tab);
+      source.path = fs::u8path(record);
+      // mtime 0: unknown, so the manifest compares hashes.
+      return true;
+    }
+    source.path = fs::u8path(record);
+    stat_source(source.path, source.size, source.mtime);
+    return true;
+  }
+  return false;
+}
+
+}  // namespace gistool
@@ -0,0 +1,46 @@
+#ifndef INPUT_LIST_H
+#define INPUT_LIST_H
+
+#include <cstddef>
+#include <istream>
+#include <string>
+
+#include "ConvertResult.h"
+
+namespace gistool {
+
+/**
+ * @brief Sources given by an external scheduler (--inputs-from FILE|-).
+ *
+ * One path per record; records end with '\n' or NUL, whichever appears first
+ * in the input (NUL allows any path, as with find -print0). A record may end
+ * with a tab and the size in bytes, in which case the file is not stat'ed and
+ * unchanged inputs are detected by content hash only. Records are read one at
+ * a time, so the list is never held in memory.
+ */
+class InputList {
+ public:
+  explicit InputList(std::istream& in) : in(in) {}
+
+  /**
+   * @brief Next source, false at the end of the input. Empty records are
+   * skipped.
+   */
+  bool next(SourceFile& source);
+
+  /// Records read so far, for error messages.
+  std::size_t records() const { return count; }
+
+ private:
+  bool read_record(std::string& record);
+
+  std::istream& in;
+  char separator = '\n';
+  /// Set by the first separator in the input.
+  bool separator_known = false;
+  std::size_t count = 0;
+};
+
+}  // namespace gistool
+
+#endif  // !INPUT_LIST_H
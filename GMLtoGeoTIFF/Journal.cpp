@@ -0,0 +1,80 @@
+#include "Journal.h"
+
+#include <fstream>
+#include <string>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace gistool {
+
+std::size_t Journal::replay(const fs::path& path, Manifest& manifest) {
+  std::ifstream ifs(path, std::ios::binary);
+  std::size_t count = 0;
+  std::string line;
+  while (std::getline(ifs, line)) {
+    // A torn last line fails to parse and is dropped.
+    ManifestEntry e;
+    if (parse_entry(line, e)) {
+      manifest.update(std::move(e));
+      ++count;
+    }
+  }
+  return count;
+}
+
+bool Journal::open(const fs::path& journal_path, bool resume) {
+  std::lock_guard<std::mutex> lock(mutex);
+  path = journal_path;
+#ifdef _WIN32
+  fp = _wfopen(path.c_str(), resume ? L"ab" : L"wb");
+#else
+  fp = std::fopen(path.c_str(), resume ? "ab" : "wb");
+#endif
+  last_sync = std::chrono::steady_clock::now();
+  if (!fp) return false;
+  // Terminate a line torn by the crash so it does not swallow the next entry.
+  if (resume) std::fputc('\n', fp);
+  return true;
+}
+
+void Journal::append(const ManifestEntry& entry) {
+  auto line = format_entry(entry);
+  line.push_back('\n');
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!fp) return;
+  std::fwrite(line.data(), 1, line.size(), fp);
+  std::fflush(fp);
+  if (std::chrono::steady_clock::now() - last_sync >= sync_interval) {
+    sync_locked();
+  }
+}
+
+void Journal::sync_locked() {
+#ifdef _WIN32
+  _commit(_fileno(fp));
+#else
+  ::fsync(fileno(fp));
+#endif
+  last_sync = std::chrono::steady_clock::now();
+}
+
+void Journal::close() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!fp) return;
+  std::fflush(fp);
+  sync_locked();
+  std::fclose(fp);
+  fp = nullptr;
+}
+
+void Journal::discard() {
+  close();
+  std::error_code ec;
+  if (!path.empty()) fs::remove(path, ec);
+}
+
+}  // namespace gistool
@@ -0,0 +1,66 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+
+#include "Manifest.h"
+
+namespace gistool {
+namespace fs = std::filesystem;
+
+/**
+ * @brief Append-only log of finished tasks, for resuming interrupted runs.
+ *
+ * An entry is appended only after the output has been flushed and renamed to
+ * its final name, so every journaled output is complete. Each append reaches
+ * the kernel immediately (survives a killed process); the journal itself is
+ * fsynced at most once per sync_interval, so a power loss can drop the last
+ * few entries, which are then simply converted again.
+ */
+class Journal {
+ public:
+  static constexpr const char* file_name = "journal.log";
+
+  Journal() = default;
+  ~Journal() { close(); }
+
+  Journal(const Journal&) = delete;
+  Journal& operator=(const Journal&) = delete;
+
+  /**
+   * @brief Apply the entries of an existing journal to manifest. A missing
+   * journal is not an error. Returns the number of entries replayed.
+   */
+  static std::size_t replay(const fs::path& path, Manifest& manifest);
+
+  /**
+   * @brief Open for appending. Truncates unless resume is set.
+   */
+  bool open(const fs::path& path, bool resume);
+
+  void append(const ManifestEntry& entry);
+
+  void close();
+
+  /**
+   * @brief Close and delete the journal once its entries are in the
+   * manifest.
+   */
+  void discard();
+
+ private:
+  void sync_locked();
+
+  std::mutex mutex;
+  std::FILE* fp = nullptr;
+  fs::path path;
+  std::chrono::steady_clock::time_point last_sync;
+  std::chrono::milliseconds sync_interval{1000};
+};
+
+}  // namespace gistool
+
+#endif  // !JOURNAL_H
@@ -0,0 +1,264 @@
+#include "Manifest.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <vector>
+
+#include "AsyncIO.h"
+
+namespace gistool {
+
+std::uint64_t hash_bytes(const void* data, std::size_t size) {
+  const std::uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const int r = 47;
+  std::uint64_t h = 0x8445d61a4e774912ULL ^ (size * m);
+
+  auto p = static_cast<const unsigned char*>(data);
+  const unsigned char* end = p + (size & ~static_cast<std::size_t>(7));
+  for (; p != end; p += 8) {
+    std::uint64_t k;
+    std::memcpy(&k, p, sizeof(k));
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+
+  switch (size & 7) {
+    case 7:
+      h ^= std::uint64_t(p[6]) << 48;
+      [[fallthrough]];
+    case 6:
+      h ^= std::uint64_t(p[5]) << 40;
+      [[fallthrough]];
+    case 5:
+      h ^= std::uint64_t(p[4]) << 32;
+      [[fallthrough]];
+    case 4:
+      h ^= std::uint64_t(p[3]) << 24;
+      [[fallthrough]];
+    case 3:
+      h ^= std::uint64_t(p[2]) << 16;
+      [[fallthrough]];
+    case 2:
+      h ^= std::uint64_t(p[1]) << 8;
+      [[fallthrough]];
+    case 1:
+      h ^= std::uint64_t(p[0]);
+      h *= m;
+  }
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+bool stat_source(const fs::path& path, std::uint64_t& size,
+                 std::int64_t& mtime) {
+  std::error_code ec;
+  size = fs::file_size(path, ec);
+  if (ec) {
+    size = 0;
+    return false;
+  }
+  auto t = fs::last_write_time(path, ec);
+  if (ec) return false;
+  mtime = static_cast<std::int64_t>(t.time_since_epoch().count());
+  return true;
+}
+
+namespace {
+bool parse_status(const std::string& name, ConvertStatus& status) {
+  for (auto s : {ConvertStatus::Ok, ConvertStatus::OpenFailed,
+                 ConvertStatus::ParseFailed, ConvertStatus::InvalidHeader,
+                 ConvertStatus::WriteFailed, ConvertStatus::TooLarge}) {
+    if (name == to_string(s)) {
+      status = s;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Paths may contain any byte but NUL; tabs, line breaks and backslashes are
+// written as \t, \n, \r and \\ so that a line stays one entry.
+void escape_path(const std::string& path, std::ostream& os) {
+  for (char c : path) {
+    switch (c) {
+      case '\\':
+        os << "\\\\";
+        break;
+      case '\t':
+        os << "\\t";
+        break;
+      case '\n':
+        os << "\\n";
+        break;
+      case '\r':
+        os << "\\r";
+        break;
+      default:
+        os << c;
+    }
+  }
+}
+
+bool unescape_path(const std::string& text, std::string& path) {
+  path.clear();
+  path.reserve(text.size());
+  for (std::size_t i = 0; i < text.size(); ++i) {
+    if (text[i] != '\\') {
+      path.push_back(text[i]);
+      continue;
+    }
+    if (++i == text.size()) return false;
+    switch (text[i]) {
+      case '\\':
+        path.push_back('\\');
+        break;
+      case 't':
+        path.push_back('\t');
+        break;
+      case 'n':
+        path.push_back('\n');
+        break;
+      case 'r':
+        path.push_back('\r');
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+std::string format_entry(const ManifestEntry& e) {
+  std::ostringstream oss;
+  escape_path(e.source, oss);
+  oss << '\t' << e.size << '\t' << e.mtime << '\t' << std::hex << e.hash
+      << std::dec << '\t';
+  escape_path(e.output, oss);
+  oss << '\t' << to_string(e.status);
+  return oss.str();
+}
+
+bool parse_entry(const std::string& line, ManifestEntry& e) {
+  std::vector<std::string> cols;
+  std::stringstream ss(line);
+  std::string col;
+  while (std::getline(ss, col, '\t')) cols.push_back(col);
+  if (cols.size() != 6) return false;
+
+  if (!unescape_path(cols[0], e.source) || !unescape_path(cols[4], e.output)) {
+    return false;
+  }
+  try {
+    e.size = std::stoull(cols[1]);
+    e.mtime = std::stoll(cols[2]);
+    e.hash = std::stoull(cols[3], nullptr, 16);
+  } catch (std::exception&) {
+    return false;
+  }
+  return parse_status(cols[5], e.status);
+}
+
+Manifest::Manifest(fs::path source, fs::path target)
+    : source_root(std::move(source)), target_root(std::move(target)) {}
+
+bool Manifest::load(const fs::path& path) {
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs) return !fs::exists(path);
+
+  std::string line;
+  std::getline(ifs, line);  // header
+  while (std::getline(ifs, line)) {
+    ManifestEntry e;
+    if (parse_entry(line, e)) entries[e.source] = std::move(e);
+  }
+  return true;
+}
+
+bool Manifest::save(const fs::path& path) const {
+  fs::path tmp = path;
+  tmp += ".tmp";
+  {
+    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+    if (!ofs) return false;
+    ofs << "source\tsize\tmtime\thash\toutput\tstatus\n";
+    for (const auto& [key, e] : entries) {
+      ofs << format_entry(e) << '\n';
+    }
+    ofs.close();
+    if (!ofs) return false;
+  }
+  // The journal is discarded once this returns true, so the new manifest must
+  // be on disk under its final name by then: data, rename, directory entry.
+  if (sync_file(tmp)) return false;
+  std::error_code ec;
+  fs::rename(tmp, path, ec);
+  if (ec) return false;
+  return !sync_directory(path.parent_path());
+}
+
+std::string Manifest::key(const fs::path& source) const {
+  auto rel = source.lexically_relative(source_root);
+  if (rel.empty() || *rel.begin() == "..") rel = source;
+  return rel.generic_string();
+}
+
+const ManifestEntry* Manifest::find(const std::string& key) const {
+  auto it = entries.find(key);
+  return it == entries.end() ? nullptr : &it->second;
+}
+
+Manifest::State Manifest::check(const SourceFile& source) const {
+  auto e = find(key(source.path));
+  if (!e || e->status != ConvertStatus::Ok || e->size != source.size) {
+    return State::Changed;
+  }
+  std::error_code ec;
+  if (!fs::exists(target_root / fs::u8path(e->output), ec)) {
+    return State::Changed;
+  }
+  // mtime 0 means unknown (sizes from --inputs-from): trust only the hash.
+  if (source.mtime == 0) return State::CheckHash;
+  return e->mtime == source.mtime ? State::UpToDate : State::CheckHash;
+}
+
+ManifestEntry Manifest::make_entry(const ConvertResult& result) const {
+  ManifestEntry e;
+  e.source = key(result.source);
+  e.size = result.source_size;
+  e.mtime = result.source_mtime;
+  e.hash = result.content_hash;
+  e.status = result.status;
+  if (!result.output.empty()) {
+    auto rel = result.output.lexically_relative(target_root);
+    e.output = (rel.empty() ? result.output : rel).generic_u8string();
+  }
+  return e;
+}
+
+std::vector<fs::path> Manifest::outputs() const {
+  std::vector<fs::path> ret;
+  for (const auto& [key, e] : entries) {
+    if (e.status == ConvertStatus::Ok && !e.output.empty()) {
+      ret.push_back(target_root / fs::u8path(e.output));
+    }
+  }
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+void Manifest::update(ManifestEntry e) {
+  auto key = e.source;
+  entries[key] = std::move(e);
+}
+
+}  // namespace gistool
@@ -0,0 +1,105 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ConvertResult.h"
+
+namespace gistool {
+namespace fs = std::filesystem;
+
+/**
+ * @brief 64 bit content hash (MurmurHash64A) of a buffer.
+ */
+std::uint64_t hash_bytes(const void* data, std::size_t size);
+
+/**
+ * @brief Size and modification time of a source, as recorded in manifests.
+ */
+bool stat_source(const fs::path& path, std::uint64_t& size,
+                 std::int64_t& mtime);
+
+struct ManifestEntry {
+  std::string source;  /// Relative to the source directory, '/' separated.
+  std::uint64_t size = 0;
+  std::int64_t mtime = 0;
+  std::uint64_t hash = 0;
+  std::string output;  /// Relative to the output directory.
+  ConvertStatus status = ConvertStatus::Ok;
+};
+
+/**
+ * @brief Tab separated line shared by the manifest and the journal. Tabs,
+ * newlines and backslashes in the paths are backslash escaped.
+ */
+std::string format_entry(const ManifestEntry& entry);
+bool parse_entry(const std::string& line, ManifestEntry& entry);
+
+/**
+ * @brief Record of converted inputs, kept as manifest.tsv in the output tree.
+ *
+ * An input is up to date when its size and mtime match a successful entry and
+ * the recorded output still exists. Inputs whose mtime changed but size did
+ * not are re-hashed by the converter before deciding.
+ */
+class Manifest {
+ public:
+  static constexpr const char* file_name = "manifest.tsv";
+
+  Manifest(fs::path source_root, fs::path target_root);
+
+  /**
+   * @brief Load entries. A missing manifest is an empty one.
+   */
+  bool load(const fs::path& path);
+
+  /**
+   * @brief Write to a temporary file and rename it over path. Returns true
+   * only once the data and the rename are on disk.
+   */
+  bool save(const fs::path& path) const;
+
+  std::string key(const fs::path& source) const;
+
+  const ManifestEntry* find(const std::string& key) const;
+
+  enum class State {
+    Changed,    /// Convert.
+    UpToDate,   /// Skip.
+    CheckHash,  /// Same size, new or unknown mtime: convert unless the hash
+                /// matches.
+  };
+
+  State check(const SourceFile& source) const;
+
+  ManifestEntry make_entry(const ConvertResult& result) const;
+
+  void update(const ConvertResult& result) { update(make_entry(result)); }
+  void update(ManifestEntry entry);
+
+  std::size_t size() const { return entries.size(); }
+
+  template <typename F>
+  void for_each(F&& func) const {
+    for (const auto& kv : entries) func(kv.second);
+  }
+
+  /**
+   * @brief Outputs of successful entries, sorted.
+   */
+  std::vector<fs::path> outputs() const;
+
+ private:
+  fs::path source_root;
+  fs::path target_root;
+  std::unordered_map<std::string, ManifestEntry> entries;
+};
+
+}  // namespace gistool
+
+#endif  // !MANIFEST_H
@@ -0,0 +1,210 @@
+#include "MemoryStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+#include <new>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace gistool {
+namespace {
+
+// Quarter octave buckets: bucket b holds peaks below 2^((b + 1) / 4).
+constexpr std::size_t bucket_count = 256;
+
+std::size_t bucket_of(std::uint64_t bytes) {
+  if (bytes == 0) return 0;
+  const auto b = static_cast<std::size_t>(
+      std::floor(std::log2(static_cast<double>(bytes)) * 4));
+  return std::min(b, bucket_count - 1);
+}
+
+std::uint64_t bucket_limit(std::size_t b) {
+  return static_cast<std::uint64_t>(std::exp2((b + 1) / 4.0));
+}
+
+struct Totals {
+  std::array<std::atomic<std::uint64_t>, memory_kind_count> calls{};
+  std::array<std::atomic<std::uint64_t>, memory_kind_count> bytes{};
+  std::mutex mutex;
+  std::array<std::uint64_t, bucket_count> peaks{};
+  std::uint64_t tasks = 0;
+  std::uint64_t max = 0;
+  double max_ratio = 0;
+};
+
+Totals& totals() {
+  static Totals t;
+  return t;
+}
+
+thread_local TaskMemory* current_account = nullptr;
+
+// Blocks remember their account and size, so the pool can be freed after
+// the scope that allocated it has ended.
+struct alignas(std::max_align_t) PoolHeader {
+  TaskMemory* account;
+  std::size_t size;
+};
+
+}  // namespace
+
+const char* to_string(MemoryKind kind) {
+  switch (kind) {
+    case MemoryKind::XmlPool:
+      return "xml pool";
+    case MemoryKind::FileBuffer:
+      return "file buffer";
+    case MemoryKind::Raster:
+      return "raster";
+    case MemoryKind::Encoded:
+      return "encoded";
+  }
+  return "unknown";
+}
+
+void TaskMemory::charge(MemoryKind kind, std::size_t bytes) {
+  const auto now = current_.fetch_add(static_cast<std::int64_t>(bytes),
+                                      std::memory_order_relaxed) +
+                   static_cast<std::int64_t>(bytes);
+  auto peak = peak_.load(std::memory_order_relaxed);
+  while (now > peak &&
+         !peak_.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {
+  }
+  MemoryStats::count(kind, bytes);
+}
+
+void TaskMemory::release(std::size_t bytes) {
+  current_.fetch_sub(static_cast<std::int64_t>(bytes),
+                     std::memory_order_relaxed);
+}
+
+TaskMemory* TaskMemory::current() { return current_account; }
+
+void* TaskMemory::pool_alloc(std::size_t size) {
+  auto* header =
+      static_cast<PoolHeader*>(std::malloc(sizeof(PoolHeader) + size));
+  if (!header) throw std::bad_alloc();
+  header->account = current_account;
+  header->size = size;
+  if (header->account) header->account->charge(MemoryKind::XmlPool, size);
+  return header + 1;
+}
+
+void TaskMemory::pool_free(void* p) {
+  if (!p) return;
+  auto* header = static_cast<PoolHeader*>(p) - 1;
+  if (header->account) header->account->release(header->size);
+  std::free(header);
+}
+
+TaskMemoryScope::TaskMemoryScope(std::uint64_t source_size)
+    : source_size(source_size), active(MemoryStats::enabled()) {
+  if (!active) return;
+  previous = current_account;
+  current_account = &account;
+}
+
+TaskMemoryScope::~TaskMemoryScope() {
+  if (!active) return;
+  current_account = previous;
+  MemoryStats::record_task(account.peak(), source_size);
+}
+
+void MemoryStats::count(MemoryKind kind, std::size_t bytes) {
+  auto& t = totals();
+  const auto i = static_cast<std::size_t>(kind);
+  t.calls[i].fetch_add(1, std::memory_order_relaxed);
+  t.bytes[i].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void MemoryStats::record_task(std::uint64_t peak, std::uint64_t source_size) {
+  auto& t = totals();
+  std::lock_guard<std::mutex> lock(t.mutex);
+  ++t.peaks[bucket_of(peak)];
+  ++t.tasks;
+  t.max = std::max(t.max, peak);
+  if (source_size > 0) {
+    t.max_ratio = std::max(t.max_ratio, static_cast<double>(peak) / source_size);
+  }
+}
+
+MemoryReport MemoryStats::report() {
+  auto& t = totals();
+  MemoryReport r;
+  for (std::size_t i = 0; i < memory_kind_count; ++i) {
+    r.calls[i] = t.calls[i].load(std::memory_order_relaxed);
+    r.bytes[i] = t.bytes[i].load(std::memory_order_relaxed);
+  }
+  {
+    std::lock_guard<std::mutex> lock(t.mutex);
+    r.tasks = t.tasks;
+    r.max = t.max;
+    r.max_ratio = t.max_ratio;
+    const std::uint64_t targets[] = {(t.tasks + 1) / 2, (t.tasks * 9 + 9) / 10,
+                                     (t.tasks * 99 + 99) / 100};
+    std::uint64_t* out[] = {&r.p50, &r.p90, &r.p99};
+    std::uint64_t seen = 0;
+    std::size_t next = 0;
+    for (std::size_t b = 0; b < bucket_count && next < 3; ++b) {
+      seen += t.peaks[b];
+      while (next < 3 && t.tasks > 0 && seen >= targets[next]) {
+        *out[next++] = std::min(bucket_limit(b), t.max);
+      }
+    }
+  }
+  r.max_rss = max_rss_bytes();
+  return r;
+}
+
+std::uint64_t max_rss_bytes() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+    return 0;
+  }
+  return counters.PeakWorkingSetSize;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+  return static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+  return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+void print_memory_stats(std::ostream& os, const MemoryReport& r) {
+  const double mib = 1024.0 * 1024.0;
+  const auto flags = os.flags();
+  os << std::fixed << std::setprecision(1);
+  os << "Max RSS: " << r.max_rss / mib << " MiB\n";
+  if (r.tasks > 0) {
+    os << "Task peak: p50 " << r.p50 / mib << " MiB, p90 " << r.p90 / mib
+       << " MiB, p99 " << r.p99 / mib << " MiB, max " << r.max / mib
+       << " MiB (" << std::setprecision(2) << r.max_ratio
+       << "x source size) over " << r.tasks << " tasks\n";
+  }
+  os << std::left << std::setw(14) << "Buffer" << std::right << std::setw(12)
+     << "Allocs" << std::setw(14) << "Total [MiB]" << "\n";
+  for (std::size_t i = 0; i < memory_kind_count; ++i) {
+    os << std::left << std::setw(14) << to_string(static_cast<MemoryKind>(i))
+       << std::right << std::setw(12) << r.calls[i] << std::setprecision(1)
+       << std::setw(14) << r.bytes[i] / mib << "\n";
+  }
+  os.flags(flags);
+}
+
+}  // namespace gistool
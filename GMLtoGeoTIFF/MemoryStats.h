@@ -0,0 +1,142 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace gistool {
+
+/// What a charge was for.
+enum class MemoryKind : std::uint8_t {
+  XmlPool,     /// rapidxml node and attribute blocks.
+  FileBuffer,  /// Source contents.
+  Raster,      /// Float32 grid.
+  Encoded,     /// GeoTIFF held for the async write.
+};
+constexpr std::size_t memory_kind_count = 4;
+
+const char* to_string(MemoryKind kind);
+
+/**
+ * @brief Bytes held by one conversion, and the most it held at once.
+ *
+ * Only buffers the converter allocates itself are charged; GDAL's block
+ * cache and /vsimem are shared and show up in max RSS only.
+ */
+class TaskMemory {
+ public:
+  void charge(MemoryKind kind, std::size_t bytes);
+  void release(std::size_t bytes);
+  std::uint64_t peak() const { return peak_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Account of the task running on this thread, null when memory
+   * accounting is off or no task is running.
+   */
+  static TaskMemory* current();
+
+  /// rapidxml::memory_pool::set_allocator functions charging current().
+  static void* pool_alloc(std::size_t size);
+  static void pool_free(void* p);
+
+ private:
+  friend class TaskMemoryScope;
+  /// Charges may be released from another thread (buffers handed over).
+  std::atomic<std::int64_t> current_{0};
+  std::atomic<std::int64_t> peak_{0};
+};
+
+/**
+ * @brief Makes a fresh TaskMemory current for the enclosing scope and
+ * records its peak on exit. Does nothing unless MemoryStats is enabled.
+ */
+class TaskMemoryScope {
+ public:
+  explicit TaskMemoryScope(std::uint64_t source_size);
+  ~TaskMemoryScope();
+
+  TaskMemoryScope(const TaskMemoryScope&) = delete;
+  TaskMemoryScope& operator=(const TaskMemoryScope&) = delete;
+
+ private:
+  TaskMemory account;
+  TaskMemory* previous = nullptr;
+  std::uint64_t source_size;
+  bool active;
+};
+
+/**
+ * @brief Charges bytes to the current task for the enclosing scope.
+ */
+class MemoryCharge {
+ public:
+  MemoryCharge(MemoryKind kind, std::size_t bytes)
+      : account(TaskMemory::current()), bytes(bytes) {
+    if (account) account->charge(kind, bytes);
+  }
+  ~MemoryCharge() {
+    if (account) account->release(bytes);
+  }
+
+  MemoryCharge(const MemoryCharge&) = delete;
+  MemoryCharge& operator=(const MemoryCharge&) = delete;
+
+ private:
+  TaskMemory* account;
+  std::size_t bytes;
+};
+
+struct MemoryReport {
+  std::uint64_t tasks = 0;
+  /// Per-task peaks at the 50th, 90th and 99th percentile (bucket upper
+  /// bounds, within 19%) and the largest.
+  std::uint64_t p50 = 0, p90 = 0, p99 = 0, max = 0;
+  /// Largest peak relative to the task's source size.
+  double max_ratio = 0;
+  std::array<std::uint64_t, memory_kind_count> calls{};
+  std::array<std::uint64_t, memory_kind_count> bytes{};
+  std::uint64_t max_rss = 0;
+};
+
+/**
+ * @brief Process wide memory accounting (--memory-stats).
+ */
+class MemoryStats {
+ public:
+  /// Call before work starts; accounting cannot be turned off again.
+  static void enable() { enabled_.store(true, std::memory_order_relaxed); }
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  static void record_task(std::uint64_t peak, std::uint64_t source_size);
+  static MemoryReport report();
+
+ private:
+  friend class TaskMemory;
+  static void count(MemoryKind kind, std::size_t bytes);
+
+  static inline std::atomic<bool> enabled_{false};
+};
+
+/**
+ * @brief Peak resident set size of the process in bytes, 0 if unknown.
+ */
+std::uint64_t max_rss_bytes();
+
+/**
+ * @brief Memory a conversion of a source of this size is expected to peak
+ * at: its buffer, about a third more for the grid and the encoded output
+ * (a tuple is ~26 bytes of XML and 4 bytes of Float32), and the rapidxml
+ * document with its first 64 KiB pool block.
+ */
+inline std::uint64_t estimate_task_bytes(std::uint64_t source_size) {
+  return source_size + source_size / 3 + 128 * 1024;
+}
+
+void print_memory_stats(std::ostream& os, const MemoryReport& report);
+
+}  // namespace gistool
+
+#endif  // !MEMORY_STATS_H
@@ -0,0 +1,187 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+#include "trace.h"
+
+namespace gistool {
+namespace {
+
+struct Slot {
+  std::array<std::atomic<std::uint64_t>, stage_count> nanos{};
+  std::array<std::atomic<std::uint64_t>, stage_count> calls{};
+  std::array<std::atomic<std::uint64_t>, counter_count> counters{};
+};
+
+// Only the owning thread writes, so a plain load and store is enough; the
+// atomics only make concurrent snapshots well defined.
+inline void bump(std::atomic<std::uint64_t>& a, std::uint64_t n) {
+  a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+void add_slot(MetricsSnapshot& m, const Slot& s) {
+  for (std::size_t i = 0; i < stage_count; ++i) {
+    m.nanos[i] += s.nanos[i].load(std::memory_order_relaxed);
+    m.calls[i] += s.calls[i].load(std::memory_order_relaxed);
+  }
+  for (std::size_t i = 0; i < counter_count; ++i) {
+    m.counters[i] += s.counters[i].load(std::memory_order_relaxed);
+  }
+}
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<const Slot*> live;
+  MetricsSnapshot retired;
+};
+
+// Never destroyed: thread_local slots may retire during static destruction.
+Registry& registry() {
+  static Registry* r = new Registry;
+  return *r;
+}
+
+struct LocalSlot {
+  Slot slot;
+  LocalSlot() {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.live.push_back(&slot);
+  }
+  ~LocalSlot() {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    add_slot(r.retired, slot);
+    r.live.erase(std::find(r.live.begin(), r.live.end(), &slot));
+  }
+};
+
+Slot& local_slot() {
+  thread_local LocalSlot local;
+  return local.slot;
+}
+
+}  // namespace
+
+const char* to_string(Stage stage) {
+  switch (stage) {
+    case Stage::Read:
+      return "read";
+    case Stage::Parse:
+      return "parse";
+    case Stage::Decode:
+      return "decode";
+    case Stage::Write:
+      return "write";
+    case Stage::Close:
+      return "close";
+    case Stage::Commit:
+      return "commit";
+  }
+  return "unknown";
+}
+
+void Metrics::record(Stage stage, std::chrono::steady_clock::duration elapsed) {
+  auto& s = local_slot();
+  const auto i = static_cast<std::size_t>(stage);
+  bump(s.nanos[i], static_cast<std::uint64_t>(
+                       std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           elapsed)
+                           .count()));
+  bump(s.calls[i], 1);
+  if (concurrent::Tracer::enabled()) {
+    const auto now = std::chrono::steady_clock::now();
+    concurrent::Tracer::complete(to_string(stage), "stage", now - elapsed, now);
+  }
+}
+
+void Metrics::record_async(Stage stage,
+                           std::chrono::steady_clock::time_point begin) {
+  const auto now = std::chrono::steady_clock::now();
+  auto& s = local_slot();
+  const auto i = static_cast<std::size_t>(stage);
+  bump(s.nanos[i], static_cast<std::uint64_t>(
+                       std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           now - begin)
+                           .count()));
+  bump(s.calls[i], 1);
+  if (concurrent::Tracer::enabled()) {
+    concurrent::Tracer::async(to_string(stage), "stage", begin, now);
+  }
+}
+
+void Metrics::add(Counter counter, std::uint64_t n) {
+  bump(local_slot().counters[static_cast<std::size_t>(counter)], n);
+}
+
+MetricsSnapshot Metrics::snapshot() {
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  MetricsSnapshot m = r.retired;
+  for (const auto* s : r.live) add_slot(m, *s);
+  return m;
+}
+
+void print_metrics(std::ostream& os, const MetricsSnapshot& m,
+                   double wall_seconds) {
+  double busy = 0;
+  for (std::size_t i = 0; i < stage_count; ++i) busy += m.nanos[i] * 1e-9;
+
+  const auto flags = os.flags();
+  os << std::left << std::setw(8) << "Stage" << std::right << std::setw(12)
+     << "Time [s]" << std::setw(10) << "Calls" << std::setw(12) << "Mean [ms]"
+     << std::setw(8) << "Share" << "\n";
+  os << std::fixed;
+  for (std::size_t i = 0; i < stage_count; ++i) {
+    const auto stage = static_cast<Stage>(i);
+    const double sec = m.seconds(stage);
+    const auto calls = m.count(stage);
+    os << std::left << std::setw(8) << to_string(stage) << std::right
+       << std::setprecision(2) << std::setw(12) << sec << std::setw(10) << calls
+       << std::setprecision(3) << std::setw(12)
+       << (calls ? sec * 1e3 / calls : 0.0) << std::setprecision(1)
+       << std::setw(7) << (busy > 0 ? sec * 100 / busy : 0.0) << "%\n";
+  }
+
+  const double mib = 1024.0 * 1024.0;
+  const double wall = wall_seconds > 0 ? wall_seconds : 1;
+  const double files = static_cast<double>(m.count(Counter::Files));
+  const double read = m.count(Counter::BytesRead) / mib;
+  const double written = m.count(Counter::BytesWritten) / mib;
+  os << std::setprecision(1) << "Files: " << m.count(Counter::Files) << " ("
+     << files / wall << "/s), cells: " << m.count(Counter::Cells) / 1e6
+     << " M (" << m.count(Counter::Cells) / 1e6 / wall << " M/s)\n"
+     << "Read: " << read << " MiB (" << read / wall << " MiB/s), written: "
+     << written << " MiB (" << written / wall << " MiB/s), wall "
+     << std::setprecision(2) << wall_seconds << " s\n";
+  os.flags(flags);
+}
+
+bool write_metrics_json(const fs::path& path, const MetricsSnapshot& m,
+                        double wall_seconds, std::uint32_t workers) {
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  if (!ofs) return false;
+  ofs << std::setprecision(9);
+  ofs << "{\n  \"wall_seconds\": " << wall_seconds
+      << ",\n  \"workers\": " << workers
+      << ",\n  \"files\": " << m.count(Counter::Files)
+      << ",\n  \"cells\": " << m.count(Counter::Cells)
+      << ",\n  \"bytes_read\": " << m.count(Counter::BytesRead)
+      << ",\n  \"bytes_written\": " << m.count(Counter::BytesWritten)
+      << ",\n  \"stages\": {";
+  for (std::size_t i = 0; i < stage_count; ++i) {
+    const auto stage = static_cast<Stage>(i);
+    ofs << (i ? "," : "") << "\n    \"" << to_string(stage)
+        << "\": {\"seconds\": " << m.seconds(stage)
+        << ", \"calls\": " << m.count(stage) << "}";
+  }
+  ofs << "\n  }\n}\n";
+  return static_cast<bool>(ofs);
+}
+
+}  // namespace gistool
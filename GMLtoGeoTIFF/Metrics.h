@@ -0,0 +1,99 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+
+namespace gistool {
+namespace fs = std::filesystem;
+
+/// Stages of one conversion, in pipeline order.
+enum class Stage : std::uint8_t {
+  Read,    /// File contents into memory (wait for the I/O stage when async).
+  Parse,   /// rapidxml.
+  Decode,  /// gml:tupleList into the float grid.
+  Write,   /// GDAL dataset creation and RasterIO.
+  Close,   /// GDALClose (flushes the GeoTIFF).
+  Commit,  /// Writing the encoded file, fsync and rename.
+};
+constexpr std::size_t stage_count = 6;
+
+enum class Counter : std::uint8_t { Files, Cells, BytesRead, BytesWritten };
+constexpr std::size_t counter_count = 4;
+
+const char* to_string(Stage stage);
+
+struct MetricsSnapshot {
+  std::array<std::uint64_t, stage_count> nanos{};
+  std::array<std::uint64_t, stage_count> calls{};
+  std::array<std::uint64_t, counter_count> counters{};
+
+  double seconds(Stage s) const {
+    return nanos[static_cast<std::size_t>(s)] * 1e-9;
+  }
+  std::uint64_t count(Stage s) const {
+    return calls[static_cast<std::size_t>(s)];
+  }
+  std::uint64_t count(Counter c) const {
+    return counters[static_cast<std::size_t>(c)];
+  }
+};
+
+/**
+ * @brief Process wide stage timers and counters.
+ *
+ * Every thread accumulates into its own slot, written only by that thread
+ * with relaxed loads and stores (no locked instructions, no shared cache
+ * lines). snapshot() sums the live slots; a slot is folded into the total
+ * when its thread exits.
+ */
+class Metrics {
+ public:
+  static void record(Stage stage, std::chrono::steady_clock::duration elapsed);
+  /**
+   * @brief record() for a stage that overlaps other work on the calling
+   * thread (async I/O completions); traced on its own track.
+   */
+  static void record_async(Stage stage,
+                           std::chrono::steady_clock::time_point begin);
+  static void add(Counter counter, std::uint64_t n);
+  static MetricsSnapshot snapshot();
+};
+
+/**
+ * @brief Times the enclosing scope as one call of stage.
+ */
+class StageTimer {
+ public:
+  explicit StageTimer(Stage stage)
+      : stage(stage), start(std::chrono::steady_clock::now()) {}
+  ~StageTimer() {
+    Metrics::record(stage, std::chrono::steady_clock::now() - start);
+  }
+
+  StageTimer(const StageTimer&) = delete;
+  StageTimer& operator=(const StageTimer&) = delete;
+
+ private:
+  Stage stage;
+  std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * @brief Per-stage table and throughput over wall_seconds.
+ */
+void print_metrics(std::ostream& os, const MetricsSnapshot& m,
+                   double wall_seconds);
+
+/**
+ * @brief Same figures as JSON (--metrics-json), for dashboards.
+ */
+bool write_metrics_json(const fs::path& path, const MetricsSnapshot& m,
+                        double wall_seconds, std::uint32_t workers);
+
+}  // namespace gistool
+
+#endif  // !METRICS_H
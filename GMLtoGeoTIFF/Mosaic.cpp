@@ -0,0 +1,57 @@
+#include "Mosaic.h"
+
+#include <gdal_utils.h>
+
+#include <iostream>
+#include <string>
+
+#include "Shard.h"
+
+namespace gistool {
+
+bool build_vrt(const fs::path& vrt, const std::vector<fs::path>& tiffs) {
+  if (tiffs.empty()) return false;
+  std::vector<std::string> names;
+  names.reserve(tiffs.size());
+  for (const auto& p : tiffs) names.push_back(p.string());
+  std::vector<const char*> cnames;
+  cnames.reserve(names.size() + 1);
+  for (const auto& n : names) cnames.push_back(n.c_str());
+  cnames.push_back(nullptr);
+
+  GDALBuildVRTOptions* options = GDALBuildVRTOptionsNew(nullptr, nullptr);
+  int usage_error = 0;
+  GDALDatasetH ds =
+      GDALBuildVRT(vrt.string().c_str(), static_cast<int>(names.size()),
+                   nullptr, cnames.data(), options, &usage_error);
+  GDALBuildVRTOptionsFree(options);
+  if (!ds) return false;
+  GDALClose(ds);
+  return true;
+}
+
+bool merge_shards(const fs::path& source_root, const fs::path& target_root,
+                  std::uint32_t count, const fs::path& vrt) {
+  Manifest merged(source_root, target_root);
+  const auto merged_path = target_root / Manifest::file_name;
+  merged.load(merged_path);
+
+  for (std::uint32_t i = 0; i < count; ++i) {
+    ShardSpec shard;
+    shard.index = i;
+    shard.count = count;
+    auto path = shard.file(target_root, Manifest::file_name);
+    if (!fs::exists(path)) {
+      std::cerr << "Missing shard manifest " << path.string() << std::endl;
+      return false;
+    }
+    Manifest part(source_root, target_root);
+    if (!part.load(path)) return false;
+    part.for_each([&merged](const ManifestEntry& e) { merged.update(e); });
+  }
+
+  if (!merged.save(merged_path)) return false;
+  return build_vrt(vrt, merged.outputs());
+}
+
+}  // namespace gistool
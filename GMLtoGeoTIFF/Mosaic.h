@@ -0,0 +1,26 @@
+#ifndef MOSAIC_H
+#define MOSAIC_H
+
+#include <filesystem>
+#include <vector>
+
+#include "Manifest.h"
+
+namespace gistool {
+namespace fs = std::filesystem;
+
+/**
+ * @brief Build a VRT mosaic over the given GeoTIFFs with GDALBuildVRT.
+ */
+bool build_vrt(const fs::path& vrt, const std::vector<fs::path>& tiffs);
+
+/**
+ * @brief Merge the per-shard manifests of a run split with --shard i/N into
+ * the plain manifest and build one VRT over all successful outputs.
+ */
+bool merge_shards(const fs::path& source_root, const fs::path& target_root,
+                  std::uint32_t count, const fs::path& vrt);
+
+}  // namespace gistool
+
+#endif  // !MOSAIC_H
@@ -0,0 +1,183 @@
+#include "Plan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include "ZipArchive.h"
+
+namespace gistool {
+namespace {
+
+/// The header of a GSI DEM ends well within this; the tuples follow.
+constexpr std::size_t probe_bytes = 16 * 1024;
+
+std::string format_bytes(double bytes) {
+  static const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+  int u = 0;
+  while (bytes >= 1024 && u < 4) {
+    bytes /= 1024;
+    ++u;
+  }
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(u ? 1 : 0) << bytes << " " << units[u];
+  return os.str();
+}
+
+std::string format_seconds(double seconds) {
+  auto s = static_cast<std::uint64_t>(std::ceil(seconds));
+  std::ostringstream os;
+  if (s >= 3600) os << s / 3600 << "h ";
+  if (s >= 60) os << (s / 60) % 60 << "m ";
+  os << s % 60 << "s";
+  return os.str();
+}
+
+/**
+ * @brief Number after "key": in a line written by tlgml_bench's report().
+ */
+bool json_number(const std::string& line, const char* key, double& value) {
+  const std::string quoted = std::string("\"") + key + "\":";
+  auto pos = line.find(quoted);
+  if (pos == std::string::npos) return false;
+  const char* begin = line.c_str() + pos + quoted.size();
+  char* end = nullptr;
+  value = std::strtod(begin, &end);
+  return end != begin;
+}
+
+}  // namespace
+
+bool load_calibration(const std::filesystem::path& path,
+                      PlanCalibration& calibration, std::string& error) {
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs) {
+    error = "cannot open " + path.string();
+    return false;
+  }
+  bool found = false;
+  std::string line;
+  while (std::getline(ifs, line)) {
+    double value = 0;
+    if (line.find("\"scenario\":\"decode\"") != std::string::npos &&
+        json_number(line, "cells_per_s", value) && value > 0) {
+      calibration.cells_per_second = value;
+      found = true;
+    } else if (line.find("\"scenario\":\"parse\"") != std::string::npos &&
+               json_number(line, "mb_per_s", value) && value > 0) {
+      calibration.parse_bytes_per_second = value * 1e6;
+      found = true;
+    }
+  }
+  if (!found) {
+    error = path.string() + " has no tlgml_bench parse or decode result";
+    return false;
+  }
+  return true;
+}
+
+bool probe_grid(const char* data, std::size_t size, std::uint32_t& nx,
+                std::uint32_t& ny) {
+  static const char tag[] = "<gml:high>";
+  const char* end = data + size;
+  const char* p = std::search(data, end, tag, tag + sizeof(tag) - 1);
+  if (p == end) return false;
+  p += sizeof(tag) - 1;
+
+  // Two integers; strtoul stops at the end of the (zero terminated) prefix.
+  std::string text(p, std::min<std::size_t>(end - p, 64));
+  char* next = nullptr;
+  auto x = std::strtoul(text.c_str(), &next, 10);
+  if (next == text.c_str()) return false;
+  const char* second = next;
+  auto y = std::strtoul(second, &next, 10);
+  if (next == second) return false;
+  nx = static_cast<std::uint32_t>(x + 1);
+  ny = static_cast<std::uint32_t>(y + 1);
+  return true;
+}
+
+std::uint64_t Plan::output_bytes(std::uint32_t nx, std::uint32_t ny) {
+  // GDAL's default strips hold about 8 KB; each needs an offset and a count.
+  const std::uint64_t row = static_cast<std::uint64_t>(nx) * 4;
+  const std::uint64_t rows_per_strip = std::max<std::uint64_t>(1, 8192 / row);
+  const std::uint64_t strips = (ny + rows_per_strip - 1) / rows_per_strip;
+  return row * ny + strips * 8 + 1024;
+}
+
+void Plan::add(const SourceFile& source) {
+  std::uint32_t nx = 0, ny = 0;
+  bool ok = false;
+  if (is_archive_member(source.path)) {
+    IoBuffer buffer;
+    if (!read_source(source.path, buffer)) {
+      ok = probe_grid(buffer.data(), buffer.size() - 1, nx, ny);
+    }
+  } else {
+    std::ifstream ifs(source.path, std::ios::binary);
+    char head[probe_bytes];
+    ifs.read(head, sizeof(head));
+    ok = probe_grid(head, static_cast<std::size_t>(ifs.gcount()), nx, ny);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  ++files;
+  input_bytes += source.size;
+  max_input = std::max(max_input, source.size);
+  if (ok) {
+    const std::uint64_t c = static_cast<std::uint64_t>(nx) * ny;
+    ++probed;
+    probed_bytes += source.size;
+    cells += c;
+    max_cells = std::max(max_cells, c);
+    output_total += output_bytes(nx, ny);
+  }
+}
+
+void Plan::print(std::ostream& os, const PlanSystem& system) const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  // Sources without a readable header are assumed to have the average
+  // density of those that were probed.
+  double est_cells = static_cast<double>(cells);
+  double est_output = static_cast<double>(output_total);
+  if (probed > 0 && probed < files && probed_bytes > 0) {
+    const double rest = static_cast<double>(input_bytes - probed_bytes);
+    est_cells += rest * cells / probed_bytes;
+    est_output += rest * output_total / probed_bytes;
+  }
+
+  // Every admitted file holds its input; each worker also holds the grid
+  // and, with async I/O, the encoded output until it is written.
+  const double grid = static_cast<double>(max_cells) * 4;
+  const double encoded = system.async_io ? grid + 1024 : 0;
+  const double peak = static_cast<double>(system.inflight) * max_input +
+                      static_cast<double>(system.workers) * (grid + encoded) +
+                      static_cast<double>(system.gdal_cache_bytes);
+
+  const double cpu = est_cells / calibration.cells_per_second +
+                     input_bytes / calibration.parse_bytes_per_second +
+                     files * calibration.seconds_per_file;
+  const double cpu_wall = cpu / std::max<std::uint32_t>(system.workers, 1);
+  const double io_wall = est_output / calibration.write_bytes_per_second;
+
+  os << "Sources:        " << files << " (" << probed << " headers probed)\n"
+     << "Input:          " << format_bytes(static_cast<double>(input_bytes))
+     << "\n"
+     << "Cells:          " << std::fixed << std::setprecision(1)
+     << est_cells / 1e6 << " M\n"
+     << "Output (GTiff Float32, uncompressed): " << format_bytes(est_output)
+     << "\n"
+     << "Workers:        " << system.workers << ", " << system.inflight
+     << " files in flight\n"
+     << "Peak memory:    " << format_bytes(peak) << "\n"
+     << "Projected time: " << format_seconds(std::max(cpu_wall, io_wall))
+     << (io_wall > cpu_wall ? " (write bound)" : " (CPU bound)") << "\n";
+}
+
+}  // namespace gistool
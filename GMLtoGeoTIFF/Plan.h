@@ -0,0 +1,96 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include "ConvertResult.h"
+
+namespace gistool {
+
+/**
+ * @brief Per-worker throughput used to project the duration of a run.
+ *
+ * The defaults are tlgml_bench medians for a DEM5A tile with 10% no data
+ * (Release build, one core of an Intel Xeon VM). The tuple decoding loop dominates;
+ * load_calibration() replaces them with figures from the host itself.
+ */
+struct PlanCalibration {
+  /// Decoding gml:tupleList into the float grid.
+  double cells_per_second = 9.5e6;
+  /// rapidxml in-situ parse.
+  double parse_bytes_per_second = 1.3e9;
+  /// Create, fsync and rename of one output.
+  double seconds_per_file = 0.002;
+  /// Sequential write throughput of the target filesystem (shared).
+  double write_bytes_per_second = 200e6;
+};
+
+/**
+ * @brief Resources a run needs for the system it is about to start on.
+ */
+struct PlanSystem {
+  std::uint32_t workers = 1;
+  /// Files admitted at once (ConverterOptions::max_inflight resolved).
+  std::uint32_t inflight = 4;
+  /// Encoded outputs are held in memory until written (async I/O).
+  bool async_io = true;
+  std::uint64_t gdal_cache_bytes = 0;
+};
+
+/**
+ * @brief Read the output of tlgml_bench (one JSON object per line). The
+ * "decode" line sets cells_per_second and the "parse" line
+ * parse_bytes_per_second; when a scenario appears more than once the last
+ * line wins. Other values keep what calibration held.
+ *
+ * @return false, with error set, when the file cannot be read or has neither
+ * line.
+ */
+bool load_calibration(const std::filesystem::path& path,
+                      PlanCalibration& calibration, std::string& error);
+
+/**
+ * @brief Grid size from the header of a JPGIS DEM (gml:GridEnvelope high + 1).
+ * Only data is scanned, so a prefix of the file is enough.
+ */
+bool probe_grid(const char* data, std::size_t size, std::uint32_t& nx,
+                std::uint32_t& ny);
+
+/**
+ * @brief Dry-run estimate (--plan): sources are probed, nothing is written.
+ */
+class Plan {
+ public:
+  explicit Plan(PlanCalibration calibration = PlanCalibration())
+      : calibration(calibration) {}
+
+  /**
+   * @brief Read the header of source and account for it. Thread safe.
+   */
+  void add(const SourceFile& source);
+
+  void print(std::ostream& os, const PlanSystem& system) const;
+
+  /// Uncompressed Float32 GTiff: pixels plus header and strip tables.
+  static std::uint64_t output_bytes(std::uint32_t nx, std::uint32_t ny);
+
+ private:
+  PlanCalibration calibration;
+  mutable std::mutex mutex;
+  std::uint64_t files = 0;
+  std::uint64_t probed = 0;
+  std::uint64_t input_bytes = 0;
+  std::uint64_t probed_bytes = 0;
+  std::uint64_t cells = 0;
+  std::uint64_t output_total = 0;
+  std::uint64_t max_input = 0;
+  std::uint64_t max_cells = 0;
+};
+
+}  // namespace gistool
+
+#endif  // !PLAN_H
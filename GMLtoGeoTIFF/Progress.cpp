@@ -0,0 +1,144 @@
+#include "Progress.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+#include "Metrics.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace gistool {
+namespace {
+
+constexpr auto rate_window = std::chrono::seconds(10);
+
+std::string format_duration(double seconds) {
+  const auto s = static_cast<std::uint64_t>(seconds + 0.5);
+  std::ostringstream ss;
+  ss << s / 3600 << ":" << std::setfill('0') << std::setw(2) << s / 60 % 60
+     << ":" << std::setw(2) << s % 60;
+  return ss.str();
+}
+
+}  // namespace
+
+bool stderr_is_terminal() {
+#ifdef _WIN32
+  return _isatty(_fileno(stderr)) != 0;
+#else
+  return ::isatty(STDERR_FILENO) != 0;
+#endif
+}
+
+void ProgressReporter::start(std::uint32_t worker_count, BusyTime busy) {
+  if (interval.count() <= 0 || thread.joinable()) return;
+  workers = worker_count ? worker_count : 1;
+  busy_time = std::move(busy);
+  window.push_back(sample());
+  thread = std::thread(&ProgressReporter::run, this);
+}
+
+void ProgressReporter::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopping) return;
+    stopping = true;
+  }
+  cv.notify_all();
+  if (thread.joinable()) thread.join();
+
+  // The final state, so a short run still reports something.
+  if (!window.empty()) {
+    auto line = format(sample());
+    std::lock_guard<std::mutex> lock(mutex);
+    draw(line);
+    if (terminal) out << "\n";
+    out.flush();
+    shown = 0;
+  }
+  busy_time = nullptr;
+}
+
+void ProgressReporter::log(const std::string& line, std::ostream& os) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (shown > 0) {
+    out << "\r" << std::string(shown, ' ') << "\r";
+    out.flush();
+  }
+  os << line << "\n";
+  os.flush();
+  if (shown > 0) {
+    out << last_line;
+    out.flush();
+  }
+}
+
+ProgressReporter::Sample ProgressReporter::sample() const {
+  const auto m = Metrics::snapshot();
+  return Sample{std::chrono::steady_clock::now(),
+                results.succeeded() + results.failed() + results.skipped(),
+                m.count(Counter::BytesRead), m.count(Counter::Cells),
+                busy_time ? busy_time() : std::chrono::nanoseconds(0)};
+}
+
+std::string ProgressReporter::format(const Sample& now) const {
+  const auto& first = window.empty() ? now : window.front();
+  const double seconds =
+      std::chrono::duration<double>(now.time - first.time).count();
+  const auto expected_files = expected.load(std::memory_order_relaxed);
+  const bool known = total_known.load(std::memory_order_relaxed);
+
+  std::ostringstream ss;
+  ss << now.files << "/" << expected_files << (known ? "" : "+") << " files";
+  if (seconds > 0) {
+    const double files_per_second = (now.files - first.files) / seconds;
+    const double utilization =
+        std::chrono::duration<double>(now.busy - first.busy).count() /
+        (seconds * workers);
+    ss << std::fixed << std::setprecision(1) << "  " << files_per_second
+       << " files/s  " << (now.bytes - first.bytes) / seconds / 1e6
+       << " MB/s  " << std::setprecision(2)
+       << (now.cells - first.cells) / seconds / 1e6 << " Mcells/s  workers "
+       << std::setprecision(0) << std::min(utilization, 1.0) * 100 << "%";
+    if (known && expected_files > now.files && files_per_second > 0) {
+      ss << "  ETA "
+         << format_duration((expected_files - now.files) / files_per_second);
+    }
+  }
+  return ss.str();
+}
+
+void ProgressReporter::draw(const std::string& line) {
+  if (terminal) {
+    out << "\r" << line;
+    if (line.size() < shown) out << std::string(shown - line.size(), ' ');
+    shown = line.size();
+    last_line = line;
+  } else {
+    out << line << "\n";
+  }
+  out.flush();
+}
+
+void ProgressReporter::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!cv.wait_for(lock, interval, [this] { return stopping; })) {
+    lock.unlock();
+    const auto now = sample();
+    auto line = format(now);
+    window.push_back(now);
+    while (window.size() > 2 && now.time - window[1].time >= rate_window) {
+      window.pop_front();
+    }
+    lock.lock();
+    draw(line);
+  }
+}
+
+}  // namespace gistool
@@ -0,0 +1,119 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+#include "ConvertResult.h"
+
+namespace gistool {
+
+/**
+ * @brief Periodic progress line: files/s, MB/s, cells/s, worker utilization
+ * and ETA.
+ *
+ * A separate thread samples the result counts, Metrics and the pool's busy
+ * time, so workers never touch the output stream for progress. On a
+ * terminal the line is redrawn in place; otherwise one line is appended per
+ * interval, which keeps log files readable.
+ *
+ * Rates are taken over the last ten seconds. The ETA is shown once the total
+ * is known (set_total_known()), from the remaining file count.
+ */
+class ProgressReporter {
+ public:
+  using BusyTime = std::function<std::chrono::nanoseconds()>;
+
+  /**
+   * @param interval 0 disables the progress line; log() still works.
+   */
+  ProgressReporter(std::ostream& out, const ResultCollector& results,
+                   std::chrono::milliseconds interval, bool terminal)
+      : out(out), results(results), interval(interval), terminal(terminal) {}
+  ~ProgressReporter() { stop(); }
+
+  ProgressReporter(const ProgressReporter&) = delete;
+  ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+  /**
+   * @brief Count a source which will be reported to the ResultCollector.
+   */
+  void add_expected(std::size_t n = 1) {
+    expected.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Every source has been counted; the ETA can be shown.
+   */
+  void set_total_known() { total_known.store(true, std::memory_order_relaxed); }
+
+  /**
+   * @brief Print a line to os without breaking the progress line. Thread safe.
+   */
+  void log(const std::string& line, std::ostream& os);
+
+  /**
+   * @brief Start the progress thread.
+   *
+   * @param busy_time total time the workers spent in tasks so far. Must stay
+   * callable until stop().
+   */
+  void start(std::uint32_t workers, BusyTime busy_time);
+
+  /**
+   * @brief Stop the thread and finish the progress line. Idempotent.
+   */
+  void stop();
+
+ private:
+  struct Sample {
+    std::chrono::steady_clock::time_point time;
+    std::size_t files;
+    std::uint64_t bytes;
+    std::uint64_t cells;
+    std::chrono::nanoseconds busy;
+  };
+
+  void run();
+  Sample sample() const;
+  std::string format(const Sample& now) const;
+  void draw(const std::string& line);
+
+  std::ostream& out;
+  const ResultCollector& results;
+  std::uint32_t workers = 1;
+  BusyTime busy_time;
+  const std::chrono::milliseconds interval;
+  const bool terminal;
+
+  std::atomic<std::size_t> expected{0};
+  std::atomic<bool> total_known{false};
+
+  /// Guards out, shown and stopping.
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool stopping = false;
+  /// Length of the line currently drawn (terminal only).
+  std::size_t shown = 0;
+  std::string last_line;
+  /// Samples of the rate window; only the reporter thread touches it.
+  std::deque<Sample> window;
+  std::thread thread;
+};
+
+/**
+ * @brief Whether stderr is an interactive terminal.
+ */
+bool stderr_is_terminal();
+
+}  // namespace gistool
+
+#endif  // !PROGRESS_H
@@ -0,0 +1,125 @@
+#include "Shard.h"
+
+#include <algorithm>
+#include <cctype>
+#include <numeric>
+
+namespace gistool {
+
+fs::path ShardSpec::file(const fs::path& dir, const std::string& name) const {
+  if (!active()) return dir / name;
+  fs::path p(name);
+  auto stem = p.stem().string();
+  auto ext = p.extension().string();
+  return dir / (stem + ".shard-" + std::to_string(index) + "-of-" +
+                std::to_string(count) + ext);
+}
+
+bool parse_shard(const std::string& text, ShardSpec& shard) {
+  auto slash = text.find('/');
+  if (slash == std::string::npos) return false;
+  try {
+    size_t pos = 0;
+    auto index = std::stoul(text.substr(0, slash), &pos);
+    if (pos != slash) return false;
+    auto count = std::stoul(text.substr(slash + 1), &pos);
+    if (pos != text.size() - slash - 1) return false;
+    if (count == 0 || index >= count) return false;
+    shard.index = static_cast<std::uint32_t>(index);
+    shard.count = static_cast<std::uint32_t>(count);
+  } catch (std::exception&) {
+    return false;
+  }
+  return true;
+}
+
+std::string mesh_code(const fs::path& source) {
+  static const std::string prefix = "FG-GML-";
+  auto name = source.filename().string();
+  if (name.compare(0, prefix.size(), prefix) != 0) return {};
+
+  // Numeric fields right after the prefix: primary, secondary, tertiary mesh.
+  std::string code;
+  size_t pos = prefix.size();
+  while (pos < name.size()) {
+    auto end = name.find('-', pos);
+    if (end == std::string::npos) end = name.size();
+    auto field = name.substr(pos, end - pos);
+    if (field.empty() || !std::all_of(field.begin(), field.end(), [](char c) {
+          return std::isdigit(static_cast<unsigned char>(c));
+        })) {
+      break;
+    }
+    if (!code.empty()) code.push_back('-');
+    code += field;
+    pos = end + 1;
+  }
+  return code;
+}
+
+std::uint32_t stable_hash(const std::string& text) {
+  std::uint32_t h = 2166136261u;
+  for (unsigned char c : text) {
+    h ^= c;
+    h *= 16777619u;
+  }
+  return h;
+}
+
+namespace {
+std::string shard_key(const SourceFile& source, const fs::path& source_root) {
+  auto code = mesh_code(source.path);
+  return code.empty()
+             ? source.path.lexically_relative(source_root).generic_string()
+             : code;
+}
+}  // namespace
+
+bool in_shard(const SourceFile& source, const ShardSpec& shard,
+              const fs::path& source_root) {
+  if (!shard.active()) return true;
+  return stable_hash(shard_key(source, source_root)) % shard.count ==
+         shard.index;
+}
+
+std::vector<SourceFile> select_shard(const std::vector<SourceFile>& sources,
+                                     const ShardSpec& shard,
+                                     const fs::path& source_root) {
+  if (!shard.active()) return sources;
+
+  std::vector<SourceFile> ret;
+  if (!shard.balance_by_size) {
+    for (const auto& s : sources) {
+      if (in_shard(s, shard, source_root)) ret.push_back(s);
+    }
+    return ret;
+  }
+
+  // Sort by size (largest first), ties by key, so every node computes the
+  // same order regardless of directory listing order.
+  std::vector<std::pair<std::string, size_t>> order;
+  order.reserve(sources.size());
+  for (size_t i = 0; i < sources.size(); ++i) {
+    order.emplace_back(sources[i].path.lexically_relative(source_root)
+                           .generic_string(),
+                       i);
+  }
+  std::sort(order.begin(), order.end(), [&sources](const auto& a,
+                                                   const auto& b) {
+    const auto& sa = sources[a.second];
+    const auto& sb = sources[b.second];
+    if (sa.size != sb.size) return sa.size > sb.size;
+    return a.first < b.first;
+  });
+
+  std::vector<std::uint64_t> load(shard.count, 0);
+  for (const auto& [key, i] : order) {
+    auto target = static_cast<std::uint32_t>(
+        std::min_element(load.begin(), load.end()) - load.begin());
+    load[target] += std::max<std::uint64_t>(sources[i].size, 1);
+    if (target == shard.index) ret.push_back(sources[i]);
+  }
+  return ret;
+}
+
+}  // namespace gistool
@@ -0,0 +1,68 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "ConvertResult.h"
+
+namespace gistool {
+namespace fs = std::filesystem;
+
+/**
+ * @brief Selects the part of the inputs one node converts (--shard i/N).
+ *
+ * Every node enumerates the same inputs and keeps its own part; there is no
+ * coordinator. Indices are 0 based.
+ */
+struct ShardSpec {
+  std::uint32_t index = 0;
+  std::uint32_t count = 1;
+  /// Balance by input size instead of hashing.
+  bool balance_by_size = false;
+
+  bool active() const { return count > 1; }
+
+  /**
+   * @brief "manifest.tsv" -> "manifest.shard-2-of-8.tsv" when sharded.
+   */
+  fs::path file(const fs::path& dir, const std::string& name) const;
+};
+
+bool parse_shard(const std::string& text, ShardSpec& shard);
+
+/**
+ * @brief Mesh code of a GSI file name ("FG-GML-5339-45-00-DEM5A-..." ->
+ * "5339-45-00"). Empty when the name does not follow the convention.
+ */
+std::string mesh_code(const fs::path& source);
+
+/**
+ * @brief Stable 32 bit FNV-1a, identical on every platform.
+ */
+std::uint32_t stable_hash(const std::string& text);
+
+/**
+ * @brief Whether source hashes to shard. Decided per file, so sources can be
+ * filtered while they are still being enumerated.
+ */
+bool in_shard(const SourceFile& source, const ShardSpec& shard,
+              const fs::path& source_root);
+
+/**
+ * @brief Keep the sources belonging to shard.
+ *
+ * Hashing uses the mesh code (so all products of one mesh land on the same
+ * node) or the relative path. Size balancing sorts all sources by size and
+ * deals them greedily to the least loaded shard; it is deterministic as long
+ * as every node sees the same listing.
+ */
+std::vector<SourceFile> select_shard(const std::vector<SourceFile>& sources,
+                                     const ShardSpec& shard,
+                                     const fs::path& source_root);
+
+}  // namespace gistool
+
+#endif  // !SHARD_H
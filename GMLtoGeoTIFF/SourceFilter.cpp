@@ -0,0 +1,50 @@
+#include "SourceFilter.h"
+
+namespace gistool {
+
+SourceFilter::SourceFilter(const std::vector<std::string>& include,
+                           const std::vector<std::string>& exclude)
+    : includes(compile(include)), excludes(compile(exclude)) {}
+
+std::vector<SourceFilter::Pattern> SourceFilter::compile(
+    const std::vector<std::string>& patterns) {
+  std::vector<Pattern> ret;
+  ret.reserve(patterns.size());
+  for (const auto& p : patterns) {
+    // Native string type of cppglob (wide on Windows).
+    auto native = fs::path(p).native();
+    ret.push_back(Pattern{cppglob::matcher(native),
+                          p.find('/') != std::string::npos});
+  }
+  return ret;
+}
+
+bool SourceFilter::any_of(const std::vector<Pattern>& patterns,
+                          const fs::path& source,
+                          const fs::path& source_root) {
+  if (patterns.empty()) return false;
+  const auto name = source.filename().native();
+  cppglob::string_type relative;
+  for (const auto& p : patterns) {
+    if (!p.whole_path) {
+      if (p.match(name)) return true;
+      continue;
+    }
+    if (relative.empty()) {
+      relative = source.lexically_relative(source_root)
+                     .generic_string<cppglob::char_type>();
+    }
+    if (p.match(relative)) return true;
+  }
+  return false;
+}
+
+bool SourceFilter::operator()(const fs::path& source,
+                              const fs::path& source_root) const {
+  if (!includes.empty() && !any_of(includes, source, source_root)) {
+    return false;
+  }
+  return !any_of(excludes, source, source_root);
+}
+
+}  // namespace gistool
@@ -0,0 +1,45 @@
+#ifndef SOURCE_FILTER_H
+#define SOURCE_FILTER_H
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <cppglob/matcher.hpp>
+
+namespace gistool {
+namespace fs = std::filesystem;
+
+/**
+ * @brief --include/--exclude glob patterns.
+ *
+ * A pattern is matched against the file name, or against the path relative
+ * to the source root ('/' separated) when it contains a '/'. A source is
+ * kept when it matches any include (or there are none) and no exclude.
+ * Patterns are compiled once and shared by the crawler threads.
+ */
+class SourceFilter {
+ public:
+  SourceFilter(const std::vector<std::string>& include,
+               const std::vector<std::string>& exclude);
+
+  bool empty() const { return includes.empty() && excludes.empty(); }
+
+  bool operator()(const fs::path& source, const fs::path& source_root) const;
+
+ private:
+  struct Pattern {
+    cppglob::matcher match;
+    bool whole_path;
+  };
+  static std::vector<Pattern> compile(const std::vector<std::string>& patterns);
+  static bool any_of(const std::vector<Pattern>& patterns,
+                     const fs::path& source, const fs::path& source_root);
+
+  std::vector<Pattern> includes;
+  std::vector<Pattern> excludes;
+};
+
+}  // namespace gistool
+
+#endif  // !SOURCE_FILTER_H
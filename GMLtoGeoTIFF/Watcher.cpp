@@ -0,0 +1,143 @@
+#include "Watcher.h"
+
+#include <cstdint>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+namespace gistool {
+
+#ifdef __linux__
+
+namespace {
+constexpr std::uint32_t watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY |
+                                     IN_CREATE | IN_DELETE | IN_MOVED_FROM;
+
+bool hidden(const fs::path& name) {
+  auto s = name.native();
+  return !s.empty() && s[0] == '.';
+}
+}  // namespace
+
+DirectoryWatcher::~DirectoryWatcher() {
+  if (fd >= 0) ::close(fd);
+}
+
+std::error_code DirectoryWatcher::open(const fs::path& root,
+                                       bool recursive) {
+  fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) return std::error_code(errno, std::system_category());
+  this->recursive = recursive;
+  return add_tree(root, false);
+}
+
+std::error_code DirectoryWatcher::add_tree(const fs::path& dir,
+                                           bool report_files) {
+  int wd = ::inotify_add_watch(fd, dir.c_str(), watch_mask | IN_ONLYDIR);
+  if (wd < 0) return std::error_code(errno, std::system_category());
+  dirs[wd] = dir;
+  if (!recursive && !report_files) return {};
+
+  // Anything created before the watch was in place has no event of its own.
+  std::error_code ec;
+  for (fs::directory_iterator it(dir, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    auto name = it->path().filename();
+    if (hidden(name)) continue;
+    std::error_code type_ec;
+    if (it->is_directory(type_ec)) {
+      if (recursive) add_tree(it->path(), report_files);
+    } else if (report_files) {
+      auto& p = pending[it->path()];
+      p.last = Clock::now();
+      p.complete = true;
+    }
+  }
+  return {};
+}
+
+void DirectoryWatcher::read_events() {
+  alignas(inotify_event) char buf[64 * 1024];
+  for (;;) {
+    ssize_t n = ::read(fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return;
+
+    const auto now = Clock::now();
+    for (char* p = buf; p < buf + n;) {
+      const auto* ev = reinterpret_cast<const inotify_event*>(p);
+      p += sizeof(inotify_event) + ev->len;
+
+      if (ev->mask & IN_Q_OVERFLOW) {
+        overflow = true;
+        continue;
+      }
+      auto dir = dirs.find(ev->wd);
+      if (dir == dirs.end()) continue;
+      if (ev->mask & IN_IGNORED) {
+        dirs.erase(dir);
+        continue;
+      }
+      if (ev->len == 0 || ev->name[0] == '\0') continue;
+      fs::path name(ev->name);
+      if (hidden(name)) continue;
+      auto path = dir->second / name;
+
+      if (ev->mask & IN_ISDIR) {
+        if (recursive && (ev->mask & (IN_CREATE | IN_MOVED_TO))) {
+          add_tree(path, true);
+        }
+        continue;
+      }
+      if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        pending.erase(path);
+        continue;
+      }
+      auto& entry = pending[path];
+      entry.last = now;
+      if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) entry.complete = true;
+    }
+  }
+}
+
+void DirectoryWatcher::poll(std::chrono::milliseconds timeout,
+                            std::vector<fs::path>& ready) {
+  pollfd p{fd, POLLIN, 0};
+  if (::poll(&p, 1, static_cast<int>(timeout.count())) > 0) read_events();
+
+  const auto now = Clock::now();
+  for (auto it = pending.begin(); it != pending.end();) {
+    if (it->second.complete && now - it->second.last >= settle) {
+      ready.push_back(it->first);
+      it = pending.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+#else
+
+DirectoryWatcher::~DirectoryWatcher() = default;
+
+std::error_code DirectoryWatcher::open(const fs::path&, bool) {
+  return std::make_error_code(std::errc::not_supported);
+}
+
+std::error_code DirectoryWatcher::add_tree(const fs::path&, bool) {
+  return std::make_error_code(std::errc::not_supported);
+}
+
+void DirectoryWatcher::read_events() {}
+
+void DirectoryWatcher::poll(std::chrono::milliseconds,
+                            std::vector<fs::path>&) {}
+
+#endif
+
+}  // namespace gistool
@@ -0,0 +1,77 @@
+#ifndef WATCHER_H
+#define WATCHER_H
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace gistool {
+namespace fs = std::filesystem;
+
+/**
+ * @brief Reports files that arrive under a directory (--watch).
+ *
+ * Uses inotify (Linux only): a file becomes ready after it was closed for
+ * writing or moved in, and then stayed untouched for settle, so a file that
+ * is written in several passes is converted once. Names starting with '.' are
+ * ignored, which covers the temporary files rsync renames into place.
+ * Directories created under a recursive watch are watched as well, and files
+ * already inside them are reported.
+ */
+class DirectoryWatcher {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  DirectoryWatcher() = default;
+  ~DirectoryWatcher();
+
+  DirectoryWatcher(const DirectoryWatcher&) = delete;
+  DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+  /**
+   * @brief Start watching. errc::not_supported where inotify is missing.
+   */
+  std::error_code open(const fs::path& root, bool recursive);
+
+  void set_settle(std::chrono::milliseconds settle) { this->settle = settle; }
+
+  /**
+   * @brief Wait up to timeout for events, then append the files that have
+   * settled to ready.
+   */
+  void poll(std::chrono::milliseconds timeout, std::vector<fs::path>& ready);
+
+  /**
+   * @brief Whether events were lost (kernel queue overflow) since the last
+   * call; the caller should rescan the tree.
+   */
+  bool take_overflow() {
+    bool ret = overflow;
+    overflow = false;
+    return ret;
+  }
+
+ private:
+  struct Pending {
+    Clock::time_point last;
+    /// Closed after writing or moved in.
+    bool complete = false;
+  };
+
+  std::error_code add_tree(const fs::path& dir, bool report_files);
+  void read_events();
+
+  int fd = -1;
+  bool recursive = false;
+  std::unordered_map<int, fs::path> dirs;
+  std::map<fs::path, Pending> pending;
+  std::chrono::milliseconds settle{2000};
+  bool overflow = false;
+};
+
+}  // namespace gistool
+
+#endif  // !WATCHER_H
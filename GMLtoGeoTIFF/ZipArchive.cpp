@@ -0,0 +1,518 @@
+#include "ZipArchive.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace gistool {
+
+/**
+ * @brief Positional reads from a file or a memory buffer.
+ */
+class RandomAccess {
+ public:
+  virtual ~RandomAccess() = default;
+  virtual std::uint64_t size() const = 0;
+  virtual std::error_code read_at(std::uint64_t offset, void* dst,
+                                  std::size_t n) const = 0;
+};
+
+namespace {
+
+std::error_code corrupt() {
+  return std::make_error_code(std::errc::illegal_byte_sequence);
+}
+
+std::uint16_t u16(const unsigned char* p) {
+  return static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+}
+
+std::uint32_t u32(const unsigned char* p) {
+  return static_cast<std::uint32_t>(p[0]) |
+         (static_cast<std::uint32_t>(p[1]) << 8) |
+         (static_cast<std::uint32_t>(p[2]) << 16) |
+         (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+std::uint64_t u64(const unsigned char* p) {
+  return static_cast<std::uint64_t>(u32(p)) |
+         (static_cast<std::uint64_t>(u32(p + 4)) << 32);
+}
+
+#ifdef _WIN32
+/// No pread on Windows; reads are serialized, inflating is not.
+class FileAccess : public RandomAccess {
+ public:
+  std::error_code open(const fs::path& path) {
+    stream.open(path, std::ios::binary | std::ios::ate);
+    if (!stream) return std::make_error_code(std::errc::no_such_file_or_directory);
+    length = static_cast<std::uint64_t>(stream.tellg());
+    return {};
+  }
+  std::uint64_t size() const override { return length; }
+  std::error_code read_at(std::uint64_t offset, void* dst,
+                          std::size_t n) const override {
+    std::lock_guard<std::mutex> lock(mutex);
+    stream.clear();
+    stream.seekg(static_cast<std::streamoff>(offset));
+    stream.read(static_cast<char*>(dst), static_cast<std::streamsize>(n));
+    if (!stream) return std::make_error_code(std::errc::io_error);
+    return {};
+  }
+
+ private:
+  mutable std::mutex mutex;
+  mutable std::ifstream stream;
+  std::uint64_t length = 0;
+};
+#else
+class FileAccess : public RandomAccess {
+ public:
+  ~FileAccess() override {
+    if (fd >= 0) ::close(fd);
+  }
+  std::error_code open(const fs::path& path) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return std::error_code(errno, std::system_category());
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      return std::error_code(errno, std::system_category());
+    }
+    length = static_cast<std::uint64_t>(st.st_size);
+    return {};
+  }
+  std::uint64_t size() const override { return length; }
+  std::error_code read_at(std::uint64_t offset, void* dst,
+                          std::size_t n) const override {
+    auto p = static_cast<char*>(dst);
+    while (n > 0) {
+      ssize_t r = ::pread(fd, p, n, static_cast<off_t>(offset));
+      if (r < 0 && errno == EINTR) continue;
+      if (r < 0) return std::error_code(errno, std::system_category());
+      if (r == 0) return std::make_error_code(std::errc::io_error);
+      p += r;
+      offset += static_cast<std::uint64_t>(r);
+      n -= static_cast<std::size_t>(r);
+    }
+    return {};
+  }
+
+ private:
+  int fd = -1;
+  std::uint64_t length = 0;
+};
+#endif
+
+class MemoryAccess : public RandomAccess {
+ public:
+  explicit MemoryAccess(std::shared_ptr<const IoBuffer> buffer)
+      : data(std::move(buffer)) {}
+  // IoBuffer carries a trailing zero which is not part of the archive.
+  std::uint64_t size() const override {
+    return data->empty() ? 0 : data->size() - 1;
+  }
+  std::error_code read_at(std::uint64_t offset, void* dst,
+                          std::size_t n) const override {
+    if (offset > size() || n > size() - offset) return corrupt();
+    std::memcpy(dst, data->data() + offset, n);
+    return {};
+  }
+
+ private:
+  std::shared_ptr<const IoBuffer> data;
+};
+
+bool ends_with(const std::string& s, const char* suffix) {
+  auto n = std::strlen(suffix);
+  if (s.size() < n) return false;
+  return std::equal(s.end() - n, s.end(), suffix, [](char a, char b) {
+    return std::tolower(static_cast<unsigned char>(a)) == b;
+  });
+}
+
+}  // namespace
+
+ZipArchive::ZipArchive() = default;
+ZipArchive::~ZipArchive() = default;
+
+std::error_code ZipArchive::open(const fs::path& path) {
+  auto f = std::make_unique<FileAccess>();
+  if (auto ec = f->open(path)) return ec;
+  file = std::move(f);
+  return read_directory();
+}
+
+std::error_code ZipArchive::open(std::shared_ptr<const IoBuffer> data) {
+  file = std::make_unique<MemoryAccess>(std::move(data));
+  return read_directory();
+}
+
+std::error_code ZipArchive::read_directory() {
+  const std::uint64_t size = file->size();
+  if (size < 22) return corrupt();
+
+  // End of central directory record: 22 bytes plus a comment of up to 64KB.
+  const std::uint64_t tail = std::min<std::uint64_t>(size, 22 + 65535);
+  std::vector<unsigned char> buf(static_cast<size_t>(tail));
+  if (auto ec = file->read_at(size - tail, buf.data(), buf.size())) return ec;
+
+  std::int64_t eocd = -1;
+  for (std::int64_t i = static_cast<std::int64_t>(tail) - 22; i >= 0; --i) {
+    if (u32(&buf[i]) == 0x06054b50) {
+      eocd = i;
+      break;
+    }
+  }
+  if (eocd < 0) return corrupt();
+
+  const unsigned char* e = &buf[eocd];
+  std::uint64_t count = u16(e + 10);
+  std::uint64_t cd_size = u32(e + 12);
+  std::uint64_t cd_offset = u32(e + 16);
+
+  if ((count == 0xFFFF || cd_size == 0xFFFFFFFF || cd_offset == 0xFFFFFFFF) &&
+      eocd >= 20 && u32(&buf[eocd - 20]) == 0x07064b50) {
+    unsigned char z64[56];
+    if (auto ec = file->read_at(u64(&buf[eocd - 20 + 8]), z64, sizeof(z64))) {
+      return ec;
+    }
+    if (u32(z64) != 0x06064b50) return corrupt();
+    count = u64(z64 + 32);
+    cd_size = u64(z64 + 40);
+    cd_offset = u64(z64 + 48);
+  }
+  if (cd_offset > size || cd_size > size - cd_offset) return corrupt();
+  // Each central directory header takes at least 46 bytes; a larger count
+  // is corrupt and must not size the reservation below.
+  if (count > cd_size / 46) return corrupt();
+
+  std::vector<unsigned char> cd(static_cast<size_t>(cd_size));
+  if (auto ec = file->read_at(cd_offset, cd.data(), cd.size())) return ec;
+
+  entry_list.clear();
+  entry_index.clear();
+  entry_list.reserve(static_cast<size_t>(count));
+  entry_index.reserve(static_cast<size_t>(count));
+  size_t pos = 0;
+  for (std::uint64_t i = 0; i < count; ++i) {
+    if (pos + 46 > cd.size() || u32(&cd[pos]) != 0x02014b50) return corrupt();
+    const unsigned char* h = &cd[pos];
+    ZipEntry entry;
+    entry.method = u16(h + 10);
+    entry.dos_time = u16(h + 12);
+    entry.dos_date = u16(h + 14);
+    entry.crc = u32(h + 16);
+    entry.compressed_size = u32(h + 20);
+    entry.uncompressed_size = u32(h + 24);
+    const size_t name_len = u16(h + 28);
+    const size_t extra_len = u16(h + 30);
+    const size_t comment_len = u16(h + 32);
+    entry.local_header_offset = u32(h + 42);
+    if (pos + 46 + name_len + extra_len + comment_len > cd.size()) {
+      return corrupt();
+    }
+    entry.name.assign(reinterpret_cast<const char*>(h + 46), name_len);
+
+    // ZIP64 extended information holds the fields saturated above, in order.
+    const unsigned char* x = h + 46 + name_len;
+    const unsigned char* x_end = x + extra_len;
+    while (x + 4 <= x_end) {
+      const std::uint16_t id = u16(x);
+      const std::uint16_t len = u16(x + 2);
+      const unsigned char* v = x + 4;
+      if (v + len > x_end) break;
+      if (id == 0x0001) {
+        const unsigned char* v_end = v + len;
+        if (entry.uncompressed_size == 0xFFFFFFFF && v + 8 <= v_end) {
+          entry.uncompressed_size = u64(v);
+          v += 8;
+        }
+        if (entry.compressed_size == 0xFFFFFFFF && v + 8 <= v_end) {
+          entry.compressed_size = u64(v);
+          v += 8;
+        }
+        if (entry.local_header_offset == 0xFFFFFFFF && v + 8 <= v_end) {
+          entry.local_header_offset = u64(v);
+        }
+      }
+      x += 4 + len;
+    }
+
+    // Like a scan of the list, the first of duplicate names wins.
+    entry_index.emplace(entry.name, entry_list.size());
+    entry_list.push_back(std::move(entry));
+    pos += 46 + name_len + extra_len + comment_len;
+  }
+  return {};
+}
+
+const ZipEntry* ZipArchive::find(const std::string& name) const {
+  auto it = entry_index.find(name);
+  return it == entry_index.end() ? nullptr : &entry_list[it->second];
+}
+
+std::error_code ZipArchive::extract(const ZipEntry& entry,
+                                    IoBuffer& out) const {
+  if (entry.compressed_size > UINT_MAX || entry.uncompressed_size > UINT_MAX) {
+    return std::make_error_code(std::errc::file_too_large);
+  }
+  // Sizes come from the header; check them before they size allocations.
+  // Deflate expands at most 1032:1.
+  if (entry.compressed_size > file->size() ||
+      (entry.method == 0 &&
+       entry.uncompressed_size != entry.compressed_size) ||
+      entry.uncompressed_size / 1032 > entry.compressed_size) {
+    return corrupt();
+  }
+  unsigned char local[30];
+  if (auto ec = file->read_at(entry.local_header_offset, local, sizeof(local))) {
+    return ec;
+  }
+  if (u32(local) != 0x04034b50) return corrupt();
+  const std::uint64_t data_offset =
+      entry.local_header_offset + 30 + u16(local + 26) + u16(local + 28);
+
+  const auto usize = static_cast<size_t>(entry.uncompressed_size);
+  const auto csize = static_cast<size_t>(entry.compressed_size);
+  out.resize(usize + 1);
+
+  if (entry.method == 0) {
+    if (auto ec = file->read_at(data_offset, out.data(), usize)) return ec;
+  } else if (entry.method == 8) {
+    std::vector<unsigned char> packed(csize);
+    if (auto ec = file->read_at(data_offset, packed.data(), csize)) return ec;
+
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+      return std::make_error_code(std::errc::not_enough_memory);
+    }
+    zs.next_in = packed.data();
+    zs.avail_in = static_cast<uInt>(csize);
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = static_cast<uInt>(usize);
+    const int rc = inflate(&zs, Z_FINISH);
+    const bool complete = rc == Z_STREAM_END && zs.total_out == usize;
+    inflateEnd(&zs);
+    if (!complete) return corrupt();
+  } else {
+    return std::make_error_code(std::errc::not_supported);
+  }
+
+  const auto crc = crc32(0L, reinterpret_cast<const Bytef*>(out.data()),
+                         static_cast<uInt>(usize));
+  if (crc != entry.crc) return corrupt();
+  out[usize] = 0;
+  return {};
+}
+
+namespace {
+
+/**
+ * @brief Identity of an archive file on disk. A file replaced or rewritten
+ * in place (--watch, a re-downloaded tile) no longer matches.
+ */
+struct FileStamp {
+  std::uint64_t size = 0;
+  std::int64_t mtime = 0;
+  std::uint64_t inode = 0;
+
+  bool operator==(const FileStamp& o) const {
+    return size == o.size && mtime == o.mtime && inode == o.inode;
+  }
+};
+
+std::error_code stamp_file(const fs::path& path, FileStamp& stamp) {
+#ifdef _WIN32
+  std::error_code ec;
+  stamp.size = fs::file_size(path, ec);
+  if (ec) return ec;
+  auto t = fs::last_write_time(path, ec);
+  if (ec) return ec;
+  stamp.mtime = static_cast<std::int64_t>(t.time_since_epoch().count());
+  stamp.inode = 0;
+#else
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0) {
+    return std::error_code(errno, std::system_category());
+  }
+  stamp.size = static_cast<std::uint64_t>(st.st_size);
+  stamp.mtime = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1000000000 +
+                st.st_mtim.tv_nsec;
+  stamp.inode = static_cast<std::uint64_t>(st.st_ino);
+#endif
+  return {};
+}
+
+/**
+ * @brief Archives opened by read_source, least recently used first out.
+ * Nested archives live in memory, so the cache is kept small. Entries carry
+ * the stamp of the outermost archive file they were read from; get() drops
+ * an entry whose stamp no longer matches.
+ */
+class ArchiveCache {
+ public:
+  std::shared_ptr<ZipArchive> get(const std::string& key,
+                                  const FileStamp& stamp) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = lru.begin(); it != lru.end(); ++it) {
+      if (it->key == key) {
+        if (!(it->stamp == stamp)) {
+          lru.erase(it);
+          return nullptr;
+        }
+        lru.splice(lru.begin(), lru, it);
+        return it->archive;
+      }
+    }
+    return nullptr;
+  }
+
+  void put(const std::string& key, const FileStamp& stamp,
+           std::shared_ptr<ZipArchive> archive) {
+    std::lock_guard<std::mutex> lock(mutex);
+    lru.remove_if([&key](const Entry& e) { return e.key == key; });
+    lru.push_front({key, stamp, std::move(archive)});
+    if (lru.size() > capacity) lru.pop_back();
+  }
+
+ private:
+  struct Entry {
+    std::string key;
+    FileStamp stamp;
+    std::shared_ptr<ZipArchive> archive;
+  };
+
+  std::mutex mutex;
+  std::list<Entry> lru;
+  const size_t capacity = 16;
+};
+
+ArchiveCache& archive_cache() {
+  static ArchiveCache cache;
+  return cache;
+}
+
+/**
+ * @brief "a.zip!/b.zip!/c.xml" -> {"a.zip", "b.zip", "c.xml"}.
+ */
+std::vector<std::string> split_member(const std::string& path) {
+  std::vector<std::string> parts;
+  size_t start = 0;
+  for (;;) {
+    auto pos = path.find('!', start);
+    while (pos != std::string::npos && pos + 1 < path.size() &&
+           path[pos + 1] != '/' && path[pos + 1] != '\\') {
+      pos = path.find('!', pos + 1);
+    }
+    if (pos == std::string::npos || pos + 1 >= path.size()) {
+      parts.push_back(path.substr(start));
+      return parts;
+    }
+    parts.push_back(path.substr(start, pos - start));
+    start = pos + 2;
+  }
+}
+
+std::error_code open_nested(const std::shared_ptr<ZipArchive>& parent,
+                            const std::string& name,
+                            std::shared_ptr<ZipArchive>& out) {
+  auto entry = parent->find(name);
+  if (!entry) return std::make_error_code(std::errc::no_such_file_or_directory);
+  auto data = std::make_shared<IoBuffer>();
+  if (auto ec = parent->extract(*entry, *data)) return ec;
+  auto archive = std::make_shared<ZipArchive>();
+  if (auto ec = archive->open(std::move(data))) return ec;
+  out = std::move(archive);
+  return {};
+}
+
+std::error_code list_into(const std::shared_ptr<ZipArchive>& archive,
+                          const std::string& prefix,
+                          std::vector<SourceFile>& sources) {
+  for (const auto& e : archive->entries()) {
+    if (e.name.empty() || e.name.back() == '/') continue;
+    const std::string path = prefix + archive_separator + e.name;
+    if (ends_with(e.name, ".xml")) {
+      SourceFile source{fs::path(path)};
+      source.size = e.uncompressed_size;
+      source.mtime = (static_cast<std::int64_t>(e.dos_date) << 16) | e.dos_time;
+      sources.push_back(std::move(source));
+    } else if (is_zip_path(fs::path(e.name))) {
+      std::shared_ptr<ZipArchive> nested;
+      if (auto ec = open_nested(archive, e.name, nested)) return ec;
+      if (auto ec = list_into(nested, path, sources)) return ec;
+    }
+  }
+  return {};
+}
+
+}  // namespace
+
+bool is_zip_path(const fs::path& path) {
+  return ends_with(path.string(), ".zip");
+}
+
+bool is_archive_member(const fs::path& path) {
+  const auto s = path.string();
+  for (auto pos = s.find('!'); pos != std::string::npos;
+       pos = s.find('!', pos + 1)) {
+    if (pos + 1 < s.size() && (s[pos + 1] == '/' || s[pos + 1] == '\\') &&
+        ends_with(s.substr(0, pos), ".zip")) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::error_code read_source(const fs::path& path, IoBuffer& buffer) {
+  if (!is_archive_member(path)) return read_file(path, buffer);
+
+  const auto parts = split_member(path.string());
+  auto& cache = archive_cache();
+  FileStamp stamp;
+  if (auto ec = stamp_file(fs::path(parts[0]), stamp)) return ec;
+  std::string key = parts[0];
+  auto archive = cache.get(key, stamp);
+  if (!archive) {
+    archive = std::make_shared<ZipArchive>();
+    if (auto ec = archive->open(fs::path(parts[0]))) return ec;
+    cache.put(key, stamp, archive);
+  }
+
+  for (size_t i = 1; i + 1 < parts.size(); ++i) {
+    key += archive_separator + parts[i];
+    auto nested = cache.get(key, stamp);
+    if (!nested) {
+      if (auto ec = open_nested(archive, parts[i], nested)) return ec;
+      cache.put(key, stamp, nested);
+    }
+    archive = std::move(nested);
+  }
+
+  auto entry = archive->find(parts.back());
+  if (!entry) return std::make_error_code(std::errc::no_such_file_or_directory);
+  return archive->extract(*entry, buffer);
+}
+
+std::error_code list_archive(const fs::path& archive,
+                             std::vector<SourceFile>& sources) {
+  auto zip = std::make_shared<ZipArchive>();
+  if (auto ec = zip->open(archive)) return ec;
+  return list_into(zip, archive.string(), sources);
+}
+
+}  // namespace gistool
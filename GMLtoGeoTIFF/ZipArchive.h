@@ -0,0 +1,108 @@
+#ifndef ZIP_ARCHIVE_H
+#define ZIP_ARCHIVE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "AsyncIO.h"
+#include "ConvertResult.h"
+
+namespace gistool {
+namespace fs = std::filesystem;
+
+/// Separator between an archive and a member in source paths, as in
+/// "FG-GML-5339.zip!/FG-GML-5339-45-00-DEM5A-20161001.xml". Nested archives
+/// repeat it: "outer.zip!/inner.zip!/member.xml".
+constexpr const char* archive_separator = "!/";
+
+struct ZipEntry {
+  std::string name;
+  std::uint16_t method = 0;
+  std::uint32_t crc = 0;
+  std::uint16_t dos_time = 0;
+  std::uint16_t dos_date = 0;
+  std::uint64_t compressed_size = 0;
+  std::uint64_t uncompressed_size = 0;
+  std::uint64_t local_header_offset = 0;
+};
+
+class RandomAccess;
+
+/**
+ * @brief Read-only ZIP archive (stored and deflated members, ZIP64).
+ *
+ * Only the central directory is read on open. extract() may be called from
+ * several threads at once; each call reads and inflates one member, so
+ * members of one archive decompress in parallel.
+ */
+class ZipArchive {
+ public:
+  ZipArchive();
+  ~ZipArchive();
+
+  ZipArchive(const ZipArchive&) = delete;
+  ZipArchive& operator=(const ZipArchive&) = delete;
+
+  std::error_code open(const fs::path& path);
+
+  /**
+   * @brief Open an archive held in memory (a member of another archive).
+   */
+  std::error_code open(std::shared_ptr<const IoBuffer> data);
+
+  const std::vector<ZipEntry>& entries() const { return entry_list; }
+
+  const ZipEntry* find(const std::string& name) const;
+
+  /**
+   * @brief Inflate a member into a zero terminated buffer and check its CRC.
+   */
+  std::error_code extract(const ZipEntry& entry, IoBuffer& out) const;
+
+ private:
+  std::error_code read_directory();
+
+  std::unique_ptr<RandomAccess> file;
+  std::vector<ZipEntry> entry_list;
+  /// Name to position in entry_list, so find() is O(1) per member.
+  std::unordered_map<std::string, std::size_t> entry_index;
+};
+
+/**
+ * @brief True for "*.zip" in any letter case (GSI archives are named both
+ * FG-GML-*.zip and FG-GML-*.ZIP).
+ */
+bool is_zip_path(const fs::path& path);
+
+/**
+ * @brief True when path names a member, "a.zip!/b.xml", the archive
+ * extension matched in any letter case.
+ */
+bool is_archive_member(const fs::path& path);
+
+/**
+ * @brief Read a plain file, or the member of a (nested) archive named by a
+ * path containing archive_separator.
+ *
+ * Opened archives are cached, so extracting many members of one archive only
+ * reads its central directory once. The archive file is stat'ed on every
+ * call; a cached archive whose size, mtime or inode changed is reopened.
+ */
+std::error_code read_source(const fs::path& path, IoBuffer& buffer);
+
+/**
+ * @brief Append the .xml members of archive (recursing into nested .zip
+ * members) as sources. Member size and DOS timestamp stand in for the file
+ * size and mtime recorded by the manifest.
+ */
+std::error_code list_archive(const fs::path& archive,
+                             std::vector<SourceFile>& sources);
+
+}  // namespace gistool
+
+#endif  // !ZIP_ARCHIVE_H
@@ -1,15 +1,55 @@
-from osgeo import gdal
 import os
 import sys
 
-# sys.argv属性にはpythonコマンドで実行するスクリプトに
-# 与えられたコマンドライン引数が渡される（スクリプトファイル名を含む）
-print("sys.argv:", sys.argv)
+import numpy as np
+import tlgml
 
-script_file_name = sys.argv[0]
-print("script file name:", script_file_name)
+# 使い方: python batch.py <入力ディレクトリ> [出力ディレクトリ] [スレッド数]
+# 入力ディレクトリ以下のDEM(*.xml)をtlgml拡張モジュールでプロセス内で
+# NumPy配列に展開する。ファイルごとにプロセスを起こしたり、一時的な
+# TIFFを書いたりはしない。出力ディレクトリを指定すると、配列を.npyで、
+# ジオトランスフォームを同名の.txtで保存する。
+if len(sys.argv) < 2:
+    print("usage: python batch.py <source dir> [output dir] [threads]")
+    sys.exit(2)
 
-cmdline_option0 = sys.argv[1]
-print("command line option[0]:", cmdline_option0)
+source_directory = sys.argv[1]
+output_directory = sys.argv[2] if len(sys.argv) > 2 else None
+threads = int(sys.argv[3]) if len(sys.argv) > 3 else 0
 
-path = sys.argv[1]
+paths = []
+for root, _, files in os.walk(source_directory):
+    paths.extend(os.path.join(root, f) for f in files if f.endswith(".xml"))
+paths.sort()
+
+# 読み込み・展開はC++のスレッドプールで並列に行われ、その間GILは解放される。
+# 全ファイルを一度に展開するとメモリに載りきらないので、ワーカー数の4倍ずつ
+# 読み、保存してから次の分を読む。
+chunk_size = 4 * (threads or os.cpu_count() or 1)
+
+failed = 0
+for start in range(0, len(paths), chunk_size):
+    chunk = paths[start:start + chunk_size]
+    results = tlgml.read_many(chunk, threads=threads, return_exceptions=True)
+    for path, result in zip(chunk, results):
+        if isinstance(result, Exception):
+            failed += 1
+            print("Failed:", result, file=sys.stderr)
+            continue
+        dem, header = result
+        valid = dem[dem != tlgml.NODATA]
+        print("%s\t%dx%d\t%s" % (
+            path, header["cols"], header["rows"],
+            "%.2f..%.2f" % (valid.min(), valid.max()) if valid.size else "no data"))
+        if output_directory:
+            name = os.path.splitext(os.path.relpath(path, source_directory))[0]
+            out = os.path.join(output_directory, name)
+            os.makedirs(os.path.dirname(out), exist_ok=True)
+            np.save(out + ".npy", dem)
+            with open(out + ".txt", "w") as f:
+                f.write(" ".join(repr(v) for v in header["geotransform"]) + "\n")
+    # この分の配列を手放してから次を読む。
+    results = result = dem = valid = None
+
+print("%d files, %d failed" % (len(paths), failed))
+sys.exit(1 if failed else 0)
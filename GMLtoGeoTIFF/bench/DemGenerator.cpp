@@ -0,0 +1,144 @@
+﻿#include "DemGenerator.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+namespace gistool {
+namespace bench {
+namespace {
+
+/// 8 digit mesh code (first, second level and the 10 x 10 DEM5A tile).
+std::string mesh_code(double lat, double lon) {
+  // Nudge into the tile so corners on a mesh boundary round the right way.
+  const double y = lat * 1.5 + 1e-9;
+  const double x = lon - 100 + 1e-9;
+  const int p = static_cast<int>(y);
+  const int u = static_cast<int>(x);
+  const int q = static_cast<int>((y - p) * 8);
+  const int v = static_cast<int>((x - u) * 8);
+  const int r = static_cast<int>(((y - p) * 8 - q) * 10);
+  const int w = static_cast<int>(((x - u) * 8 - v) * 10);
+  char code[32];
+  std::snprintf(code, sizeof(code), "%02d%02d-%d%d-%d%d", p, u, q, v, r, w);
+  return code;
+}
+
+}  // namespace
+
+std::string generate_dem(const DemSpec& spec) {
+  const auto mesh = mesh_code(spec.lower_lat, spec.lower_lon);
+  std::string mesh_digits;
+  for (char c : mesh) {
+    if (c != '-') mesh_digits += c;
+  }
+
+  std::string xml;
+  const std::size_t cells = static_cast<std::size_t>(spec.cols) * spec.rows;
+  xml.reserve(2048 + cells * 20);
+  char line[256];
+
+  xml +=
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+      "<Dataset xsi:schemaLocation=\"http://fgd.gsi.go.jp/spec/2008/"
+      "FGD_GMLSchema FGD_GMLSchema.xsd\" "
+      "xmlns:gml=\"http://www.opengis.net/gml/3.2\" "
+      "xmlns=\"http://fgd.gsi.go.jp/spec/2008/FGD_GMLSchema\" "
+      "xmlns:xlink=\"http://www.w3.org/1999/xlink\" "
+      "xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\" "
+      "gml:id=\"Dataset1\">\n"
+      "<gml:description>基盤地図情報メタデータ ID=fmdid:15-3101"
+      "</gml:description>\n"
+      "<gml:name>基盤地図情報ダウンロードデータ（GML版）</gml:name>\n"
+      "<DEM gml:id=\"DEM001\">\n";
+  xml += "<fid>fgoid:10-00100-15-60101-" + mesh_digits + "</fid>\n";
+  xml +=
+      "<lfSpanFr gml:id=\"DEM001-1\"><gml:timePosition>2016-10-01"
+      "</gml:timePosition></lfSpanFr>\n"
+      "<devDate gml:id=\"DEM001-2\"><gml:timePosition>2016-10-01"
+      "</gml:timePosition></devDate>\n"
+      "<orgGILvl>0</orgGILvl>\n"
+      "<orgMDId>H23G0001</orgMDId>\n"
+      "<type>5mメッシュ（標高）</type>\n";
+  xml += "<mesh>" + mesh_digits + "</mesh>\n";
+  xml +=
+      "<coverage gml:id=\"DEM001-3\">\n"
+      "<gml:boundedBy>\n"
+      "<gml:Envelope srsName=\"fguuid:jgd2011.bl\">\n";
+  std::snprintf(line, sizeof(line),
+                "<gml:lowerCorner>%.12g %.12g</gml:lowerCorner>\n"
+                "<gml:upperCorner>%.12g %.12g</gml:upperCorner>\n",
+                spec.lower_lat, spec.lower_lon, spec.lower_lat + spec.lat_span,
+                spec.lower_lon + spec.lon_span);
+  xml += line;
+  xml +=
+      "</gml:Envelope>\n"
+      "</gml:boundedBy>\n"
+      "<gml:gridDomain>\n"
+      "<gml:Grid gml:id=\"DEM001-4\" dimension=\"2\">\n"
+      "<gml:limits>\n"
+      "<gml:GridEnvelope>\n"
+      "<gml:low>0 0</gml:low>\n";
+  std::snprintf(line, sizeof(line), "<gml:high>%u %u</gml:high>\n",
+                spec.cols - 1, spec.rows - 1);
+  xml += line;
+  xml +=
+      "</gml:GridEnvelope>\n"
+      "</gml:limits>\n"
+      "<gml:axisLabels>x y</gml:axisLabels>\n"
+      "</gml:Grid>\n"
+      "</gml:gridDomain>\n"
+      "<gml:rangeSet>\n"
+      "<gml:DataBlock>\n"
+      "<gml:rangeParameters><QuantityList uom=\"DEM構成点\"/>"
+      "</gml:rangeParameters>\n"
+      "<gml:tupleList>\n";
+
+  // Sum of a few sines: smooth like real terrain, so values have the usual
+  // number of digits and neighbouring cells are similar.
+  std::mt19937_64 rng(spec.seed);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  double phase[4];
+  for (auto& p : phase) p = uniform(rng) * 6.283185307179586;
+  const auto first = static_cast<std::size_t>(spec.start_cell());
+  for (std::size_t i = first; i < cells; ++i) {
+    const double x = static_cast<double>(i % spec.cols) / spec.cols;
+    const double y = static_cast<double>(i / spec.cols) / spec.rows;
+    if (uniform(rng) < spec.nodata_ratio) {
+      xml += "データなし,-9999.\n";
+      continue;
+    }
+    const double h = 120 + 80 * std::sin(3.1 * x + phase[0]) +
+                     45 * std::sin(5.3 * y + phase[1]) +
+                     12 * std::sin(17.0 * (x + y) + phase[2]) +
+                     3 * std::sin(41.0 * x * y + phase[3]);
+    std::snprintf(line, sizeof(line), "地表面,%.2f\n", h);
+    xml += line;
+  }
+
+  xml +=
+      "</gml:tupleList>\n"
+      "</gml:DataBlock>\n"
+      "</gml:rangeSet>\n"
+      "<gml:coverageFunction>\n"
+      "<gml:GridFunction>\n"
+      "<gml:sequenceRule order=\"+x-y\">Linear</gml:sequenceRule>\n";
+  std::snprintf(line, sizeof(line), "<gml:startPoint>%u %u</gml:startPoint>\n",
+                spec.start_x, spec.start_y);
+  xml += line;
+  xml +=
+      "</gml:GridFunction>\n"
+      "</gml:coverageFunction>\n"
+      "</coverage>\n"
+      "</DEM>\n"
+      "</Dataset>\n";
+  return xml;
+}
+
+std::string dem_file_name(const DemSpec& spec) {
+  return "FG-GML-" + mesh_code(spec.lower_lat, spec.lower_lon) +
+         "-DEM5A-20161001.xml";
+}
+
+}  // namespace bench
+}  // namespace gistool
@@ -0,0 +1,52 @@
+#ifndef DEM_GENERATOR_H
+#define DEM_GENERATOR_H
+
+#include <cstdint>
+#include <string>
+
+namespace gistool {
+namespace bench {
+
+/**
+ * @brief Shape of a synthetic JPGIS DEM (the GSI "FG-GML-*-DEM5A" layout).
+ *
+ * The defaults are one DEM5A tile: 225 x 150 cells covering 45" x 30" of a
+ * second level mesh.
+ */
+struct DemSpec {
+  std::uint32_t cols = 225;
+  std::uint32_t rows = 150;
+  /// Share of the tuples written as "no data" (-9999.), at random cells.
+  double nodata_ratio = 0.0;
+  /// gml:startPoint. Tuples before it are omitted, as GSI does for tiles
+  /// that only partly cover land.
+  std::uint32_t start_x = 0;
+  std::uint32_t start_y = 0;
+  /// South west corner and extent in degrees (JGD2011).
+  double lower_lat = 35.0;
+  double lower_lon = 139.0;
+  double lat_span = 30.0 / 3600;
+  double lon_span = 45.0 / 3600;
+  std::uint64_t seed = 1;
+
+  /** @brief Cell of the first tuple, as GridHeader::start. */
+  std::uint64_t start_cell() const {
+    return static_cast<std::uint64_t>(start_y) * cols + start_x;
+  }
+};
+
+/**
+ * @brief XML of a DEM with smooth, reproducible terrain for the same spec.
+ */
+std::string generate_dem(const DemSpec& spec);
+
+/**
+ * @brief GSI style file name of the tile at the spec's lower corner, e.g.
+ * FG-GML-5339-46-40-DEM5A-20161001.xml.
+ */
+std::string dem_file_name(const DemSpec& spec);
+
+}  // namespace bench
+}  // namespace gistool
+
+#endif  // !DEM_GENERATOR_H
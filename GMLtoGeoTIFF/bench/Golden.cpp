@@ -0,0 +1,270 @@
+#include "Golden.h"
+
+#include <gdal_priv.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sstream>
+
+#include "GdalWorker.h"
+#include "GmlDoc.h"
+#include "Manifest.h"
+#include "ZipArchive.h"
+#include "threadpool.h"
+
+namespace gistool {
+namespace bench {
+namespace {
+
+/// Used when a golden file does not exist yet: shapes that exercise the
+/// decoder's edge cases and both DEM tile sizes.
+const char* const default_fixtures[] = {
+    "dem:225x150;seed=1",
+    "dem:225x150;nodata=0.3;seed=2",
+    "dem:225x150;start=17,40;seed=3",
+    "dem:1125x750;nodata=0.05;seed=4",
+    "dem:1x1;seed=5",
+    "dem:45x30;nodata=1;seed=6",
+    "dem:3x200;seed=7",
+};
+
+std::string format_double(double v) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%.17g", v);
+  return buf;
+}
+
+std::string to_line(const std::string& fixture, const Fingerprint& f) {
+  std::ostringstream ss;
+  ss << fixture << "\t";
+  if (!f.error.empty()) {
+    ss << "error\t" << f.error;
+    return ss.str();
+  }
+  char hash[17];
+  std::snprintf(hash, sizeof(hash), "%016llx",
+                static_cast<unsigned long long>(f.grid_hash));
+  ss << f.cols << "x" << f.rows << "\t" << hash << "\t";
+  for (std::size_t i = 0; i < f.transform.size(); ++i) {
+    ss << (i ? " " : "") << format_double(f.transform[i]);
+  }
+  ss << "\t" << f.nodata << "\t" << f.epsg;
+  return ss.str();
+}
+
+/// The fields after the fixture name; comparing them compares everything.
+std::string fields(const std::string& line) {
+  const auto tab = line.find('\t');
+  return tab == std::string::npos ? std::string() : line.substr(tab + 1);
+}
+
+bool load_fixture(const fs::path& dir, const std::string& fixture,
+                  IoBuffer& buffer, std::string& error) {
+  DemSpec spec;
+  if (fixture.compare(0, 4, "dem:") == 0) {
+    if (!parse_fixture(fixture, spec)) {
+      error = "bad fixture name";
+      return false;
+    }
+    const auto xml = generate_dem(spec);
+    buffer.resize(xml.size() + 1);
+    std::memcpy(buffer.data(), xml.data(), xml.size());
+    buffer[xml.size()] = '\0';
+    return true;
+  }
+  if (auto ec = read_source(dir / fs::u8path(fixture), buffer)) {
+    error = ec.message();
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool parse_fixture(const std::string& fixture, DemSpec& spec) {
+  if (fixture.compare(0, 4, "dem:") != 0) return false;
+  std::istringstream ss(fixture.substr(4));
+  std::string part;
+  bool first = true;
+  while (std::getline(ss, part, ';')) {
+    unsigned a = 0, b = 0;
+    double d = 0;
+    unsigned long long n = 0;
+    if (first) {
+      if (std::sscanf(part.c_str(), "%ux%u", &a, &b) != 2) return false;
+      spec.cols = a;
+      spec.rows = b;
+      first = false;
+    } else if (std::sscanf(part.c_str(), "nodata=%lf", &d) == 1) {
+      spec.nodata_ratio = d;
+    } else if (std::sscanf(part.c_str(), "start=%u,%u", &a, &b) == 2) {
+      spec.start_x = a;
+      spec.start_y = b;
+    } else if (std::sscanf(part.c_str(), "seed=%llu", &n) == 1) {
+      spec.seed = n;
+    } else {
+      return false;
+    }
+  }
+  return !first && spec.cols > 0 && spec.rows > 0 &&
+         spec.start_x < spec.cols && spec.start_y < spec.rows;
+}
+
+std::string fixture_name(const DemSpec& spec) {
+  std::ostringstream ss;
+  ss << "dem:" << spec.cols << "x" << spec.rows;
+  if (spec.nodata_ratio > 0) ss << ";nodata=" << spec.nodata_ratio;
+  if (spec.start_x || spec.start_y) {
+    ss << ";start=" << spec.start_x << "," << spec.start_y;
+  }
+  ss << ";seed=" << spec.seed;
+  return ss.str();
+}
+
+Fingerprint fingerprint(const std::string& name, IoBuffer&& buffer,
+                        OGRSpatialReference& spatialref) {
+  static std::atomic<std::uint64_t> counter{0};
+  Fingerprint f;
+
+  ByteBuffer encoded(nullptr, ::free);
+  size_t size = 0;
+  {
+    GmlDoc doc(fs::path("golden") / fs::u8path(name).filename());
+    doc.set_buffer(std::move(buffer));
+    doc.set_gdaldriver(thread_gtiff_driver());
+    doc.set_spatialref(spatialref);
+    auto r = doc.write_gtiff_memory(fs::temp_directory_path() / "tlgml_golden",
+                                    encoded, size);
+    if (!r.ok()) {
+      f.error = to_string(r.status);
+      return f;
+    }
+  }
+
+  const auto path = "/vsimem/tlgml_golden_" +
+                    std::to_string(counter.fetch_add(1)) + ".tiff";
+  VSIFCloseL(VSIFileFromMemBuffer(path.c_str(), encoded.get(), size, FALSE));
+  auto* ds = GDALDataset::FromHandle(GDALOpen(path.c_str(), GA_ReadOnly));
+  if (!ds) {
+    VSIUnlink(path.c_str());
+    f.error = "unreadable output";
+    return f;
+  }
+  f.cols = static_cast<std::uint32_t>(ds->GetRasterXSize());
+  f.rows = static_cast<std::uint32_t>(ds->GetRasterYSize());
+  std::vector<float> grid(static_cast<std::size_t>(f.cols) * f.rows);
+  auto* band = ds->GetRasterBand(1);
+  if (band->RasterIO(GF_Read, 0, 0, f.cols, f.rows, grid.data(), f.cols,
+                     f.rows, GDT_Float32, 0, 0) != CE_None) {
+    f.error = "unreadable raster";
+  } else {
+    f.grid_hash = hash_bytes(grid.data(), grid.size() * sizeof(float));
+    ds->GetGeoTransform(f.transform.data());
+    int has_nodata = 0;
+    const double nodata = band->GetNoDataValue(&has_nodata);
+    f.nodata = has_nodata ? format_double(nodata) : "none";
+    const auto* srs = ds->GetSpatialRef();
+    const char* code = srs ? srs->GetAuthorityCode(nullptr) : nullptr;
+    f.epsg = code ? code : "none";
+  }
+  GDALClose(GDALDataset::ToHandle(ds));
+  VSIUnlink(path.c_str());
+  return f;
+}
+
+int run_golden(const fs::path& golden, bool update, std::uint32_t threads) {
+  std::vector<std::string> header;
+  std::vector<std::string> expected;
+  {
+    std::ifstream ifs(golden, std::ios::binary);
+    if (!ifs && !update) {
+      std::cerr << "Cannot read " << golden.string() << std::endl;
+      return -1;
+    }
+    std::string line;
+    while (std::getline(ifs, line)) {
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+      if (line.empty()) continue;
+      if (line[0] == '#') {
+        header.push_back(line);
+      } else {
+        expected.push_back(line);
+      }
+    }
+  }
+  if (expected.empty() && update) {
+    for (const char* fixture : default_fixtures) expected.push_back(fixture);
+  }
+  if (header.empty()) {
+    header.push_back(
+        "# Golden outputs of tlgml. Verify: tlgml_bench --verify <this file>");
+    header.push_back(
+        "# Regenerate after an intended change: tlgml_bench --update-golden "
+        "<this file>");
+    header.push_back(
+        "# Values are only ever written by --update-golden (a GDAL round "
+        "trip);");
+    header.push_back(
+        "# a fixture listed without them fails --verify until recorded.");
+    header.push_back(
+        "# fixture\tsize\tgrid hash\tgeotransform\tnodata\tepsg");
+  }
+
+  OGRSpatialReference spatialref;
+  spatialref.importFromEPSG(6668);
+  const auto dir = golden.parent_path();
+  std::vector<std::future<std::string>> actual;
+  {
+    concurrent::ThreadPoolExecutor executor(threads);
+    for (const auto& line : expected) {
+      const auto fixture = line.substr(0, line.find('\t'));
+      actual.push_back(executor.submit([&dir, &spatialref, fixture]() {
+        IoBuffer buffer;
+        Fingerprint f;
+        if (load_fixture(dir, fixture, buffer, f.error)) {
+          f = fingerprint(fixture, std::move(buffer), spatialref);
+        }
+        return to_line(fixture, f);
+      }));
+    }
+  }
+
+  int mismatches = 0;
+  std::vector<std::string> lines;
+  for (std::size_t i = 0; i < expected.size(); ++i) {
+    lines.push_back(actual[i].get());
+    if (update) continue;
+    if (expected[i].find('\t') == std::string::npos) {
+      // Listed but never recorded: values only come from --update-golden.
+      ++mismatches;
+      std::cout << "MISSING " << expected[i]
+                << "\n    no recorded output, run --update-golden" << std::endl;
+    } else if (fields(lines[i]) == fields(expected[i])) {
+      std::cout << "ok      " << lines[i].substr(0, lines[i].find('\t'))
+                << std::endl;
+    } else {
+      ++mismatches;
+      std::cout << "FAILED  " << expected[i] << "\n    got " << lines[i]
+                << std::endl;
+    }
+  }
+  if (!update) return mismatches;
+
+  std::ofstream ofs(golden, std::ios::binary | std::ios::trunc);
+  for (const auto& line : header) ofs << line << "\n";
+  for (const auto& line : lines) ofs << line << "\n";
+  if (!ofs) {
+    std::cerr << "Cannot write " << golden.string() << std::endl;
+    return -1;
+  }
+  std::cout << "Wrote " << lines.size() << " fixtures to " << golden.string()
+            << std::endl;
+  return 0;
+}
+
+}  // namespace bench
+}  // namespace gistool
@@ -0,0 +1,67 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include <ogr_spatialref.h>
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "AsyncIO.h"
+#include "DemGenerator.h"
+
+namespace gistool {
+namespace bench {
+namespace fs = std::filesystem;
+
+/**
+ * @brief What a conversion produced, read back from the encoded GeoTIFF.
+ */
+struct Fingerprint {
+  std::uint32_t cols = 0;
+  std::uint32_t rows = 0;
+  /// hash_bytes of the Float32 grid.
+  std::uint64_t grid_hash = 0;
+  std::array<double, 6> transform{};
+  /// "none" when the band has no nodata value.
+  std::string nodata;
+  /// Authority code of the SRS, "none" without one.
+  std::string epsg;
+  /// Set instead of the above when the conversion failed.
+  std::string error;
+};
+
+/**
+ * @brief Convert a document into /vsimem as tlgml does and fingerprint the
+ * result.
+ */
+Fingerprint fingerprint(const std::string& name, IoBuffer&& buffer,
+                        OGRSpatialReference& spatialref);
+
+/**
+ * @brief Synthetic fixture names: "dem:225x150;nodata=0.1;start=3,2;seed=7".
+ * Options after the size are optional.
+ */
+bool parse_fixture(const std::string& fixture, DemSpec& spec);
+std::string fixture_name(const DemSpec& spec);
+
+/**
+ * @brief Convert every fixture listed in a golden file and compare the
+ * results, on threads workers so sanitizer builds see concurrent
+ * conversions. With update, write the current results instead.
+ *
+ * Fixtures that are not "dem:" names are GML files relative to the golden
+ * file, or members of archives next to it ("fixtures/x.zip!/y.xml"), so GSI
+ * downloads can be added as they are delivered.
+ *
+ * @return number of mismatches (0 after an update), or -1 when the golden
+ * file cannot be read or written.
+ */
+int run_golden(const fs::path& golden, bool update, std::uint32_t threads);
+
+}  // namespace bench
+}  // namespace gistool
+
+#endif  // !GOLDEN_H
@@ -0,0 +1,261 @@
+#include <gdal_priv.h>
+#include <ogr_spatialref.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "DemGenerator.h"
+#include "GdalWorker.h"
+#include "Golden.h"
+#include "GmlDoc.h"
+#include "cxxopts.hpp"
+
+using namespace gistool;
+using namespace gistool::bench;
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Timing {
+  std::vector<double> seconds;
+
+  double min() const {
+    return *std::min_element(seconds.begin(), seconds.end());
+  }
+  double median() const {
+    auto s = seconds;
+    std::sort(s.begin(), s.end());
+    return s[s.size() / 2];
+  }
+  double mean() const {
+    double sum = 0;
+    for (auto s : seconds) sum += s;
+    return sum / seconds.size();
+  }
+};
+
+template <typename F>
+double time_once(F&& f) {
+  const auto begin = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       begin)
+      .count();
+}
+
+IoBuffer to_buffer(const std::string& xml) {
+  IoBuffer buffer(xml.size() + 1);
+  std::memcpy(buffer.data(), xml.data(), xml.size());
+  buffer[xml.size()] = '\0';
+  return buffer;
+}
+
+/// One JSON object per line, keys in a fixed order, so results can be
+/// diffed and collected by scripts.
+void report(const std::string& scenario, const DemSpec& spec,
+            std::size_t bytes, const Timing& t) {
+  const double cells = static_cast<double>(spec.cols) * spec.rows;
+  const double median = t.median();
+  std::cout << "{\"scenario\":\"" << scenario << "\",\"cols\":" << spec.cols
+            << ",\"rows\":" << spec.rows
+            << ",\"nodata_ratio\":" << spec.nodata_ratio
+            << ",\"start_x\":" << spec.start_x
+            << ",\"start_y\":" << spec.start_y << ",\"bytes\":" << bytes
+            << ",\"iterations\":" << t.seconds.size()
+            << ",\"seconds_min\":" << t.min()
+            << ",\"seconds_median\":" << median
+            << ",\"seconds_mean\":" << t.mean()
+            << ",\"mb_per_s\":" << bytes / median / 1e6
+            << ",\"cells_per_s\":" << cells / median << "}" << std::endl;
+}
+
+Timing bench_parse(const std::string& xml, std::uint32_t iterations) {
+  Timing t;
+  for (std::uint32_t i = 0; i <= iterations; ++i) {
+    GmlDoc doc(fs::path("bench") / "dem.xml");
+    doc.set_buffer(to_buffer(xml));
+    const double s = time_once([&] {
+      if (!doc.try_parse()) throw std::runtime_error("generated XML rejected");
+    });
+    if (i > 0) t.seconds.push_back(s);  // The first run warms up.
+  }
+  return t;
+}
+
+Timing bench_decode(const std::string& xml, const DemSpec& spec,
+                    std::uint32_t iterations) {
+  GmlDoc doc(fs::path("bench") / "dem.xml");
+  doc.set_buffer(to_buffer(xml));
+  if (!doc.try_parse()) throw std::runtime_error("generated XML rejected");
+  auto node = doc.find_node_by_name("gml:tupleList");
+  if (!node) throw std::runtime_error("gml:tupleList not found");
+  std::vector<float> cells(static_cast<std::size_t>(spec.cols) * spec.rows);
+
+  std::string error;
+  Timing t;
+  for (std::uint32_t i = 0; i <= iterations; ++i) {
+    const double s = time_once([&] {
+      if (!decode_tuple_list(node->value(), spec.cols, spec.rows,
+                             spec.start_cell(), cells.data(), error)) {
+        throw std::runtime_error(error);
+      }
+    });
+    if (i > 0) t.seconds.push_back(s);
+  }
+  return t;
+}
+
+/// Parse, decode and GeoTIFF encoding into /vsimem, as the async I/O path
+/// does; the file system is left out so runs are comparable.
+Timing bench_full(const std::string& xml, std::uint32_t iterations) {
+  OGRSpatialReference spatialref;
+  spatialref.importFromEPSG(6668);
+  const auto target = fs::temp_directory_path() / "tlgml_bench";
+
+  Timing t;
+  for (std::uint32_t i = 0; i <= iterations; ++i) {
+    GmlDoc doc(fs::path("bench") / "dem.xml");
+    doc.set_buffer(to_buffer(xml));
+    doc.set_gdaldriver(thread_gtiff_driver());
+    doc.set_spatialref(spatialref);
+    ByteBuffer encoded(nullptr, ::free);
+    size_t size = 0;
+    ConvertResult r;
+    const double s =
+        time_once([&] { r = doc.write_gtiff_memory(target, encoded, size); });
+    if (!r.ok()) throw std::runtime_error("conversion failed: " + r.message);
+    if (i > 0) t.seconds.push_back(s);
+  }
+  return t;
+}
+
+/// Tiles side by side from the spec's corner, for end-to-end runs of tlgml.
+bool generate_files(const fs::path& dir, DemSpec spec, std::uint32_t count) {
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+  const auto columns = static_cast<std::uint32_t>(
+      std::ceil(std::sqrt(static_cast<double>(count))));
+  const auto lat = spec.lower_lat, lon = spec.lower_lon;
+  for (std::uint32_t i = 0; i < count; ++i) {
+    spec.lower_lat = lat + (i / columns) * spec.lat_span;
+    spec.lower_lon = lon + (i % columns) * spec.lon_span;
+    spec.seed += 1;
+    std::ofstream ofs(dir / dem_file_name(spec), std::ios::binary);
+    ofs << generate_dem(spec);
+    if (!ofs) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  cxxopts::Options options(
+      "tlgml_bench",
+      "Benchmark GmlDoc on synthetic JPGIS DEM files, or check outputs "
+      "against a golden file");
+  DemSpec spec;
+  std::uint32_t iterations = 20;
+  std::string scenario;
+  std::string generate;
+  std::uint32_t count = 1;
+  std::string verify;
+  std::string update_golden;
+  std::uint32_t threads = 0;
+  try {
+    options.add_options()("cols", "Cells per row",
+                          cxxopts::value<uint32_t>()->default_value("225"))(
+        "rows", "Rows", cxxopts::value<uint32_t>()->default_value("150"))(
+        "nodata", "Share of no data cells (0-1)",
+        cxxopts::value<double>()->default_value("0"))(
+        "start", "gml:startPoint as x,y",
+        cxxopts::value<std::string>()->default_value("0,0"))(
+        "seed", "Terrain seed",
+        cxxopts::value<uint64_t>()->default_value("1"))(
+        "i,iterations", "Timed runs per scenario",
+        cxxopts::value<uint32_t>()->default_value("20"))(
+        "scenario", "parse, decode, full or all",
+        cxxopts::value<std::string>()->default_value("all"))(
+        "generate", "Write files to this directory instead of benchmarking",
+        cxxopts::value<std::string>()->default_value(""))(
+        "count", "Number of files for --generate",
+        cxxopts::value<uint32_t>()->default_value("1"))(
+        "verify", "Convert the fixtures of a golden file and compare",
+        cxxopts::value<std::string>()->default_value(""))(
+        "update-golden", "Rewrite a golden file with the current outputs",
+        cxxopts::value<std::string>()->default_value(""))(
+        "j,threads", "Workers for --verify (0: all cores)",
+        cxxopts::value<uint32_t>()->default_value("0"));
+    auto result = options.parse(argc, argv);
+    spec.cols = result["cols"].as<uint32_t>();
+    spec.rows = result["rows"].as<uint32_t>();
+    spec.nodata_ratio = result["nodata"].as<double>();
+    spec.seed = result["seed"].as<uint64_t>();
+    auto start = result["start"].as<std::string>();
+    if (spec.cols == 0 || spec.rows == 0) {
+      throw cxxopts::OptionException("empty grid");
+    }
+    if (std::sscanf(start.c_str(), "%u,%u", &spec.start_x, &spec.start_y) !=
+            2 ||
+        spec.start_x >= spec.cols || spec.start_y >= spec.rows) {
+      throw cxxopts::OptionException("invalid start point");
+    }
+    iterations = std::max<uint32_t>(result["iterations"].as<uint32_t>(), 1);
+    scenario = result["scenario"].as<std::string>();
+    generate = result["generate"].as<std::string>();
+    count = result["count"].as<uint32_t>();
+    verify = result["verify"].as<std::string>();
+    update_golden = result["update-golden"].as<std::string>();
+    threads = result["threads"].as<uint32_t>();
+    if (scenario != "parse" && scenario != "decode" && scenario != "full" &&
+        scenario != "all") {
+      throw cxxopts::OptionException("unknown scenario " + scenario);
+    }
+  } catch (const cxxopts::OptionException& e) {
+    std::cerr << e.what() << std::endl << options.usage() << std::endl;
+    return 2;
+  }
+
+  if (!generate.empty()) {
+    if (!generate_files(generate, spec, count)) {
+      std::cerr << "Cannot write " << generate << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+  GDALAllRegister();
+  CPLPushErrorHandler(CPLQuietErrorHandler);
+  if (!verify.empty() || !update_golden.empty()) {
+    const bool update = !update_golden.empty();
+    const int failed = run_golden(update ? update_golden : verify, update,
+                                  threads);
+    GDALDestroyDriverManager();
+    return failed == 0 ? 0 : 1;
+  }
+  const auto xml = generate_dem(spec);
+  try {
+    if (scenario == "parse" || scenario == "all") {
+      report("parse", spec, xml.size(), bench_parse(xml, iterations));
+    }
+    if (scenario == "decode" || scenario == "all") {
+      report("decode", spec, xml.size(), bench_decode(xml, spec, iterations));
+    }
+    if (scenario == "full" || scenario == "all") {
+      report("full", spec, xml.size(), bench_full(xml, iterations));
+    }
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  GDALDestroyDriverManager();
+  return 0;
+}
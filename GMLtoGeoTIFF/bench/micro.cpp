@@ -0,0 +1,297 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <new>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <cppglob/fnmatch.hpp>
+#include <cppglob/matcher.hpp>
+
+#include "DemGenerator.h"
+#include "GmlDoc.h"
+#include "microbench.h"
+#include "numa_alloc.h"
+
+using namespace gistool;
+using namespace gistool::bench;
+namespace fs = std::filesystem;
+
+// Every allocation of the process is counted, so a helper that starts
+// allocating per call shows up as allocs_per_iter even when it is not slower
+// on this machine. Aligned and nothrow forms keep their defaults.
+namespace {
+std::atomic<std::uint64_t> allocation_count{0};
+}  // namespace
+
+void* operator new(std::size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+/**
+ * @brief Reports allocations per iteration of the enclosing benchmark.
+ * pause() and resume() leave out setup done with the timer paused.
+ */
+class AllocationCounter {
+ public:
+  explicit AllocationCounter(benchmark::State& state)
+      : state(state), start(allocation_count.load()) {}
+  ~AllocationCounter() {
+    pause();
+    state.counters["allocs_per_iter"] =
+        static_cast<double>(counted) / state.iterations();
+  }
+  void pause() {
+    if (running) counted += allocation_count.load() - start;
+    running = false;
+  }
+  void resume() {
+    start = allocation_count.load();
+    running = true;
+  }
+
+ private:
+  benchmark::State& state;
+  std::uint64_t start;
+  std::uint64_t counted = 0;
+  bool running = true;
+};
+
+/// The argument of every benchmark is the grid width; rows keep the 3:2
+/// shape of a DEM5A tile (45: tiny, 225: DEM5A, 1125: DEM10B sized).
+DemSpec spec_for(std::int64_t cols) {
+  DemSpec spec;
+  spec.cols = static_cast<std::uint32_t>(cols);
+  spec.rows = static_cast<std::uint32_t>(cols * 2 / 3);
+  spec.nodata_ratio = 0.05;
+  return spec;
+}
+
+const std::string& dem_xml(std::int64_t cols) {
+  static std::map<std::int64_t, std::string> cache;
+  auto& xml = cache[cols];
+  if (xml.empty()) xml = generate_dem(spec_for(cols));
+  return xml;
+}
+
+/// Parsed once per size and shared by the read-only benchmarks.
+GmlDoc& parsed_dem(std::int64_t cols) {
+  static std::map<std::int64_t, std::unique_ptr<GmlDoc>> cache;
+  auto& doc = cache[cols];
+  if (!doc) {
+    const auto& xml = dem_xml(cols);
+    IoBuffer buffer(xml.size() + 1);
+    std::memcpy(buffer.data(), xml.data(), xml.size());
+    buffer[xml.size()] = '\0';
+    doc = std::make_unique<GmlDoc>(fs::path("bench") / "dem.xml");
+    doc->set_buffer(std::move(buffer));
+    if (!doc->try_parse()) std::abort();
+  }
+  return *doc;
+}
+
+void BM_parse(benchmark::State& state) {
+  const auto& xml = dem_xml(state.range(0));
+  std::vector<char> buffer(xml.size() + 1);
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    // rapidxml parses in place, so every iteration needs a fresh copy.
+    state.PauseTiming();
+    allocs.pause();
+    std::memcpy(buffer.data(), xml.data(), xml.size());
+    buffer[xml.size()] = '\0';
+    rx::xml_document<> document;
+    allocs.resume();
+    state.ResumeTiming();
+    document.parse<0>(buffer.data());
+    benchmark::DoNotOptimize(document.first_node());
+  }
+  state.SetBytesProcessed(static_cast<std::int64_t>(xml.size()) *
+                          state.iterations());
+}
+BENCHMARK(BM_parse)->Arg(45)->Arg(225)->Arg(1125);
+
+// gml:tupleList sits deep in the document and gml:startPoint after it, so
+// these are the searches that visit the most nodes.
+void BM_find_node_tupleList(benchmark::State& state) {
+  auto& doc = parsed_dem(state.range(0));
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(doc.find_node_by_name("gml:tupleList"));
+  }
+}
+BENCHMARK(BM_find_node_tupleList)->Arg(45)->Arg(225)->Arg(1125);
+
+void BM_find_node_startPoint(benchmark::State& state) {
+  auto& doc = parsed_dem(state.range(0));
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(doc.find_node_by_name("gml:startPoint"));
+  }
+}
+BENCHMARK(BM_find_node_startPoint)->Arg(45)->Arg(225)->Arg(1125);
+
+void BM_size_lat_lon(benchmark::State& state) {
+  auto& doc = parsed_dem(state.range(0));
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(doc.size_lat_lon());
+  }
+}
+BENCHMARK(BM_size_lat_lon)->Arg(45)->Arg(225)->Arg(1125);
+
+void BM_size_cells(benchmark::State& state) {
+  auto& doc = parsed_dem(state.range(0));
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(doc.size_cells());
+  }
+}
+BENCHMARK(BM_size_cells)->Arg(45)->Arg(225)->Arg(1125);
+
+void BM_decode_tuple_list(benchmark::State& state) {
+  auto& doc = parsed_dem(state.range(0));
+  const auto spec = spec_for(state.range(0));
+  auto node = doc.find_node_by_name("gml:tupleList");
+  if (!node) std::abort();
+  std::vector<float> cells(static_cast<std::size_t>(spec.cols) * spec.rows);
+  std::string error;
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    if (!decode_tuple_list(node->value(), spec.cols, spec.rows,
+                           spec.start_cell(), cells.data(), error)) {
+      std::abort();
+    }
+    benchmark::DoNotOptimize(cells.data());
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(cells.size()) *
+                          state.iterations());
+}
+BENCHMARK(BM_decode_tuple_list)->Arg(45)->Arg(225)->Arg(1125);
+
+/// GSI download names over four first level meshes and three products, as
+/// --include sees them: the pattern below keeps one name in twelve.
+const std::vector<fs::path>& gsi_names() {
+  static const std::vector<fs::path> names = [] {
+    std::vector<fs::path> ret;
+    const char* const meshes[] = {"5339", "5340", "5439", "5438"};
+    const char* const products[] = {"DEM5A", "DEM5B", "DEM10B"};
+    char name[64];
+    for (const char* mesh : meshes) {
+      for (int qv = 0; qv < 64; ++qv) {
+        for (int rw = 0; rw < 100; rw += 7) {
+          for (const char* product : products) {
+            std::snprintf(name, sizeof(name),
+                          "FG-GML-%s-%d%d-%02d-%s-20161001.xml", mesh, qv / 8,
+                          qv % 8, rw, product);
+            ret.emplace_back(name);
+          }
+        }
+      }
+    }
+    return ret;
+  }();
+  return names;
+}
+
+const fs::path gsi_pattern("FG-GML-5339*-DEM5A*.xml");
+
+// cppglob::matcher (bit-parallel) against the std::regex of translate(),
+// which is what matching cost before the matcher and still is for patterns
+// the matcher hands to the regex fallback.
+void BM_glob_matcher(benchmark::State& state) {
+  const auto& names = gsi_names();
+  const cppglob::matcher match(gsi_pattern.native());
+  std::size_t matched = 0;
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    for (const auto& name : names) matched += match(name.native());
+  }
+  benchmark::DoNotOptimize(matched);
+  state.SetItemsProcessed(static_cast<std::int64_t>(names.size()) *
+                          state.iterations());
+}
+BENCHMARK(BM_glob_matcher);
+
+void BM_glob_regex(benchmark::State& state) {
+  const auto& names = gsi_names();
+  const std::basic_regex<cppglob::char_type> regex(
+      cppglob::translate(gsi_pattern.native()));
+  std::size_t matched = 0;
+  AllocationCounter allocs(state);
+  for (auto _ : state) {
+    for (const auto& name : names) {
+      matched += std::regex_match(name.native(), regex);
+    }
+  }
+  benchmark::DoNotOptimize(matched);
+  state.SetItemsProcessed(static_cast<std::int64_t>(names.size()) *
+                          state.iterations());
+}
+BENCHMARK(BM_glob_regex);
+
+#ifdef TLGML_HAVE_LIBNUMA
+// Node-local (NumaAllocator, as the decode buffers of --pin workers) against
+// interleaved pages, read by a worker pinned to the first allowed CPU. The
+// argument is the buffer size in MB, well beyond the last level cache, so
+// every pass streams from memory. On a single node machine both place the
+// pages alike and should match; the gap on a multi-node one is what local
+// buffers save.
+enum class Placement { Local, Interleaved };
+
+void numa_stream(benchmark::State& state, Placement placement) {
+  if (numa_available() < 0) std::abort();
+  concurrent::pin_current_thread(0);
+  const auto bytes = static_cast<std::size_t>(state.range(0)) << 20;
+  concurrent::NumaAllocator<float> local;
+  float* cells = placement == Placement::Local
+                     ? local.allocate(bytes / sizeof(float))
+                     : static_cast<float*>(numa_alloc_interleaved(bytes));
+  if (!cells) std::abort();
+  const std::size_t count = bytes / sizeof(float);
+  for (std::size_t i = 0; i < count; ++i) cells[i] = static_cast<float>(i);
+  double sum = 0.0;
+  for (auto _ : state) {
+    // Independent sums, so the pass waits on memory rather than on adds.
+    float partial[8] = {};
+    for (std::size_t i = 0; i + 8 <= count; i += 8) {
+      for (int k = 0; k < 8; ++k) partial[k] += cells[i + k];
+    }
+    for (float p : partial) sum += p;
+  }
+  benchmark::DoNotOptimize(sum);
+  state.SetBytesProcessed(static_cast<std::int64_t>(bytes) *
+                          state.iterations());
+  state.counters["nodes"] = numa_num_configured_nodes();
+  if (placement == Placement::Local) {
+    local.deallocate(cells, count);
+  } else {
+    numa_free(cells, bytes);
+  }
+}
+
+void BM_numa_local(benchmark::State& state) {
+  numa_stream(state, Placement::Local);
+}
+BENCHMARK(BM_numa_local)->Arg(256);
+
+void BM_numa_interleaved(benchmark::State& state) {
+  numa_stream(state, Placement::Interleaved);
+}
+BENCHMARK(BM_numa_interleaved)->Arg(256);
+#endif
+
+}  // namespace
+
+BENCHMARK_MAIN();
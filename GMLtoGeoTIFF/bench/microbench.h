@@ -0,0 +1,197 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+/**
+ * @file microbench.h
+ * @brief Google Benchmark when it is available (TLGML_HAVE_GBENCH), else a
+ * small runner with the subset of its API the benchmarks use: State with
+ * range(), PauseTiming/ResumeTiming, counters and Set*Processed,
+ * BENCHMARK(fn)->Arg(n), DoNotOptimize and BENCHMARK_MAIN.
+ */
+
+#ifdef TLGML_HAVE_GBENCH
+#include <benchmark/benchmark.h>
+#else
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+
+template <typename T>
+inline void DoNotOptimize(T const& value) {
+#if defined(__GNUC__) || defined(__clang__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile const void* sink;
+  sink = &value;
+#endif
+}
+
+class State {
+  using Clock = std::chrono::steady_clock;
+
+ public:
+  State(std::int64_t arg, std::int64_t iterations)
+      : arg_(arg), iterations_(iterations) {}
+
+  std::int64_t range(std::size_t = 0) const { return arg_; }
+  std::int64_t iterations() const { return iterations_; }
+
+  void PauseTiming() { elapsed_ += Clock::now() - start_; }
+  void ResumeTiming() { start_ = Clock::now(); }
+
+  void SetBytesProcessed(std::int64_t bytes) { bytes_ = bytes; }
+  void SetItemsProcessed(std::int64_t items) { items_ = items; }
+  void SetLabel(const std::string& label) { label_ = label; }
+
+  std::map<std::string, double> counters;
+
+  struct Iterator {
+    State* state;
+    std::int64_t remaining;
+    bool operator!=(const Iterator&) {
+      if (remaining > 0) return true;
+      state->PauseTiming();
+      return false;
+    }
+    void operator++() { --remaining; }
+    int operator*() const { return 0; }
+  };
+  Iterator begin() {
+    ResumeTiming();
+    return Iterator{this, iterations_};
+  }
+  Iterator end() { return Iterator{this, 0}; }
+
+  double seconds() const {
+    return std::chrono::duration<double>(elapsed_).count();
+  }
+  std::int64_t bytes() const { return bytes_; }
+  std::int64_t items() const { return items_; }
+  const std::string& label() const { return label_; }
+
+ private:
+  std::int64_t arg_;
+  std::int64_t iterations_;
+  Clock::time_point start_;
+  Clock::duration elapsed_{};
+  std::int64_t bytes_ = 0;
+  std::int64_t items_ = 0;
+  std::string label_;
+};
+
+class Benchmark {
+ public:
+  using Function = void (*)(State&);
+  Benchmark(const char* name, Function fn) : name_(name), fn_(fn) {}
+
+  Benchmark* Arg(std::int64_t arg) {
+    args_.push_back(arg);
+    return this;
+  }
+
+  /// Grows the iteration count until a run takes min_seconds, then prints
+  /// one line per argument.
+  void run(double min_seconds) const {
+    auto args = args_;
+    if (args.empty()) args.push_back(0);
+    for (auto arg : args) {
+      std::int64_t n = 1;
+      for (;;) {
+        State state(arg, n);
+        fn_(state);
+        const double s = state.seconds();
+        if (s >= min_seconds || n >= (std::int64_t(1) << 40)) {
+          print(arg, state);
+          break;
+        }
+        const double grow = s > 0 ? min_seconds * 1.4 / s : 10.0;
+        n = static_cast<std::int64_t>(n * (grow < 10.0 ? grow : 10.0)) + 1;
+      }
+    }
+  }
+
+  const std::string& name() const { return name_; }
+
+ private:
+  void print(std::int64_t arg, const State& state) const {
+    std::string name = name_;
+    if (!args_.empty()) name += "/" + std::to_string(arg);
+    const double s = state.seconds();
+    std::printf("%-36s %14.1f ns %12lld", name.c_str(),
+                s * 1e9 / state.iterations(),
+                static_cast<long long>(state.iterations()));
+    if (state.bytes() > 0) {
+      std::printf(" bytes_per_second=%.4gM/s", state.bytes() / s / 1e6);
+    }
+    if (state.items() > 0) {
+      std::printf(" items_per_second=%.4gM/s", state.items() / s / 1e6);
+    }
+    for (const auto& [key, value] : state.counters) {
+      std::printf(" %s=%.4g", key.c_str(), value);
+    }
+    if (!state.label().empty()) std::printf(" %s", state.label().c_str());
+    std::printf("\n");
+  }
+
+  std::string name_;
+  Function fn_;
+  std::vector<std::int64_t> args_;
+};
+
+inline std::vector<Benchmark*>& registry() {
+  static std::vector<Benchmark*> benchmarks;
+  return benchmarks;
+}
+
+inline Benchmark* RegisterBenchmark(const char* name, Benchmark::Function fn) {
+  registry().push_back(new Benchmark(name, fn));
+  return registry().back();
+}
+
+/// Accepts --benchmark_filter=<substring> and --benchmark_min_time=<seconds>.
+inline int RunSpecifiedBenchmarks(int argc, char** argv) {
+  std::string filter;
+  double min_seconds = 0.5;
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (std::strncmp(arg, "--benchmark_filter=", 19) == 0) {
+      filter = arg + 19;
+    } else if (std::strncmp(arg, "--benchmark_min_time=", 21) == 0) {
+      min_seconds = std::atof(arg + 21);
+    } else {
+      std::fprintf(stderr, "unknown argument %s\n", arg);
+      return 2;
+    }
+  }
+  std::printf("%-36s %17s %12s\n", "Benchmark", "Time", "Iterations");
+  for (const auto* b : registry()) {
+    if (filter.empty() || b->name().find(filter) != std::string::npos) {
+      b->run(min_seconds);
+    }
+  }
+  return 0;
+}
+
+}  // namespace benchmark
+
+#define TLGML_BENCHMARK_CONCAT2(a, b) a##b
+#define TLGML_BENCHMARK_CONCAT(a, b) TLGML_BENCHMARK_CONCAT2(a, b)
+#define BENCHMARK(fn)                                                    \
+  static ::benchmark::Benchmark* TLGML_BENCHMARK_CONCAT(benchmark_, __LINE__) = \
+      ::benchmark::RegisterBenchmark(#fn, fn)
+#define BENCHMARK_MAIN()                                    \
+  int main(int argc, char** argv) {                         \
+    return ::benchmark::RunSpecifiedBenchmarks(argc, argv); \
+  }
+
+#endif  // TLGML_HAVE_GBENCH
+
+#endif  // !MICROBENCH_H
@@ -0,0 +1,411 @@
+#include "tlgml.h"
+
+#include <gdal_priv.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ConvertResult.h"
+#include "ConverterManager.h"
+#include "GdalWorker.h"
+#include "GmlDoc.h"
+#include "ZipArchive.h"
+
+using namespace gistool;
+
+struct tlgml_context {
+  ConverterOptions options;
+  std::uint32_t max_attempts = 1;
+  OGRSpatialReference spatialref;
+  ResultCollector results;
+  std::unique_ptr<ConverterManager> manager;
+
+  /// One batch at a time; the observer reads the batch's callback.
+  std::mutex batch_mutex;
+  tlgml_result_callback callback = nullptr;
+  void* user_data = nullptr;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+tlgml_status fail(tlgml_status status, std::string message) {
+  last_error = std::move(message);
+  return status;
+}
+
+tlgml_status to_status(ConvertStatus status) {
+  switch (status) {
+    case ConvertStatus::Ok:
+      return TLGML_OK;
+    case ConvertStatus::OpenFailed:
+      return TLGML_OPEN_FAILED;
+    case ConvertStatus::ParseFailed:
+      return TLGML_PARSE_FAILED;
+    case ConvertStatus::InvalidHeader:
+      return TLGML_INVALID_HEADER;
+    case ConvertStatus::TooLarge:
+      return TLGML_TOO_LARGE;
+    case ConvertStatus::WriteFailed:
+      break;
+  }
+  return TLGML_WRITE_FAILED;
+}
+
+/// Whether the collector will not hand the result back for another attempt
+/// (the complement of take_retryable).
+bool is_final(const ConvertResult& r, std::uint32_t max_attempts) {
+  return r.ok() || !r.transient() || r.attempts >= max_attempts;
+}
+
+void register_gdal() {
+  static std::once_flag once;
+  std::call_once(once, [] { GDALAllRegister(); });
+}
+
+/// A parsed document and its header; the tupleList is decoded on demand.
+class Source {
+ public:
+  Source() : doc(fs::path("buffer.xml")) {}
+  explicit Source(const char* path) : doc(fs::u8path(path)) {}
+
+  tlgml_status open_buffer(const char* data, std::size_t size) {
+    // rapidxml parses in place and needs the terminating NUL.
+    IoBuffer buffer(size + 1);
+    if (size) std::memcpy(buffer.data(), data, size);
+    buffer[size] = '\0';
+    doc.set_buffer(std::move(buffer));
+    return parse();
+  }
+
+  tlgml_status open_file() {
+    if (!doc.load()) {
+      return fail(TLGML_OPEN_FAILED,
+                  "cannot open " + doc.source_path().u8string());
+    }
+    return parse();
+  }
+
+  void header(tlgml_header* out) const {
+    out->lower_lat = grid_header.lat_lon[0];
+    out->lower_lon = grid_header.lat_lon[1];
+    out->upper_lat = grid_header.lat_lon[2];
+    out->upper_lon = grid_header.lat_lon[3];
+    out->cols = grid_header.cols;
+    out->rows = grid_header.rows;
+    grid_header.transform(out->geotransform);
+  }
+
+  std::size_t cells() const {
+    return static_cast<std::size_t>(grid_header.cols) * grid_header.rows;
+  }
+
+  tlgml_status decode(float* dst) {
+    auto node = doc.find_node_by_name("gml:tupleList");
+    if (!node) return fail(TLGML_INVALID_HEADER, "gml:tupleList not found");
+    std::string error;
+    if (!decode_tuple_list(node->value(), grid_header.cols, grid_header.rows,
+                           grid_header.start, dst, error)) {
+      return fail(TLGML_INVALID_HEADER, "bad tuple: " + error);
+    }
+    return TLGML_OK;
+  }
+
+ private:
+  tlgml_status parse() {
+    if (!doc.try_parse()) return fail(TLGML_PARSE_FAILED, "xml parse error");
+    std::string error;
+    if (!doc.read_header(grid_header, error)) {
+      return fail(TLGML_INVALID_HEADER, error);
+    }
+    return TLGML_OK;
+  }
+
+  GmlDoc doc;
+  GridHeader grid_header;
+};
+
+tlgml_status read_grid(Source& source, tlgml_grid* grid) {
+  source.header(&grid->header);
+  auto cells =
+      static_cast<float*>(std::malloc(source.cells() * sizeof(float)));
+  if (!cells) return fail(TLGML_TOO_LARGE, "out of memory");
+  const auto status = source.decode(cells);
+  if (status != TLGML_OK) {
+    std::free(cells);
+    return status;
+  }
+  grid->cells = cells;
+  return TLGML_OK;
+}
+
+tlgml_status open_dataset(tlgml_context* context, Source& source,
+                          GDALDatasetH* out) {
+  tlgml_header header;
+  source.header(&header);
+  std::vector<float> cells(source.cells());
+  const auto status = source.decode(cells.data());
+  if (status != TLGML_OK) return status;
+
+  auto driver = GetGDALDriverManager()->GetDriverByName("MEM");
+  if (!driver) return fail(TLGML_WRITE_FAILED, "GDAL MEM driver not found");
+  GDALDataset* dataset = driver->Create("", header.cols, header.rows, 1,
+                                        GDT_Float32, nullptr);
+  if (!dataset) return fail(TLGML_WRITE_FAILED, CPLGetLastErrorMsg());
+  auto band = dataset->GetRasterBand(1);
+  if (band->RasterIO(GF_Write, 0, 0, header.cols, header.rows, cells.data(),
+                     header.cols, header.rows, GDT_Float32, 0, 0) != CE_None) {
+    GDALClose(dataset);
+    return fail(TLGML_WRITE_FAILED, CPLGetLastErrorMsg());
+  }
+  band->SetNoDataValue(TLGML_NODATA);
+  dataset->SetGeoTransform(header.geotransform);
+  dataset->SetSpatialRef(&context->spatialref);
+  *out = GDALDataset::ToHandle(dataset);
+  return TLGML_OK;
+}
+
+/// Run f, turning escaping exceptions (bad_alloc, filesystem errors) into a
+/// status; nothing may unwind through the C boundary.
+template <class F>
+tlgml_status guarded(F&& f) {
+  last_error.clear();
+  try {
+    return f();
+  } catch (const std::bad_alloc&) {
+    return fail(TLGML_TOO_LARGE, "out of memory");
+  } catch (const std::length_error& e) {
+    return fail(TLGML_TOO_LARGE, e.what());
+  } catch (const std::exception& e) {
+    return fail(TLGML_WRITE_FAILED, e.what());
+  }
+}
+
+}  // namespace
+
+extern "C" {
+
+int tlgml_api_version(void) { return TLGML_API_VERSION; }
+
+const char* tlgml_status_string(tlgml_status status) {
+  if (status == TLGML_INVALID_ARGUMENT) return "invalid_argument";
+  if (status == TLGML_TOO_LARGE) return to_string(ConvertStatus::TooLarge);
+  if (status < TLGML_OK || status > TLGML_WRITE_FAILED) return "unknown";
+  static const ConvertStatus statuses[] = {
+      ConvertStatus::Ok, ConvertStatus::OpenFailed, ConvertStatus::ParseFailed,
+      ConvertStatus::InvalidHeader, ConvertStatus::WriteFailed};
+  return to_string(statuses[status]);
+}
+
+const char* tlgml_last_error(void) { return last_error.c_str(); }
+
+tlgml_status tlgml_probe_buffer(const char* data, size_t size,
+                                tlgml_header* header) {
+  if ((!data && size) || !header) {
+    return fail(TLGML_INVALID_ARGUMENT, "null argument");
+  }
+  return guarded([&] {
+    Source source;
+    const auto status = source.open_buffer(data, size);
+    if (status == TLGML_OK) source.header(header);
+    return status;
+  });
+}
+
+tlgml_status tlgml_probe_file(const char* path, tlgml_header* header) {
+  if (!path || !header) return fail(TLGML_INVALID_ARGUMENT, "null argument");
+  return guarded([&] {
+    Source source(path);
+    const auto status = source.open_file();
+    if (status == TLGML_OK) source.header(header);
+    return status;
+  });
+}
+
+tlgml_status tlgml_read_grid_buffer(const char* data, size_t size,
+                                    tlgml_grid* grid) {
+  if ((!data && size) || !grid) {
+    return fail(TLGML_INVALID_ARGUMENT, "null argument");
+  }
+  grid->cells = nullptr;
+  return guarded([&] {
+    Source source;
+    const auto status = source.open_buffer(data, size);
+    return status == TLGML_OK ? read_grid(source, grid) : status;
+  });
+}
+
+tlgml_status tlgml_read_grid_file(const char* path, tlgml_grid* grid) {
+  if (!path || !grid) return fail(TLGML_INVALID_ARGUMENT, "null argument");
+  grid->cells = nullptr;
+  return guarded([&] {
+    Source source(path);
+    const auto status = source.open_file();
+    return status == TLGML_OK ? read_grid(source, grid) : status;
+  });
+}
+
+void tlgml_grid_free(tlgml_grid* grid) {
+  if (!grid) return;
+  std::free(grid->cells);
+  grid->cells = nullptr;
+}
+
+void tlgml_options_init(tlgml_options* options) {
+  if (!options) return;
+  std::memset(options, 0, sizeof(*options));
+  options->struct_size = sizeof(*options);
+  options->output_directory = "out";
+  options->epsg = 6668;
+  options->max_attempts = 3;
+}
+
+tlgml_context* tlgml_context_create(const tlgml_options* options) {
+  tlgml_options defaults;
+  tlgml_options_init(&defaults);
+  // Callers built against an older, shorter struct keep the newer defaults.
+  if (options) {
+    std::memcpy(&defaults, options,
+                std::min(options->struct_size, sizeof(defaults)));
+    defaults.struct_size = sizeof(defaults);
+  }
+  tlgml_context* context = nullptr;
+  const auto status = guarded([&] {
+    register_gdal();
+    auto ctx = std::make_unique<tlgml_context>();
+    auto& opts = ctx->options;
+    if (defaults.output_directory) {
+      opts.target_directory = fs::u8path(defaults.output_directory);
+    }
+    opts.epsg = defaults.epsg;
+    opts.thread_count = defaults.threads;
+    opts.max_inflight = defaults.max_inflight;
+    opts.max_inflight_bytes = defaults.max_inflight_bytes;
+    ctx->max_attempts = defaults.max_attempts ? defaults.max_attempts : 1;
+    if (ctx->spatialref.importFromEPSG(opts.epsg) != OGRERR_NONE) {
+      return fail(TLGML_INVALID_ARGUMENT,
+                  "unknown EPSG code " + std::to_string(opts.epsg));
+    }
+
+    GdalTuning tuning;
+    tuning.cache_mb = defaults.gdal_cache_mb;
+    apply_gdal_tuning(tuning);
+
+    auto raw = ctx.get();
+    ctx->results.set_observer([raw](const ConvertResult& r) {
+      if (!raw->callback || !is_final(r, raw->max_attempts)) return;
+      const auto source = r.source.u8string();
+      const auto output = r.output.u8string();
+      tlgml_result result;
+      result.source = source.c_str();
+      result.output = output.c_str();
+      result.status = to_status(r.status);
+      result.message = r.message.c_str();
+      result.bytes_read = r.bytes_read;
+      result.bytes_written = r.bytes_written;
+      result.seconds = r.seconds;
+      result.attempts = r.attempts;
+      result.skipped = r.skipped ? 1 : 0;
+      raw->callback(&result, raw->user_data);
+    });
+    ctx->manager = std::make_unique<ConverterManager>(opts, ctx->results);
+    context = ctx.release();
+    return TLGML_OK;
+  });
+  return status == TLGML_OK ? context : nullptr;
+}
+
+void tlgml_context_destroy(tlgml_context* context) {
+  if (!context) return;
+  {
+    std::lock_guard<std::mutex> lock(context->batch_mutex);
+    context->manager.reset();
+  }
+  delete context;
+}
+
+tlgml_status tlgml_open_dataset_buffer(tlgml_context* context,
+                                       const char* data, size_t size,
+                                       GDALDatasetH* dataset) {
+  if (!context || (!data && size) || !dataset) {
+    return fail(TLGML_INVALID_ARGUMENT, "null argument");
+  }
+  *dataset = nullptr;
+  return guarded([&] {
+    Source source;
+    const auto status = source.open_buffer(data, size);
+    return status == TLGML_OK ? open_dataset(context, source, dataset)
+                              : status;
+  });
+}
+
+tlgml_status tlgml_open_dataset_file(tlgml_context* context, const char* path,
+                                     GDALDatasetH* dataset) {
+  if (!context || !path || !dataset) {
+    return fail(TLGML_INVALID_ARGUMENT, "null argument");
+  }
+  *dataset = nullptr;
+  return guarded([&] {
+    Source source(path);
+    const auto status = source.open_file();
+    return status == TLGML_OK ? open_dataset(context, source, dataset)
+                              : status;
+  });
+}
+
+tlgml_status tlgml_convert_files(tlgml_context* context,
+                                 const char* const* paths, size_t count,
+                                 tlgml_result_callback callback,
+                                 void* user_data, size_t* failed) {
+  if (!context || (!paths && count)) {
+    return fail(TLGML_INVALID_ARGUMENT, "null argument");
+  }
+  std::lock_guard<std::mutex> lock(context->batch_mutex);
+  context->callback = callback;
+  context->user_data = user_data;
+  const auto status = guarded([&] {
+    auto& manager = *context->manager;
+    for (size_t i = 0; i < count; i++) {
+      if (!paths[i]) continue;
+      SourceFile source{fs::u8path(paths[i])};
+      std::error_code ec;
+      if (!is_archive_member(source.path)) {
+        const auto size = fs::file_size(source.path, ec);
+        if (!ec) source.size = size;
+      }
+      manager.add_queue(std::move(source));
+    }
+    manager.wait();
+    for (auto retry = context->results.take_retryable(context->max_attempts);
+         !retry.empty();
+         retry = context->results.take_retryable(context->max_attempts)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+      for (const auto& r : retry) {
+        manager.add_queue(SourceFile{r.source, r.source_size, r.source_mtime},
+                          r.attempts + 1);
+      }
+      manager.wait();
+    }
+    return TLGML_OK;
+  });
+  // After an exception, files already queued still report into results.
+  context->manager->wait();
+  if (failed) *failed = context->results.failed();
+  context->results.clear();
+  context->callback = nullptr;
+  context->user_data = nullptr;
+  return status;
+}
+
+}  // extern "C"
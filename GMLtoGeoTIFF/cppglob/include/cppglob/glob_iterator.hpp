@@ -30,36 +30,37 @@
 
 #include <cstddef>
 #include <iterator>
-#include <vector>
+#include <memory>
 #include <filesystem>
 #include "config.hpp"
 
 namespace cppglob {
-  class CPPGLOB_LOCAL glob_iterator {
-    using base = std::vector<fs::path>::iterator;
-
+  namespace detail {
+    struct glob_state;
+  }  // namespace detail
+
+  /**
+   * @brief Single pass iterator over the paths matching a pattern.
+   *
+   * Matches are produced one at a time while walking the tree: the iterator
+   * keeps a stack with one open directory per pattern level (or per level
+   * below a '**'), so memory is proportional to the depth and the first match
+   * is available before the rest of the tree has been read. Copies share the
+   * walk, like fs::directory_iterator.
+   */
+  class CPPGLOB_EXPORT glob_iterator {
    public:
-    using difference_type = typename base::difference_type;
-    using value_type = typename base::value_type;
-    using pointer = typename base::pointer;
-    using const_pointer = const typename fs::path*;
-    using reference = typename fs::path&;
-    using const_reference = const typename fs::path&;
-    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = fs::path;
+    using pointer = fs::path*;
+    using const_pointer = const fs::path*;
+    using reference = fs::path&;
+    using const_reference = const fs::path&;
+    using iterator_category = std::input_iterator_tag;
 
     glob_iterator() noexcept;
 
-    explicit glob_iterator(const std::vector<fs::path>& pathnames);
-
-    explicit glob_iterator(std::vector<fs::path>&& pathnames) noexcept;
-
-    glob_iterator(const glob_iterator& other);
-
-    glob_iterator(glob_iterator&& other) noexcept;
-
-    glob_iterator& operator=(const glob_iterator& other);
-
-    glob_iterator& operator=(glob_iterator&& other);
+    glob_iterator(const fs::path& pathname, bool recursive);
 
     reference operator*();
     const_reference operator*() const;
@@ -73,6 +74,11 @@ namespace cppglob {
 
     glob_iterator& operator++();
 
+    /**
+     * @brief Advance, returning an iterator that still refers to the
+     * previous match (and is at its end after one more increment), since
+     * copies otherwise share the walk.
+     */
     glob_iterator operator++(int);
 
     glob_iterator& swap(glob_iterator& other);
@@ -81,89 +87,8 @@ namespace cppglob {
     bool finished() const;
 
    private:
-    std::vector<fs::path> M_pathnames;
-    std::size_t M_index = 0L;
+    std::shared_ptr<detail::glob_state> M_state;
   };
-
-#if (!defined CPPGLOB_COVERAGE || defined CPPGLOB_BUILDING)
-
-  CPPGLOB_INLINE glob_iterator::glob_iterator() noexcept = default;
-
-  CPPGLOB_INLINE glob_iterator::glob_iterator(
-      const std::vector<fs::path>& pathnames)
-      : M_pathnames(pathnames) {}
-
-  CPPGLOB_INLINE glob_iterator::glob_iterator(
-      std::vector<fs::path>&& pathnames) noexcept
-      : M_pathnames(std::move(pathnames)) {}
-
-  CPPGLOB_INLINE glob_iterator::glob_iterator(const glob_iterator&) = default;
-
-  CPPGLOB_INLINE glob_iterator::glob_iterator(glob_iterator&& other) noexcept
-      : M_pathnames(std::move(other.M_pathnames)) {
-    M_index = other.M_index;
-  }
-
-  CPPGLOB_INLINE glob_iterator& glob_iterator::operator=(
-      const glob_iterator& other) = default;
-
-  CPPGLOB_INLINE glob_iterator& glob_iterator::operator=(
-      glob_iterator&& other) {
-    M_pathnames = std::move(other.M_pathnames);
-    M_index = other.M_index;
-    return *this;
-  }
-
-  CPPGLOB_INLINE glob_iterator::reference glob_iterator::operator*() {
-    return M_pathnames[M_index];
-  }
-  CPPGLOB_INLINE glob_iterator::const_reference glob_iterator::operator*()
-      const {
-    return M_pathnames[M_index];
-  }
-
-  CPPGLOB_INLINE glob_iterator::pointer glob_iterator::operator->() {
-    return &M_pathnames[M_index];
-  }
-  CPPGLOB_INLINE glob_iterator::const_pointer glob_iterator::operator->()
-      const {
-    return &M_pathnames[M_index];
-  }
-
-  CPPGLOB_INLINE bool glob_iterator::operator==(
-      const glob_iterator& other) const {
-    return (finished() && other.finished()) ||
-           (!finished() && !other.finished() && M_index == other.M_index);
-  }
-
-  CPPGLOB_INLINE bool glob_iterator::operator!=(
-      const glob_iterator& other) const {
-    return !(*this == other);
-  }
-
-  CPPGLOB_INLINE glob_iterator& glob_iterator::operator++() {
-    ++M_index;
-    return *this;
-  }
-
-  CPPGLOB_INLINE glob_iterator glob_iterator::operator++(int) {
-    glob_iterator old(*this);
-    ++M_index;
-    return old;
-  }
-
-  CPPGLOB_INLINE glob_iterator& glob_iterator::swap(glob_iterator& other) {
-    std::swap(M_pathnames, other.M_pathnames);
-    std::swap(M_index, other.M_index);
-    return *this;
-  }
-
-  CPPGLOB_INLINE bool glob_iterator::finished() const {
-    return M_pathnames.empty() || M_index >= M_pathnames.size();
-  }
-
-#endif
-
 }  // namespace cppglob
 
 #endif
@@ -0,0 +1,67 @@
+/**
+ * @file cppglob/matcher.hpp
+ * @brief Shell patterns compiled to a bit-parallel automaton
+ *
+ * Local addition to the vendored cppglob, under the same MIT license.
+ */
+
+#ifndef CPPGLOB_MATCHER_HPP
+#define CPPGLOB_MATCHER_HPP
+
+#include <array>
+#include <cstdint>
+#include <regex>
+#include <vector>
+#include "config.hpp"
+#include "fnmatch.hpp"
+
+namespace cppglob {
+  /**
+   * @brief shell pattern compiled once, matched without std::regex
+   *
+   * Accepts the same patterns as translate() ('*', '?', '[seq]', '[!seq]').
+   * The pattern becomes a Shift-And automaton: state j means "the first j
+   * characters of the pattern other than '*' have matched", and a '*' is a
+   * self loop on the state before it. All states advance together with one
+   * shift, one AND with the character's mask and one OR per character, so
+   * a match is linear in the name and never backtracks.
+   *
+   * Patterns with more than 63 non-'*' characters fall back to std::regex.
+   */
+  class CPPGLOB_EXPORT matcher {
+  public:
+    explicit matcher(const string_view_type& pat);
+
+    /**
+     * @brief whether the whole of name matches the pattern
+     */
+    bool operator()(const string_view_type& name) const;
+
+  private:
+    struct char_class {
+      bool negated = false;
+      /// inclusive ranges
+      std::vector<std::pair<char_type, char_type>> ranges;
+      bool contains(char_type c) const;
+    };
+    struct token {
+      enum kind_type { literal, any, set } kind = literal;
+      char_type c = 0;
+      char_class cls;
+      bool accepts(char_type c) const;
+    };
+
+    std::uint64_t mask_of(char_type c) const;
+
+    std::vector<token> tokens_;
+    /// bit j: token j accepts the byte
+    std::array<std::uint64_t, 256> byte_masks_{};
+    /// bit j: a '*' follows the first j tokens
+    std::uint64_t star_mask_ = 0;
+    std::uint64_t accept_bit_ = 0;
+    bool use_regex_ = false;
+    std::basic_regex<char_type> regex_;
+  };
+}  // namespace cppglob
+
+#endif
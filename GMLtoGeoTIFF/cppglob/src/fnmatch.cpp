@@ -26,15 +26,10 @@
 #include <regex>
 #include <filesystem>
 #include <cppglob/fnmatch.hpp>
+#include <cppglob/matcher.hpp>
 
 namespace cppglob {
-  using regex_type = std::basic_regex<char_type>;
-
   namespace detail {
-    CPPGLOB_INLINE regex_type compile_pattern(const string_view_type& pat) {
-      return regex_type(translate(pat));
-    }
-
     CPPGLOB_INLINE string_type replace_all(const string_view_type& str,
                                            const string_view_type& from,
                                            const string_view_type& to) {
@@ -77,10 +72,9 @@ namespace cppglob {
 
   void filter(std::vector<fs::path>& names, const string_view_type& pat) {
     string_type pat_str = detail::normpath(pat);
-    regex_type re =
-        detail::compile_pattern(string_view_type(&pat_str[0], pat_str.size()));
+    const matcher match(pat_str);
     auto filter_fn = [&](std::vector<fs::path>::value_type& p) -> bool {
-      return !std::regex_match(p.lexically_normal().native(), re);
+      return !match(p.lexically_normal().native());
     };
 
     auto result = std::remove_if(names.begin(), names.end(), filter_fn);
@@ -119,10 +113,17 @@ namespace cppglob {
           string_type stuff = detail::replace_all(
               string_view_type(&pat[i], j - i), CStr("\\"), CStr("\\\\"));
           i = j + 1;
+          std::size_t first = 0;
           if (stuff[0] == '!') {
             stuff[0] = '^';
+            first = 1;
           } else if (stuff[0] == '^') {
-            stuff[0] = '\\';
+            stuff.insert(stuff.begin(), '\\');
+            first = 2;
+          }
+          // A leading ']' is a member; ECMAScript would close the set on it.
+          if (first < stuff.size() && stuff[first] == ']') {
+            stuff.insert(stuff.begin() + first, '\\');
           }
           res += '[';
           res += stuff;
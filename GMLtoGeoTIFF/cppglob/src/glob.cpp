@@ -24,9 +24,12 @@
 #include <cstdlib>
 #include <algorithm>
 #include <filesystem>
+#include <optional>
+#include <vector>
 #include <cppglob/fnmatch.hpp>
 #include <cppglob/glob.hpp>
 #include <cppglob/iglob.hpp>
+#include <cppglob/matcher.hpp>
 
 namespace cppglob {
   namespace detail {
@@ -51,149 +54,182 @@ namespace cppglob {
       return pathname.native() == CStr("**");
     }
 
-    CPPGLOB_INLINE std::vector<fs::path> iterdir(const fs::path& dirname,
-                                                 bool dironly) {
-      fs::path base_dir = (dirname.empty()) ? fs::current_path() : dirname;
-
-      if (!fs::is_directory(base_dir)) {
-        return std::vector<fs::path>();
-      }
-
-      fs::directory_iterator files(base_dir);
-
-      std::vector<fs::path> ret;
-
-      for (auto&& file : files) {
-        if (!dironly || fs::is_directory(file)) {
-          ret.push_back(file.path().filename());
+    /**
+     * @brief one open directory of the walk
+     *
+     * A frame either matches its entries against components[index], or (walk)
+     * descends through every non-hidden directory below a '**'.
+     */
+    struct glob_frame {
+      fs::path dir;
+      std::size_t index;
+      bool walk;
+      fs::directory_iterator it;
+    };
+
+    struct glob_component {
+      enum kind_type { literal, pattern, recursive } kind;
+      fs::path name;
+      std::optional<matcher> match;
+      bool hidden;
+    };
+
+    struct glob_state {
+      glob_state(const fs::path& pathname, bool recursive);
+
+      /// A finished walk that still holds one match (glob_iterator++).
+      explicit glob_state(fs::path match)
+          : current(std::move(match)), ready(true) {}
+
+      /// Advance to the next match; false once the walk is over.
+      bool next();
+
+      fs::path current;
+      bool ready = false;
+
+     private:
+      bool enter(const fs::path& dir, std::size_t index);
+      void open(const fs::path& dir, std::size_t index, bool walk);
+
+      std::vector<glob_component> components;
+      std::vector<glob_frame> stack;
+    };
+
+    glob_state::glob_state(const fs::path& pathname, bool recursive) {
+      // The literal leading part is used as is; every component from the
+      // first one with magic on is matched while walking.
+      fs::path prefix;
+      for (const auto& part : pathname) {
+        if (components.empty() && !has_magic(part.native())) {
+          prefix /= part;
+          continue;
+        }
+        glob_component c{glob_component::literal, part, std::nullopt,
+                         ishidden(part)};
+        if (recursive && isrecursive(part)) {
+          c.kind = glob_component::recursive;
+        } else if (has_magic(part.native())) {
+          c.kind = glob_component::pattern;
+          c.match.emplace(part.native());
         }
+        components.push_back(std::move(c));
       }
-      return ret;
-    }
-
-    CPPGLOB_INLINE std::vector<fs::path> rlistdir(const fs::path& dirname,
-                                                  bool dironly) {
-      std::vector<fs::path> ret;
 
-      for (auto&& x : iterdir(dirname, dironly)) {
-        if (!ishidden(x)) {
-          ret.push_back(x);
-          fs::path path = (dirname.empty()) ? x : (dirname / x);
-
-          if (fs::is_directory(path)) {
-            for (auto&& y : rlistdir(path, dironly)) {
-              ret.push_back(x / y);
-            }
-          }
+      if (components.empty()) {
+        std::error_code ec;
+        if (fs::exists(pathname, ec)) {
+          current = pathname;
+          ready = true;
         }
+        return;
       }
-
-      return ret;
+      ready = enter(prefix, 0) || next();
     }
 
-    CPPGLOB_INLINE std::vector<fs::path> glob0(const fs::path& dirname,
-                                               const fs::path& basename,
-                                               bool dironly) {
-      if (basename.empty()) {
-        if (fs::is_directory(dirname)) {
-          return std::vector<fs::path>({basename});
-        }
-      } else if (fs::exists(dirname / basename)) {
-        return std::vector<fs::path>({basename});
+    void glob_state::open(const fs::path& dir, std::size_t index, bool walk) {
+      std::error_code ec;
+      fs::directory_iterator it(dir.empty() ? fs::path(CStr(".")) : dir, ec);
+      if (!ec) {
+        stack.push_back(glob_frame{dir, index, walk, std::move(it)});
       }
-
-      return std::vector<fs::path>();
     }
 
-    CPPGLOB_INLINE std::vector<fs::path> glob1(const fs::path& dirname,
-                                               const fs::path& pattern,
-                                               bool dironly) {
-      std::vector<fs::path> names = iterdir(dirname, dironly);
-
-      if (ishidden(pattern)) {
-        auto result =
-            std::remove_if(names.begin(), names.end(),
-                           [](fs::path& p) -> bool { return ishidden(p); });
-        names.erase(result, names.end());
+    bool glob_state::enter(const fs::path& dir, std::size_t index) {
+      if (index == components.size()) {
+        current = dir;
+        return true;
+      }
+      const auto& c = components[index];
+      const bool last = index + 1 == components.size();
+      std::error_code ec;
+
+      switch (c.kind) {
+        case glob_component::literal: {
+          fs::path path = dir / c.name;
+          if (last ? fs::exists(path, ec) : fs::is_directory(path, ec)) {
+            return enter(path, index + 1);
+          }
+          return false;
+        }
+        case glob_component::pattern:
+          open(dir, index, false);
+          return false;
+        case glob_component::recursive:
+        default:
+          // '**' matches zero directories first: "dir/" when it is the last
+          // component (except for a bare "**"), otherwise the rest of the
+          // pattern in dir itself.
+          open(dir, index, true);
+          if (!last) {
+            return enter(dir, index + 1);
+          }
+          if (dir.empty()) {
+            return false;
+          }
+          current = dir / fs::path();
+          return true;
       }
-
-      const string_type& pattern_str = pattern.native();
-      ::cppglob::filter(names,
-                        string_view_type(&pattern_str[0], pattern_str.size()));
-      return names;
     }
 
-    CPPGLOB_INLINE std::vector<fs::path> glob2(const fs::path& dirname,
-                                               const fs::path& pattern,
-                                               bool dironly) {
-      assert(isrecursive(pattern));
-      std::vector<fs::path> result = rlistdir(dirname, dironly);
-
-      if (result.empty()) {
-        result.emplace_back("");
-      } else {
-        result.push_back(std::move(result.front()));
-        result[0] = fs::path("");
-      }
+    bool glob_state::next() {
+      while (!stack.empty()) {
+        auto& f = stack.back();
+        if (f.it == fs::directory_iterator()) {
+          stack.pop_back();
+          continue;
+        }
 
-      return result;
-    }
+        const fs::directory_entry entry = *f.it;
+        const std::size_t index = f.index;
+        const bool walk = f.walk;
+        fs::path name = entry.path().filename();
+        fs::path path = f.dir / name;
+        std::error_code ec;
+        f.it.increment(ec);
+        if (ec) {
+          f.it = fs::directory_iterator();
+        }
+        // f may dangle from here on.
 
-    CPPGLOB_INLINE std::vector<fs::path> iglob(const fs::path& pathname,
-                                               bool recursive, bool dironly) {
-      fs::path dirname = pathname.parent_path();
-      fs::path basename = pathname.filename();
+        const auto& c = components[index];
+        const bool last = index + 1 == components.size();
 
-      if (!has_magic(pathname)) {
-        assert(!dironly);
-        if (!basename.empty()) {
-          if (fs::exists(pathname)) {
-            return std::vector<fs::path>({pathname});
+        if (walk) {
+          if (ishidden(name)) {
+            continue;
           }
-        } else {
-          if (fs::is_directory(dirname)) {
-            return std::vector<fs::path>({pathname});
+          const bool is_dir = entry.is_directory(ec);
+          if (last) {
+            if (is_dir) {
+              open(path, index, true);
+            }
+            current = std::move(path);
+            return true;
           }
+          if (is_dir) {
+            open(path, index, true);
+            if (enter(path, index + 1)) {
+              return true;
+            }
+          }
+          continue;
         }
 
-        return std::vector<fs::path>();
-      }
-
-      if (dirname.empty()) {
-        if (recursive && isrecursive(basename)) {
-          return glob2(dirname, basename, dironly);
-        } else {
-          return glob1(dirname, basename, dironly);
+        if (ishidden(name) && !c.hidden) {
+          continue;
         }
-      }
-
-      std::vector<fs::path> dirs;
-      if (dirname != pathname && has_magic(dirname)) {
-        dirs = iglob(dirname, recursive, true);
-      } else {
-        dirs.push_back(dirname);
-      }
-
-      std::vector<fs::path> (*glob_in_dir)(const fs::path&, const fs::path&,
-                                           bool);
-      if (has_magic(basename)) {
-        if (recursive && isrecursive(basename)) {
-          glob_in_dir = glob2;
-        } else {
-          glob_in_dir = glob1;
+        if (!(*c.match)(name.native())) {
+          continue;
         }
-      } else {
-        glob_in_dir = glob0;
-      }
-
-      std::vector<fs::path> files;
-      for (auto&& dirname : dirs) {
-        for (auto&& name : glob_in_dir(dirname, basename, dironly)) {
-          files.emplace_back(dirname / name);
+        if (last) {
+          current = std::move(path);
+          return true;
+        }
+        if (entry.is_directory(ec) && enter(path, index + 1)) {
+          return true;
         }
       }
-
-      return files;
+      return false;
     }
 
 #ifdef CPPGLOB_IS_WINDOWS
@@ -251,30 +287,67 @@ namespace cppglob {
   }  // namespace detail
 
   std::vector<fs::path> glob(const fs::path& pathname, bool recursive) {
-    std::vector<fs::path> files = detail::iglob(pathname, recursive, false);
-    if (recursive && detail::isrecursive(pathname)) {
-      assert(files.size() > 0L);
+    return std::vector<fs::path>(glob_iterator(pathname, recursive),
+                                 glob_iterator());
+  }
 
-      // remove first value
-      files[0] = std::move(files.back());
-      files.pop_back();
+  glob_iterator iglob(const fs::path& pathname, bool recursive) {
+    return glob_iterator(pathname, recursive);
+  }
+
+  glob_iterator iglob() { return glob_iterator(); }
+
+  glob_iterator::glob_iterator() noexcept = default;
+
+  glob_iterator::glob_iterator(const fs::path& pathname, bool recursive)
+      : M_state(std::make_shared<detail::glob_state>(pathname, recursive)) {
+    if (!M_state->ready) {
+      M_state.reset();
     }
+  }
 
-    return files;
+  glob_iterator::reference glob_iterator::operator*() {
+    return M_state->current;
+  }
+  glob_iterator::const_reference glob_iterator::operator*() const {
+    return M_state->current;
   }
 
-  glob_iterator iglob(const fs::path& pathname, bool recursive) {
-    std::vector<fs::path> files = detail::iglob(pathname, recursive, false);
-    glob_iterator it(std::move(files));
+  glob_iterator::pointer glob_iterator::operator->() {
+    return &M_state->current;
+  }
+  glob_iterator::const_pointer glob_iterator::operator->() const {
+    return &M_state->current;
+  }
 
-    if (recursive && detail::isrecursive(pathname)) {
-      ++it;
+  bool glob_iterator::operator==(const glob_iterator& other) const {
+    return M_state == other.M_state;
+  }
+
+  bool glob_iterator::operator!=(const glob_iterator& other) const {
+    return !(*this == other);
+  }
+
+  glob_iterator& glob_iterator::operator++() {
+    if (!M_state->next()) {
+      M_state.reset();
     }
+    return *this;
+  }
 
-    return it;
+  glob_iterator glob_iterator::operator++(int) {
+    glob_iterator old;
+    old.M_state = std::make_shared<detail::glob_state>(M_state->current);
+    ++*this;
+    return old;
   }
 
-  glob_iterator iglob() { return glob_iterator(); }
+  glob_iterator& glob_iterator::swap(glob_iterator& other) {
+    std::swap(M_state, other.M_state);
+    return *this;
+  }
+
+  bool glob_iterator::finished() const { return !M_state; }
 
   fs::path escape(const fs::path& pathname) {
 #ifndef CPPGLOB_IS_WINDOWS
@@ -0,0 +1,130 @@
+/*
+ * Local addition to the vendored cppglob, under the same MIT license.
+ */
+
+#include <cppglob/matcher.hpp>
+
+namespace cppglob {
+  namespace {
+    constexpr std::size_t max_tokens = 63;
+  }  // namespace
+
+  bool matcher::char_class::contains(char_type c) const {
+    bool found = false;
+    for (const auto& r : ranges) {
+      if (r.first <= c && c <= r.second) {
+        found = true;
+        break;
+      }
+    }
+    return found != negated;
+  }
+
+  bool matcher::token::accepts(char_type ch) const {
+    switch (kind) {
+      case literal:
+        return ch == c;
+      case any:
+        return true;
+      default:
+        return cls.contains(ch);
+    }
+  }
+
+  matcher::matcher(const string_view_type& pat) {
+    std::size_t i = 0, n = pat.size();
+    while (i < n) {
+      auto c = pat[i];
+      ++i;
+
+      if (c == '*') {
+        star_mask_ |= std::uint64_t(1) << tokens_.size();
+        continue;
+      }
+
+      token t;
+      if (c == '?') {
+        t.kind = token::any;
+      } else if (c == '[') {
+        // Same bracket rules as translate(): a leading '!' negates, a ']'
+        // right after it is literal, and an unterminated '[' is literal.
+        std::size_t j = i;
+        if (j < n && pat[j] == '!') {
+          ++j;
+        }
+        if (j < n && pat[j] == ']') {
+          ++j;
+        }
+        while (j < n && pat[j] != ']') {
+          ++j;
+        }
+
+        if (j >= n) {
+          t.c = '[';
+        } else {
+          t.kind = token::set;
+          std::size_t k = i;
+          if (pat[k] == '!') {
+            t.cls.negated = true;
+            ++k;
+          }
+          while (k < j) {
+            if (k + 2 < j && pat[k + 1] == '-') {
+              if (pat[k] <= pat[k + 2]) {
+                t.cls.ranges.emplace_back(pat[k], pat[k + 2]);
+              }
+              k += 3;
+            } else {
+              t.cls.ranges.emplace_back(pat[k], pat[k]);
+              ++k;
+            }
+          }
+          i = j + 1;
+        }
+      } else {
+        t.c = c;
+      }
+      tokens_.push_back(std::move(t));
+    }
+
+    if (tokens_.size() > max_tokens) {
+      use_regex_ = true;
+      regex_ = std::basic_regex<char_type>(translate(pat));
+      return;
+    }
+
+    accept_bit_ = std::uint64_t(1) << tokens_.size();
+    for (std::size_t b = 0; b < byte_masks_.size(); ++b) {
+      byte_masks_[b] = mask_of(static_cast<char_type>(b));
+    }
+  }
+
+  std::uint64_t matcher::mask_of(char_type c) const {
+    std::uint64_t mask = 0;
+    for (std::size_t j = 0; j < tokens_.size(); ++j) {
+      if (tokens_[j].accepts(c)) {
+        mask |= std::uint64_t(1) << (j + 1);
+      }
+    }
+    return mask;
+  }
+
+  bool matcher::operator()(const string_view_type& name) const {
+    if (use_regex_) {
+      return std::regex_match(name.begin(), name.end(), regex_);
+    }
+
+    std::uint64_t state = 1;
+    for (auto c : name) {
+      using uchar = std::make_unsigned_t<char_type>;
+      const auto u = static_cast<uchar>(c);
+      const std::uint64_t mask = u < byte_masks_.size() ? byte_masks_[u]
+                                                         : mask_of(c);
+      state = ((state << 1) & mask) | (state & star_mask_);
+      if (state == 0) {
+        return false;
+      }
+    }
+    return (state & accept_bit_) != 0;
+  }
+}  // namespace cppglob
@@ -0,0 +1,30 @@
+// libFuzzer target for the GML header: XML parse, gml:Envelope corners and
+// gml:GridEnvelope size. Malformed input must come back as a false
+// read_header, never as a crash or an exception.
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "GmlDoc.h"
+
+using namespace gistool;
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data,
+                                      std::size_t size) {
+  // rapidxml parses in place and needs the terminating NUL.
+  IoBuffer buffer(size + 1);
+  if (size) std::memcpy(buffer.data(), data, size);
+  buffer[size] = '\0';
+
+  GmlDoc doc(fs::path("fuzz") / "header.xml");
+  doc.set_buffer(std::move(buffer));
+  if (!doc.try_parse()) return 0;
+
+  GridHeader header;
+  std::string error;
+  if (doc.read_header(header, error)) {
+    double transform[6];
+    header.transform(transform);
+  }
+  return 0;
+}
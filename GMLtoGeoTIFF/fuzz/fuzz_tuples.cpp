@@ -0,0 +1,26 @@
+// libFuzzer target for the gml:tupleList decoder. The first two bytes pick
+// the grid size (1..64 each) so short inputs reach both the "missing tuples"
+// and the "too many tuples" paths, the third the start cell; the rest is the
+// element text.
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GmlDoc.h"
+
+using namespace gistool;
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data,
+                                      std::size_t size) {
+  if (size < 3) return 0;
+  const std::uint32_t cols = data[0] % 64 + 1;
+  const std::uint32_t rows = data[1] % 64 + 1;
+  const std::uint64_t start = data[2] % (cols * rows);
+  // std::string keeps the text NUL terminated, as rapidxml leaves it.
+  const std::string text(reinterpret_cast<const char*>(data + 3), size - 3);
+
+  std::vector<float> cells(static_cast<std::size_t>(cols) * rows);
+  std::string error;
+  decode_tuple_list(text.c_str(), cols, rows, start, cells.data(), error);
+  return 0;
+}
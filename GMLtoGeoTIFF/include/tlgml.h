@@ -0,0 +1,189 @@
+/**
+ * @file tlgml.h
+ * @brief C API of libtlgml: JPGIS (GML) DEM to GDAL conversion for embedding
+ * in other processes.
+ *
+ * Functions without a context are thread-safe and need only GDAL registered
+ * (tlgml_context_create does that). A context owns the worker pool and the
+ * output spatial reference, and is meant to live as long as the service.
+ *
+ * Paths are UTF-8. Every function returning tlgml_status leaves a message
+ * for the calling thread in tlgml_last_error() when it fails.
+ */
+
+#ifndef TLGML_H
+#define TLGML_H
+
+#include <gdal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) && defined(TLGML_SHARED)
+#ifdef TLGML_BUILDING
+#define TLGML_API __declspec(dllexport)
+#else
+#define TLGML_API __declspec(dllimport)
+#endif
+#elif defined(__GNUC__) && defined(TLGML_SHARED)
+#define TLGML_API __attribute__((visibility("default")))
+#else
+#define TLGML_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Bumped whenever a function or struct changes incompatibly. */
+#define TLGML_API_VERSION 2
+
+/** @brief Same values as the per-file status of the tlgml command. */
+typedef enum tlgml_status {
+  TLGML_OK = 0,
+  TLGML_OPEN_FAILED = 1,    /**< Input could not be opened or read. */
+  TLGML_PARSE_FAILED = 2,   /**< Not well-formed XML. */
+  TLGML_INVALID_HEADER = 3, /**< Envelope, grid or tupleList broken. */
+  TLGML_WRITE_FAILED = 4,   /**< GDAL could not create or write the output. */
+  TLGML_INVALID_ARGUMENT = 5,
+  TLGML_TOO_LARGE = 6 /**< Needs more memory than could be allocated. */
+} tlgml_status;
+
+/** @brief Value of cells without a tuple. */
+#define TLGML_NODATA (-9999.0f)
+
+/** @brief TLGML_API_VERSION the library was built with. */
+TLGML_API int tlgml_api_version(void);
+
+TLGML_API const char* tlgml_status_string(tlgml_status status);
+
+/**
+ * @brief Message of the last failure on this thread, "" if none. Valid until
+ * the next libtlgml call on the thread.
+ */
+TLGML_API const char* tlgml_last_error(void);
+
+/**
+ * @brief Georeferencing of a DEM. The corners are the gml:Envelope
+ * lowerCorner / upperCorner (latitude, longitude).
+ */
+typedef struct tlgml_header {
+  double lower_lat;
+  double lower_lon;
+  double upper_lat;
+  double upper_lon;
+  uint32_t cols;
+  uint32_t rows;
+  /** GDAL geotransform, north up. */
+  double geotransform[6];
+} tlgml_header;
+
+/** @brief Decoded raster, row major, cols * rows cells. */
+typedef struct tlgml_grid {
+  tlgml_header header;
+  float* cells;
+} tlgml_grid;
+
+/** @brief Read only the header. data need not be NUL terminated. */
+TLGML_API tlgml_status tlgml_probe_buffer(const char* data, size_t size,
+                                          tlgml_header* header);
+/** @brief As tlgml_probe_buffer; path may name a member "dir/a.zip/b.xml". */
+TLGML_API tlgml_status tlgml_probe_file(const char* path,
+                                        tlgml_header* header);
+
+/**
+ * @brief Decode the whole DEM. On success grid->cells is owned by the caller
+ * and released with tlgml_grid_free.
+ */
+TLGML_API tlgml_status tlgml_read_grid_buffer(const char* data, size_t size,
+                                              tlgml_grid* grid);
+TLGML_API tlgml_status tlgml_read_grid_file(const char* path,
+                                            tlgml_grid* grid);
+TLGML_API void tlgml_grid_free(tlgml_grid* grid);
+
+/**
+ * @brief Options of a context. Initialize with tlgml_options_init, which also
+ * sets struct_size, then change what is needed.
+ */
+typedef struct tlgml_options {
+  size_t struct_size;
+  /** Batch output root; the sources' parent directories are mirrored. */
+  const char* output_directory;
+  /** Spatial reference of the outputs (default 6668, JGD2011). */
+  int epsg;
+  /** Worker threads, 0: hardware concurrency. */
+  uint32_t threads;
+  /** Files in flight at once during a batch, 0: 4 per worker. */
+  uint32_t max_inflight;
+  /** Bound on the estimated memory of files in flight, 0: no bound. */
+  uint64_t max_inflight_bytes;
+  /** Attempts per file for transient (I/O) failures, at least 1. */
+  uint32_t max_attempts;
+  /** GDAL block cache in MB, shared by all workers, 0: GDAL's default. */
+  int64_t gdal_cache_mb;
+} tlgml_options;
+
+TLGML_API void tlgml_options_init(tlgml_options* options);
+
+typedef struct tlgml_context tlgml_context;
+
+/**
+ * @brief Register GDAL drivers (once per process) and start the workers.
+ * Returns NULL on failure (see tlgml_last_error).
+ */
+TLGML_API tlgml_context* tlgml_context_create(const tlgml_options* options);
+/** @brief Waits for a running batch, then stops the workers. */
+TLGML_API void tlgml_context_destroy(tlgml_context* context);
+
+/**
+ * @brief Convert to an in-memory (MEM driver) GDAL dataset with the
+ * context's spatial reference. The caller closes it with GDALClose, or
+ * copies it with GDALCreateCopy to any format.
+ */
+TLGML_API tlgml_status tlgml_open_dataset_buffer(tlgml_context* context,
+                                                 const char* data, size_t size,
+                                                 GDALDatasetH* dataset);
+TLGML_API tlgml_status tlgml_open_dataset_file(tlgml_context* context,
+                                               const char* path,
+                                               GDALDatasetH* dataset);
+
+/**
+ * @brief Final outcome of one file of a batch. The strings are valid only
+ * during the callback.
+ */
+typedef struct tlgml_result {
+  const char* source;
+  const char* output;
+  tlgml_status status;
+  const char* message;
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+  double seconds;
+  uint32_t attempts;
+  /** Nonzero when the output was already up to date. */
+  int skipped;
+} tlgml_result;
+
+/**
+ * @brief Called once per file, from the worker threads, concurrently.
+ */
+typedef void (*tlgml_result_callback)(const tlgml_result* result,
+                                      void* user_data);
+
+/**
+ * @brief Convert files to GeoTIFF under the context's output directory on
+ * the context's workers and return when all are done. Transient failures
+ * are retried up to max_attempts; callback sees only the final result.
+ * Batches on one context run one at a time. failed (optional) receives the
+ * number of files that did not convert.
+ */
+TLGML_API tlgml_status tlgml_convert_files(tlgml_context* context,
+                                           const char* const* paths,
+                                           size_t count,
+                                           tlgml_result_callback callback,
+                                           void* user_data, size_t* failed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* !TLGML_H */
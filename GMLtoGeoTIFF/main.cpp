@@ -9,19 +9,42 @@
 #include <stdio.h>
 #include <vrtdataset.h>
 
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <queue>
 #include <sstream>
+#include <chrono>
+#include <csignal>
 #include <string>
 #include <thread>
 
+#include "ConvertResult.h"
+#include "ConverterManager.h"
+#include "Crawler.h"
+#include "GdalWorker.h"
 #include "GmlDoc.h"
+#include "InputList.h"
+#include "Journal.h"
+#include "Manifest.h"
+#include "MemoryStats.h"
+#include "Metrics.h"
+#include "Mosaic.h"
+#include "Plan.h"
+#include "Progress.h"
+#include "Shard.h"
+#include "SourceFilter.h"
+#include "Watcher.h"
+#include "ZipArchive.h"
 #include "cxxopts.hpp"
 #include "rapidxml.hpp"
 #include "rapidxml_utils.hpp"
 #include "threadpool.h"
+#include "trace.h"
 
 using String = std::string;
 
@@ -31,6 +54,12 @@ namespace rx = rapidxml;
 using namespace std;
 using namespace gistool;
 
+namespace {
+volatile std::sig_atomic_t stop_requested = 0;
+
+extern "C" void request_stop(int) { stop_requested = 1; }
+}  // namespace
+
 int main(int argc, char* argv[]) {
   GDALAllRegister();
   CPLPushErrorHandler(CPLQuietErrorHandler);
@@ -38,6 +67,26 @@ int main(int argc, char* argv[]) {
   bool blist = false;
   bool combine = false;
   bool recursive = false;
+  bool force = false;
+  bool resume = false;
+  uint32_t merge_count = 0;
+  ShardSpec shard;
+  uint32_t max_attempts = 3;
+  uint32_t crawl_threads = 8;
+  vector<string> include_patterns;
+  vector<string> exclude_patterns;
+  string inputs_from;
+  bool watch = false;
+  bool plan_only = false;
+  string plan_calibration;
+  string metrics_json;
+  string trace_path;
+  bool memory_stats = false;
+  bool verbose = false;
+  int progress_seconds = -1;
+  uint32_t watch_settle = 2000;
+  GdalTuning gdal_tuning;
+  ConverterOptions converter_options;
   fs::path source_directory("gmls");
   fs::path target_directory("out");
   try {
@@ -49,80 +98,502 @@ int main(int argc, char* argv[]) {
         cxxopts::value<std::string>()->default_value("gmls"))(
         "r,recursive", "Search recursively",
         cxxopts::value<bool>()->default_value("false"))(
+        "crawl-threads", "Directories listed in parallel with -r",
+        cxxopts::value<uint32_t>()->default_value("8"))(
+        "include", "Convert only names matching a glob (repeatable), e.g. "
+                   "FG-GML-5339*-DEM5A*.xml",
+        cxxopts::value<vector<string>>())(
+        "exclude", "Skip names matching a glob (repeatable)",
+        cxxopts::value<vector<string>>())(
+        "metrics-json", "Write per-stage timings and counters as JSON",
+        cxxopts::value<std::string>()->default_value(""))(
+        "v,verbose", "Print every output path",
+        cxxopts::value<bool>()->default_value("false"))(
+        "progress", "Seconds between progress lines, 0 for none "
+                    "(default: 1 on a terminal, 30 otherwise)",
+        cxxopts::value<int>()->default_value("-1"))(
+        "memory-stats", "Report max RSS, per-file peak memory and buffer "
+                        "allocations",
+        cxxopts::value<bool>()->default_value("false"))(
+        "max-inflight-mb", "Limit the estimated memory of files in flight "
+                           "(0: no limit)",
+        cxxopts::value<uint64_t>()->default_value("0"))(
+        "trace", "Write a timeline of tasks and stages for chrome://tracing "
+                 "or Perfetto",
+        cxxopts::value<std::string>()->default_value(""))(
+        "plan", "Estimate input, output, memory and time without converting",
+        cxxopts::value<bool>()->default_value("false"))(
+        "plan-calibration",
+        "tlgml_bench output (JSON lines) to project --plan times with",
+        cxxopts::value<std::string>()->default_value(""))(
+        "watch", "Keep running and convert files as they arrive (Linux)",
+        cxxopts::value<bool>()->default_value("false"))(
+        "watch-settle", "Quiet time in ms before an arrived file is converted",
+        cxxopts::value<uint32_t>()->default_value("2000"))(
+        "inputs-from", "Read source paths (and optional sizes) from a file "
+                       "or - for stdin instead of listing -s",
+        cxxopts::value<std::string>()->default_value(""))(
         "o,output", "Target directory",
-        cxxopts::value<std::string>()->default_value("out"));
+        cxxopts::value<std::string>()->default_value("out"))(
+        "retries", "Retry count for transient I/O failures",
+        cxxopts::value<uint32_t>()->default_value("2"))(
+        "pin", "Pin worker threads to cores (NUMA local buffers)",
+        cxxopts::value<bool>()->default_value("false"))(
+        "j,threads", "Worker thread count (0: all cores)",
+        cxxopts::value<uint32_t>()->default_value("0"))(
+        "gdal-cachemax", "GDAL block cache in MB (0: GDAL's default)",
+        cxxopts::value<int64_t>()->default_value("0"))(
+        "gdal-threads", "GDAL_NUM_THREADS (e.g. ALL_CPUS, 1)",
+        cxxopts::value<std::string>()->default_value(""))(
+        "io", "I/O backend: auto, uring, pread or sync",
+        cxxopts::value<std::string>()->default_value("auto"))(
+        "io-depth", "Reads/writes kept in flight",
+        cxxopts::value<unsigned>()->default_value("64"))(
+        "f,force", "Reconvert inputs recorded as up to date in the manifest",
+        cxxopts::value<bool>()->default_value("false"))(
+        "resume", "Continue an interrupted run from its journal",
+        cxxopts::value<bool>()->default_value("false"))(
+        "shard", "Convert only part i of N (0 <= i < N), e.g. 2/8",
+        cxxopts::value<std::string>()->default_value("0/1"))(
+        "shard-balance", "Assign shards by input size instead of hash",
+        cxxopts::value<bool>()->default_value("false"))(
+        "merge-shards", "Merge manifests of N shards and build the VRT",
+        cxxopts::value<uint32_t>()->default_value("0"));
 
     auto result = options.parse(argc, argv);
     blist = result["list"].as<bool>();
     combine = result["combine"].as<bool>();
     recursive = result["recursive"].as<bool>();
+    crawl_threads = result["crawl-threads"].as<uint32_t>();
+    inputs_from = result["inputs-from"].as<std::string>();
+    watch = result["watch"].as<bool>();
+    plan_only = result["plan"].as<bool>();
+    plan_calibration = result["plan-calibration"].as<std::string>();
+    metrics_json = result["metrics-json"].as<std::string>();
+    trace_path = result["trace"].as<std::string>();
+    memory_stats = result["memory-stats"].as<bool>();
+    converter_options.max_inflight_bytes =
+        result["max-inflight-mb"].as<uint64_t>() * 1024 * 1024;
+    verbose = result["verbose"].as<bool>();
+    progress_seconds = result["progress"].as<int>();
+    watch_settle = result["watch-settle"].as<uint32_t>();
+    if (result.count("include")) {
+      include_patterns = result["include"].as<vector<string>>();
+    }
+    if (result.count("exclude")) {
+      exclude_patterns = result["exclude"].as<vector<string>>();
+    }
     source_directory.assign(result["source"].as<std::string>());
     target_directory.assign(result["output"].as<std::string>());
+    max_attempts = result["retries"].as<uint32_t>() + 1;
+    force = result["force"].as<bool>();
+    resume = result["resume"].as<bool>();
+    if (!parse_shard(result["shard"].as<std::string>(), shard)) {
+      throw cxxopts::OptionException("invalid shard");
+    }
+    shard.balance_by_size = result["shard-balance"].as<bool>();
+    if (watch && shard.balance_by_size) {
+      throw cxxopts::OptionException("--watch needs hash sharding");
+    }
+    merge_count = result["merge-shards"].as<uint32_t>();
+    converter_options.target_directory = target_directory;
+    converter_options.pin_threads = result["pin"].as<bool>();
+    converter_options.thread_count = result["threads"].as<uint32_t>();
+    converter_options.io_depth = result["io-depth"].as<unsigned>();
+    if (!parse_io_backend(result["io"].as<std::string>(),
+                          converter_options.io_backend)) {
+      throw cxxopts::OptionException("unknown I/O backend");
+    }
+    gdal_tuning.cache_mb = result["gdal-cachemax"].as<int64_t>();
+    gdal_tuning.num_threads = result["gdal-threads"].as<std::string>();
   } catch (cxxopts::OptionException& e) {
     std::cout << options.usage() << std::endl;
     std::cout << "Invalid args" << std::endl;
     return -1;
   }
 
+  const auto vrt_path = shard.file(target_directory, "mosaic.vrt");
+  if (merge_count > 0) {
+    bool merged = merge_shards(source_directory, target_directory, merge_count,
+                               target_directory / "mosaic.vrt");
+    cout << (merged ? "Merged " : "Merge failed: ") << merge_count
+         << " shards" << endl;
+    GDALDestroyDriverManager();
+    return merged ? 0 : 1;
+  }
+
   {
-    vector<fs::path> sources;
-
-    if (recursive) {
-      for (const auto& it :
-           fs::recursive_directory_iterator(source_directory)) {
-        if (!it.is_directory()) {
-          if (it.path().extension() == ".xml") {
-            sources.push_back(it.path());
-          }
+    /// 入力の列挙。サブディレクトリは並列に辿る。
+    DirectoryCrawler crawler(crawl_threads);
+    const SourceFilter filter(include_patterns, exclude_patterns);
+    using Found = std::function<void(SourceFile&&)>;
+    auto visit_file = [&](const fs::path& path, const Found& found) {
+      auto ext = path.extension();
+      if (ext == ".xml") {
+        if (!filter(path, source_directory)) return;
+        SourceFile source{path};
+        stat_source(path, source.size, source.mtime);
+        found(std::move(source));
+      } else if (is_zip_path(path)) {
+        /// 基盤地図情報のZIPは展開せずに中のxmlを直接読む。
+        vector<SourceFile> members;
+        /// クローラのスレッドで呼ばれるので例外を外に出さない。
+        std::error_code ec;
+        std::string error;
+        try {
+          ec = list_archive(path, members);
+          if (ec) error = ec.message();
+        } catch (std::exception& e) {
+          members.clear();
+          error = e.what();
+        }
+        if (!error.empty()) {
+          cerr << "Cannot read archive " << path << ": " << error << endl;
+        }
+        for (auto& m : members) {
+          if (filter(m.path, source_directory)) found(std::move(m));
         }
       }
-    } else {
-      for (const auto& it : fs::directory_iterator(source_directory)) {
-        if (!it.is_directory()) {
-          if (it.path().extension() == ".xml") {
-            sources.push_back(it.path());
+    };
+    auto enumerate = [&](const Found& found) {
+      /// 変換対象が外部のスケジューラから渡される場合はディレクトリを辿らない。
+      if (!inputs_from.empty()) {
+        std::ifstream file;
+        if (inputs_from != "-") {
+          file.open(fs::path(inputs_from), std::ios::binary);
+          if (!file) {
+            cerr << "Cannot read " << inputs_from << endl;
+            return;
+          }
+        }
+        InputList list(inputs_from == "-" ? std::cin : file);
+        SourceFile source;
+        while (list.next(source)) {
+          if (is_zip_path(source.path)) {
+            visit_file(source.path, found);
+          } else if (filter(source.path, source_directory)) {
+            found(std::move(source));
           }
         }
+        return;
       }
+
+      auto ec = crawler.crawl(source_directory, recursive,
+                              [&](const fs::path& path) {
+                                visit_file(path, found);
+                              });
+      if (ec) {
+        cerr << "Cannot list part of " << source_directory << ": "
+             << ec.message() << endl;
+      }
+    };
+
+    /// 一覧表示とサイズによる分担は全体が揃ってから。それ以外は見つけ次第変換する。
+    const bool stream = !blist && !shard.balance_by_size;
+    vector<SourceFile> files;
+    std::atomic<size_t> total{0};
+    std::atomic<size_t> selected{0};
+    if (!stream) {
+      std::mutex files_mutex;
+      enumerate([&](SourceFile&& source) {
+        std::lock_guard<std::mutex> lock(files_mutex);
+        files.push_back(std::move(source));
+      });
+      std::sort(files.begin(), files.end(),
+                [](const SourceFile& a, const SourceFile& b) {
+                  return a.path < b.path;
+                });
+      total = files.size();
+      files = select_shard(files, shard, source_directory);
+      selected = files.size();
     }
 
     if (blist) {
-      for (auto& e : sources) {
-        cout << e.filename() << endl;
+      if (shard.active()) {
+        cout << "Shard " << shard.index << "/" << shard.count << ": "
+             << selected << " of " << total << " files" << endl;
+      }
+      for (auto& e : files) {
+        cout << e.path.filename() << endl;
       }
       return 0;
     }
 
-    GDALDriver* gdriver = nullptr;
-    gdriver = GetGDALDriverManager()->GetDriverByName("GTiff");
-    OGRSpatialReference sref;
-    sref.importFromEPSG(6668);
-    {
-      concurrent::ThreadPoolExecutor executor;
-      cout << "Thread count: " << executor.thread_count() << endl;
-      for (const auto& it : sources) {
-        GmlDoc* gdoc = new GmlDoc(it);
-        gdoc->set_gdaldriver(GetGDALDriverManager()->GetDriverByName("GTiff"));
-        gdoc->set_spatialref(sref);
-
-        auto ftr = executor.submit([gdoc, &target_directory] {
-          gdoc->write_gtiff(target_directory);
-          delete gdoc;
+    /// 変換はせずに、入力を調べて所要時間とメモリを見積もる。
+    if (plan_only) {
+      /// 既定値は基準機での値。tlgml_benchの結果があればこの機械の値を使う。
+      PlanCalibration calibration;
+      std::string error;
+      if (!plan_calibration.empty() &&
+          !load_calibration(plan_calibration, calibration, error)) {
+        cerr << error << endl;
+        GDALDestroyDriverManager();
+        return 1;
+      }
+      Plan plan(calibration);
+      if (stream) {
+        enumerate([&](SourceFile&& source) {
+          ++total;
+          if (!in_shard(source, shard, source_directory)) return;
+          ++selected;
+          plan.add(source);
         });
+      } else {
+        for (const auto& source : files) plan.add(source);
+      }
+      if (shard.active()) {
+        cout << "Shard " << shard.index << "/" << shard.count << ": "
+             << selected << " of " << total << " files" << endl;
       }
+      apply_gdal_tuning(gdal_tuning);
+      PlanSystem system;
+      system.workers = converter_options.resolved_threads();
+      system.inflight = converter_options.resolved_inflight();
+      system.async_io = converter_options.io_backend != IoBackend::Sync;
+      system.gdal_cache_bytes = static_cast<uint64_t>(GDALGetCacheMax64());
+      plan.print(cout, system);
+      GDALDestroyDriverManager();
+      return 0;
     }
-  }
 
-  /// GeotiffをVRTへ。
-  if (!combine) {
-    GDALDestroyDriverManager();
-    return 0;
-  }
-  auto vrt_driver = GDALDriverManager().GetDriverByName("VRT");
-  if (!vrt_driver) {
-    cout << "Not found VRT driver" << endl;
-    GDALDestroyDriverManager();
-    return -1;
+    /// 前回の変換結果と比較して、変更のない入力は飛ばす。
+    Manifest manifest(source_directory, target_directory);
+    const auto manifest_path = shard.file(target_directory, Manifest::file_name);
+    if (!manifest.load(manifest_path)) {
+      cerr << "Cannot read " << manifest_path.string() << endl;
+    }
+
+    /// 中断した実行の続きから。完了済みの出力はジャーナルに記録されている。
+    const auto journal_path = shard.file(target_directory, Journal::file_name);
+    if (resume) {
+      auto replayed = Journal::replay(journal_path, manifest);
+      cout << "Resuming: " << replayed << " entries from journal" << endl;
+    } else if (fs::exists(journal_path)) {
+      cerr << "Discarding journal of an unfinished run (use --resume)" << endl;
+    }
+    std::error_code ec;
+    fs::create_directories(target_directory, ec);
+    Journal journal;
+    if (!journal.open(journal_path, resume)) {
+      cerr << "Cannot open " << journal_path.string() << endl;
+    }
+
+    ResultCollector results;
+    std::mutex unpublished_mutex;
+    vector<ManifestEntry> unpublished;
+    /// 進捗は別スレッドが数える。ワーカーはcoutに書かない。
+    const bool terminal = stderr_is_terminal();
+    if (progress_seconds < 0) progress_seconds = terminal ? 1 : 30;
+    ProgressReporter progress(cerr, results,
+                              std::chrono::seconds(progress_seconds), terminal);
+    results.set_observer([&](const ConvertResult& r) {
+      if (verbose && r.ok() && !r.skipped) {
+        progress.log(r.output.string(), cout);
+      }
+      auto entry = manifest.make_entry(r);
+      journal.append(entry);
+      if (watch) {
+        std::lock_guard<std::mutex> lock(unpublished_mutex);
+        unpublished.push_back(std::move(entry));
+      }
+    });
+    apply_gdal_tuning(gdal_tuning);
+    /// ワーカーが起動する前に有効にしておく (スレッド名を記録するため)。
+    if (!trace_path.empty()) concurrent::Tracer::start();
+    if (memory_stats) MemoryStats::enable();
+    const auto run_start = std::chrono::steady_clock::now();
+    {
+      ConverterManager manager(converter_options, results);
+      cout << "Thread count: " << manager.thread_count() << endl;
+      cout << "I/O: " << to_string(manager.io_backend()) << endl;
+      progress.start(manager.thread_count(),
+                     [&manager]() { return manager.busy_time(); });
+      auto submit = [&](SourceFile&& source) {
+        progress.add_expected();
+        if (!force) {
+          auto state = manifest.check(source);
+          if (state == Manifest::State::UpToDate) {
+            results.add_skipped();
+            return;
+          }
+          if (state == Manifest::State::CheckHash) {
+            source.expected_hash =
+                manifest.find(manifest.key(source.path))->hash;
+          }
+        }
+        manager.add_queue(std::move(source));
+      };
+      /// 複数ノードで分担する場合は自分の担当分だけ残す。
+      auto select = [&](SourceFile&& source) {
+        ++total;
+        if (!in_shard(source, shard, source_directory)) return;
+        ++selected;
+        submit(std::move(source));
+      };
+      /// 一時的なI/Oエラーだけ再試行する。
+      auto drain = [&]() {
+        manager.wait();
+        for (auto retry = results.take_retryable(max_attempts); !retry.empty();
+             retry = results.take_retryable(max_attempts)) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(500));
+          for (const auto& r : retry) {
+            progress.log("Retrying " + r.source.string() + " (" + r.message +
+                             ")",
+                         cerr);
+            manager.add_queue(
+                SourceFile{r.source, r.source_size, r.source_mtime},
+                r.attempts + 1);
+          }
+          manager.wait();
+        }
+      };
+
+      /// 最初の走査中に届いたファイルを取りこぼさないよう、監視は走査の前に
+      /// 始める。走査済みのファイルの通知はマニフェストで飛ばされる。
+      DirectoryWatcher watcher;
+      std::error_code watch_error;
+      if (watch) {
+        watcher.set_settle(std::chrono::milliseconds(watch_settle));
+        watch_error = watcher.open(source_directory, recursive);
+      }
+
+      if (stream) {
+        enumerate(select);
+      } else {
+        for (auto& source : files) submit(std::move(source));
+      }
+      progress.set_total_known();
+      if (shard.active()) {
+        progress.log("Shard " + std::to_string(shard.index) + "/" +
+                         std::to_string(shard.count) + ": " +
+                         std::to_string(selected) + " of " +
+                         std::to_string(total) + " files",
+                     cout);
+      }
+      drain();
+
+      /// 受け取り用ディレクトリを監視して、届いたファイルから順に変換する。
+      if (watch) {
+        if (watch_error) {
+          progress.log("Cannot watch " + source_directory.string() + ": " +
+                           watch_error.message(),
+                       cerr);
+        } else {
+          /// 変換済みの分をマニフェストとVRTへ反映する。VRTの作り直しは全出力を
+          /// 開くので、間隔を空ける。間隔内に見送った分は、間隔が明けてから
+          /// 作り直す。
+          const auto vrt_interval = std::chrono::seconds(60);
+          auto last_vrt = std::chrono::steady_clock::time_point();
+          bool vrt_pending = false;
+          auto rebuild_vrt = [&]() {
+            auto now = std::chrono::steady_clock::now();
+            if (now - last_vrt < vrt_interval) {
+              vrt_pending = true;
+              return;
+            }
+            vrt_pending = false;
+            last_vrt = now;
+            if (!build_vrt(vrt_path, manifest.outputs())) {
+              progress.log("Cannot build " + vrt_path.string(), cerr);
+            }
+          };
+          auto publish = [&]() {
+            vector<ManifestEntry> entries;
+            {
+              std::lock_guard<std::mutex> lock(unpublished_mutex);
+              entries.swap(unpublished);
+            }
+            if (entries.empty()) return;
+            for (auto& e : entries) manifest.update(std::move(e));
+            if (!manifest.save(manifest_path)) {
+              progress.log("Cannot write " + manifest_path.string(), cerr);
+              return;
+            }
+            journal.discard();
+            if (!journal.open(journal_path, false)) {
+              progress.log("Cannot open " + journal_path.string() +
+                               ", continuing without a journal",
+                           cerr);
+            }
+            /// 反映済みの結果は保持しない (失敗は最後の報告のために残す。
+            /// 同じソースが再変換されれば古い失敗は置き換わる)。
+            results.release_succeeded();
+            if (combine) rebuild_vrt();
+          };
+
+          std::signal(SIGINT, request_stop);
+          std::signal(SIGTERM, request_stop);
+          publish();
+          progress.log("Watching " + source_directory.string(), cout);
+          vector<fs::path> ready;
+          while (!stop_requested) {
+            ready.clear();
+            watcher.poll(std::chrono::milliseconds(250), ready);
+            if (watcher.take_overflow()) {
+              progress.log("Missed events, rescanning " +
+                               source_directory.string(),
+                           cerr);
+              enumerate(select);
+            }
+            for (const auto& path : ready) visit_file(path, select);
+            if (!ready.empty()) {
+              drain();
+              publish();
+            }
+            if (vrt_pending) rebuild_vrt();
+          }
+          progress.log("Stopped watching", cout);
+        }
+      }
+      progress.stop();
+    }
+
+    for (const auto& r : results.snapshot()) {
+      manifest.update(r);
+    }
+    if (manifest.save(manifest_path)) {
+      journal.discard();
+    } else {
+      cerr << "Cannot write " << manifest_path.string() << endl;
+    }
+
+    /// GeotiffをVRTへ。
+    if (combine) {
+      if (build_vrt(vrt_path, manifest.outputs())) {
+        cout << "VRT: " << vrt_path.string() << endl;
+      } else {
+        cerr << "Cannot build " << vrt_path.string() << endl;
+      }
+    }
+
+    results.print_summary(cout);
+    /// 段階ごとの所要時間。どこが律速しているかを見る。
+    const double wall = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - run_start)
+                            .count();
+    const auto metrics = Metrics::snapshot();
+    print_metrics(cout, metrics, wall);
+    if (memory_stats) print_memory_stats(cout, MemoryStats::report());
+    if (!metrics_json.empty() &&
+        !write_metrics_json(metrics_json, metrics, wall,
+                            converter_options.resolved_threads())) {
+      cerr << "Cannot write " << metrics_json << endl;
+    }
+    if (!trace_path.empty() && !concurrent::Tracer::write(trace_path)) {
+      cerr << "Cannot write " << trace_path << endl;
+    }
+    if (results.failed() > 0) {
+      auto report = shard.file(target_directory, "failures.tsv");
+      if (results.write_failures(report)) {
+        cerr << "Failures written to " << report.string() << endl;
+      }
+      for (const auto& r : results.failures()) {
+        cerr << "FAILED " << r.source.string() << ": " << to_string(r.status)
+             << " " << r.message << endl;
+      }
+      GDALDestroyDriverManager();
+      return 1;
+    }
   }
 
   GDALDestroyDriverManager();
@@ -0,0 +1,128 @@
+
+#ifndef CONCURRENT__NUMA_ALLOC_HPP_
+#define CONCURRENT__NUMA_ALLOC_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef TLGML_HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+namespace concurrent {
+
+/**
+ * @brief Pin the calling thread to the index-th CPU of the process affinity
+ * mask (wrapping around). Returns false when pinning is not supported.
+ */
+inline bool pin_current_thread(std::uint32_t index) {
+#if defined(__linux__)
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return false;
+  std::vector<int> cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+  }
+  if (cpus.empty()) return false;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpus[index % cpus.size()], &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+  DWORD_PTR process_mask = 0, system_mask = 0;
+  if (!GetProcessAffinityMask(GetCurrentProcess(), &process_mask,
+                              &system_mask)) {
+    return false;
+  }
+  std::vector<DWORD_PTR> cpus;
+  for (std::uint32_t cpu = 0; cpu < sizeof(DWORD_PTR) * 8; ++cpu) {
+    DWORD_PTR bit = static_cast<DWORD_PTR>(1) << cpu;
+    if (process_mask & bit) cpus.push_back(bit);
+  }
+  if (cpus.empty()) return false;
+  return SetThreadAffinityMask(GetCurrentThread(),
+                               cpus[index % cpus.size()]) != 0;
+#else
+  (void)index;
+  return false;
+#endif
+}
+
+/**
+ * @brief Allocator which places large buffers on the NUMA node of the calling
+ * thread.
+ *
+ * With libnuma the pages are explicitly bound to the local node. Without it we
+ * rely on first-touch: a fresh allocation is placed on the node of the thread
+ * that first writes it, which is the pinned worker as long as the buffer is
+ * allocated and filled inside the task.
+ */
+template <typename T>
+class NumaAllocator {
+ public:
+  using value_type = T;
+
+  /// Smaller requests come from the regular heap; binding whole pages for
+  /// them costs more than it saves.
+  static constexpr std::size_t local_threshold = 64 * 1024;
+
+  NumaAllocator() noexcept = default;
+  template <typename U>
+  NumaAllocator(const NumaAllocator<U>&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    const std::size_t bytes = n * sizeof(T);
+#ifdef TLGML_HAVE_LIBNUMA
+    if (bytes >= local_threshold && numa_available() >= 0) {
+      void* p = numa_alloc_local(bytes);
+      if (!p) throw std::bad_alloc();
+      return static_cast<T*>(p);
+    }
+#endif
+    return static_cast<T*>(::operator new(bytes));
+  }
+
+  void deallocate(T* p, std::size_t n) noexcept {
+#ifdef TLGML_HAVE_LIBNUMA
+    const std::size_t bytes = n * sizeof(T);
+    if (bytes >= local_threshold && numa_available() >= 0) {
+      numa_free(p, bytes);
+      return;
+    }
+#else
+    (void)n;
+#endif
+    ::operator delete(p);
+  }
+
+  template <typename U>
+  bool operator==(const NumaAllocator<U>&) const noexcept {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const NumaAllocator<U>&) const noexcept {
+    return false;
+  }
+};
+
+template <typename T>
+using local_vector = std::vector<T, NumaAllocator<T>>;
+
+}  // namespace concurrent
+
+#endif
@@ -0,0 +1,352 @@
+// Python extension "tlgml": JPGIS (GML) DEMs decoded straight into NumPy.
+//
+//   import tlgml
+//   dem, header = tlgml.read("FG-GML-5339-45-00-DEM5A-20161001.xml")
+//   header = tlgml.probe(open(path, "rb").read())
+//   for r in tlgml.read_many(paths, threads=8, return_exceptions=True): ...
+//
+// Arrays are float32 (rows, cols), north up, TLGML_NODATA where the file has
+// no tuple. They own the buffer the decoder wrote, so nothing is copied. The
+// GIL is released while files are read, parsed and decoded.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "threadpool.h"
+#include "tlgml.h"
+
+namespace {
+
+PyObject* gml_error = nullptr;
+
+/// Releases the GIL for its lifetime; restored before any exception leaves.
+class GilRelease {
+ public:
+  GilRelease() : state(PyEval_SaveThread()) {}
+  ~GilRelease() { PyEval_RestoreThread(state); }
+  GilRelease(const GilRelease&) = delete;
+  GilRelease& operator=(const GilRelease&) = delete;
+
+ private:
+  PyThreadState* state;
+};
+
+/// Outcome of reading one source, filled without the GIL.
+struct Decoded {
+  tlgml_status status = TLGML_OK;
+  std::string message;
+  tlgml_grid grid{};
+};
+
+/// The exception a failed status raises: OSError for I/O, MemoryError for
+/// an input too large to allocate, tlgml.GmlError (a ValueError) for a
+/// broken document.
+PyObject* make_error(const Decoded& d, const std::string& source) {
+  const auto message = source + ": " + d.message;
+  if (d.status == TLGML_OPEN_FAILED) {
+    return PyObject_CallFunction(PyExc_OSError, "s", message.c_str());
+  }
+  if (d.status == TLGML_TOO_LARGE) {
+    return PyObject_CallFunction(PyExc_MemoryError, "s", message.c_str());
+  }
+  return PyObject_CallFunction(gml_error, "s", message.c_str());
+}
+
+void set_error(const Decoded& d, const std::string& source) {
+  PyObject* error = make_error(d, source);
+  if (!error) return;
+  PyErr_SetObject(reinterpret_cast<PyObject*>(Py_TYPE(error)), error);
+  Py_DECREF(error);
+}
+
+PyObject* header_dict(const tlgml_header& h) {
+  return Py_BuildValue(
+      "{s:I,s:I,s:d,s:d,s:d,s:d,s:(dddddd)}", "cols", h.cols, "rows", h.rows,
+      "lower_lat", h.lower_lat, "lower_lon", h.lower_lon, "upper_lat",
+      h.upper_lat, "upper_lon", h.upper_lon, "geotransform",
+      h.geotransform[0], h.geotransform[1], h.geotransform[2],
+      h.geotransform[3], h.geotransform[4], h.geotransform[5]);
+}
+
+void free_cells(PyObject* capsule) {
+  tlgml_grid grid{};
+  grid.cells = static_cast<float*>(PyCapsule_GetPointer(capsule, nullptr));
+  tlgml_grid_free(&grid);
+}
+
+/// (array, header) taking ownership of d.grid.cells.
+PyObject* to_result(Decoded& d) {
+  npy_intp dims[2] = {static_cast<npy_intp>(d.grid.header.rows),
+                      static_cast<npy_intp>(d.grid.header.cols)};
+  PyObject* capsule = PyCapsule_New(d.grid.cells, nullptr, free_cells);
+  if (!capsule) {
+    tlgml_grid_free(&d.grid);
+    return nullptr;
+  }
+  d.grid.cells = nullptr;
+  PyObject* array = PyArray_SimpleNewFromData(
+      2, dims, NPY_FLOAT32, PyCapsule_GetPointer(capsule, nullptr));
+  if (!array) {
+    Py_DECREF(capsule);
+    return nullptr;
+  }
+  // Steals the capsule reference even on failure.
+  if (PyArray_SetBaseObject(reinterpret_cast<PyArrayObject*>(array),
+                            capsule) < 0) {
+    Py_DECREF(array);
+    return nullptr;
+  }
+  PyObject* header = header_dict(d.grid.header);
+  if (!header) {
+    Py_DECREF(array);
+    return nullptr;
+  }
+  return Py_BuildValue("(NN)", array, header);
+}
+
+/**
+ * @brief A str / os.PathLike names a file (or "a.zip/b.xml" member); any
+ * other buffer is the document itself.
+ */
+class Source {
+ public:
+  Source() = default;
+  Source(const Source&) = delete;
+  Source& operator=(const Source&) = delete;
+  ~Source() {
+    if (view.obj) PyBuffer_Release(&view);
+  }
+
+  bool set(PyObject* obj) {
+    if (PyUnicode_Check(obj) || PyObject_HasAttrString(obj, "__fspath__")) {
+      PyObject* fspath = PyOS_FSPath(obj);
+      if (!fspath) return false;
+      // Paths go to the library as UTF-8; bytes paths are taken as is.
+      const char* utf8 = PyUnicode_Check(fspath)
+                             ? PyUnicode_AsUTF8(fspath)
+                             : PyBytes_AsString(fspath);
+      if (utf8) path = utf8;
+      Py_DECREF(fspath);
+      return utf8 != nullptr;
+    }
+    return PyObject_GetBuffer(obj, &view, PyBUF_SIMPLE) == 0;
+  }
+
+  bool is_path() const { return view.obj == nullptr; }
+
+  /// For error messages.
+  std::string name() const { return is_path() ? path : "<buffer>"; }
+
+  tlgml_status probe(tlgml_header* header) const {
+    return is_path() ? tlgml_probe_file(path.c_str(), header)
+                     : tlgml_probe_buffer(static_cast<const char*>(view.buf),
+                                          view.len, header);
+  }
+
+  tlgml_status read(tlgml_grid* grid) const {
+    return is_path()
+               ? tlgml_read_grid_file(path.c_str(), grid)
+               : tlgml_read_grid_buffer(static_cast<const char*>(view.buf),
+                                        view.len, grid);
+  }
+
+ private:
+  std::string path;
+  Py_buffer view{};
+};
+
+/// Workers shared by read_many calls; replaced when a call asks for a
+/// different size, while batches still running keep the old one alive.
+std::mutex pool_mutex;
+std::shared_ptr<concurrent::ThreadPoolExecutor> pool;
+
+std::shared_ptr<concurrent::ThreadPoolExecutor> get_pool(unsigned threads) {
+  std::lock_guard<std::mutex> lock(pool_mutex);
+  const unsigned wanted =
+      threads ? threads : std::thread::hardware_concurrency();
+  if (!pool || pool->thread_count() != wanted) {
+    pool = std::make_shared<concurrent::ThreadPoolExecutor>(wanted);
+  }
+  return pool;
+}
+
+template <class F>
+PyObject* guarded(F&& f) {
+  try {
+    return f();
+  } catch (const std::bad_alloc&) {
+    return PyErr_NoMemory();
+  } catch (const std::exception& e) {
+    PyErr_SetString(PyExc_RuntimeError, e.what());
+    return nullptr;
+  }
+}
+
+PyObject* probe(PyObject*, PyObject* arg) {
+  return guarded([&]() -> PyObject* {
+    Source source;
+    if (!source.set(arg)) return nullptr;
+    Decoded d;
+    tlgml_header header;
+    {
+      GilRelease nogil;
+      d.status = source.probe(&header);
+      if (d.status != TLGML_OK) d.message = tlgml_last_error();
+    }
+    if (d.status != TLGML_OK) {
+      set_error(d, source.name());
+      return nullptr;
+    }
+    return header_dict(header);
+  });
+}
+
+PyObject* read(PyObject*, PyObject* arg) {
+  return guarded([&]() -> PyObject* {
+    Source source;
+    if (!source.set(arg)) return nullptr;
+    Decoded d;
+    {
+      GilRelease nogil;
+      d.status = source.read(&d.grid);
+      if (d.status != TLGML_OK) d.message = tlgml_last_error();
+    }
+    if (d.status != TLGML_OK) {
+      set_error(d, source.name());
+      return nullptr;
+    }
+    return to_result(d);
+  });
+}
+
+PyObject* read_many(PyObject*, PyObject* args, PyObject* kwargs) {
+  static const char* keywords[] = {"sources", "threads", "return_exceptions",
+                                   nullptr};
+  PyObject* sources_obj = nullptr;
+  unsigned threads = 0;
+  int return_exceptions = 0;
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|Ip:read_many",
+                                   const_cast<char**>(keywords), &sources_obj,
+                                   &threads, &return_exceptions)) {
+    return nullptr;
+  }
+  return guarded([&]() -> PyObject* {
+    PyObject* seq = PySequence_Fast(sources_obj, "sources must be iterable");
+    if (!seq) return nullptr;
+    const Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    std::vector<Source> sources(n);
+    for (Py_ssize_t i = 0; i < n; i++) {
+      if (!sources[i].set(PySequence_Fast_GET_ITEM(seq, i))) {
+        Py_DECREF(seq);
+        return nullptr;
+      }
+    }
+    Py_DECREF(seq);
+
+    std::vector<Decoded> decoded(n);
+    {
+      GilRelease nogil;
+      auto executor = get_pool(threads);
+      std::vector<std::future<void>> done;
+      done.reserve(n);
+      try {
+        for (Py_ssize_t i = 0; i < n; i++) {
+          done.push_back(executor->submit([&source = sources[i],
+                                           &d = decoded[i]] {
+            d.status = source.read(&d.grid);
+            if (d.status != TLGML_OK) d.message = tlgml_last_error();
+          }));
+        }
+      } catch (...) {
+        // Queued tasks write into sources and decoded; let them finish.
+        for (auto& f : done) f.wait();
+        for (auto& d : decoded) tlgml_grid_free(&d.grid);
+        throw;
+      }
+      for (auto& f : done) f.wait();
+    }
+
+    PyObject* list = PyList_New(n);
+    if (!list) return nullptr;
+    for (Py_ssize_t i = 0; i < n; i++) {
+      auto& d = decoded[i];
+      PyObject* item = nullptr;
+      if (d.status == TLGML_OK) {
+        item = to_result(d);
+      } else if (return_exceptions) {
+        item = make_error(d, sources[i].name());
+      } else {
+        set_error(d, sources[i].name());
+      }
+      if (!item) {
+        for (auto& rest : decoded) tlgml_grid_free(&rest.grid);
+        Py_DECREF(list);
+        return nullptr;
+      }
+      PyList_SET_ITEM(list, i, item);
+    }
+    return list;
+  });
+}
+
+PyMethodDef methods[] = {
+    {"probe", probe, METH_O,
+     "probe(source) -> dict\n\n"
+     "Envelope, grid size and GDAL geotransform of a DEM. source is a path\n"
+     "(str or os.PathLike, also 'a.zip/b.xml') or the document's bytes."},
+    {"read", read, METH_O,
+     "read(source) -> (numpy.ndarray, dict)\n\n"
+     "Decode a DEM into a float32 (rows, cols) array and its header.\n"
+     "Raises OSError when the file cannot be read, MemoryError when it is\n"
+     "too large to decode and tlgml.GmlError when it is not a valid DEM."},
+    {"read_many", reinterpret_cast<PyCFunction>(read_many),
+     METH_VARARGS | METH_KEYWORDS,
+     "read_many(sources, threads=0, return_exceptions=False) -> list\n\n"
+     "read() for every source, in parallel on a native thread pool\n"
+     "(threads=0: one per core). Results are in the order of sources. With\n"
+     "return_exceptions, a failed source gives its exception instead of\n"
+     "raising the first one."},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyModuleDef module = {PyModuleDef_HEAD_INIT, "tlgml",
+                      "JPGIS (GML) DEM decoding into NumPy arrays.", -1,
+                      methods};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit_tlgml(void) {
+  import_array();
+  PyObject* m = PyModule_Create(&module);
+  if (!m) return nullptr;
+  gml_error = PyErr_NewExceptionWithDoc(
+      "tlgml.GmlError", "The source is not a well-formed JPGIS DEM.",
+      PyExc_ValueError, nullptr);
+  if (!gml_error) {
+    Py_DECREF(m);
+    return nullptr;
+  }
+  // One reference for raising, one for the module attribute (stolen).
+  Py_INCREF(gml_error);
+  if (PyModule_AddObject(m, "GmlError", gml_error) < 0) {
+    Py_DECREF(gml_error);
+    Py_DECREF(m);
+    return nullptr;
+  }
+  PyObject* nodata = PyFloat_FromDouble(TLGML_NODATA);
+  if (!nodata || PyModule_AddObject(m, "NODATA", nodata) < 0 ||
+      PyModule_AddIntConstant(m, "API_VERSION", tlgml_api_version()) < 0) {
+    Py_XDECREF(nodata);
+    Py_DECREF(m);
+    return nullptr;
+  }
+  return m;
+}
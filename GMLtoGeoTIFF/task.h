@@ -0,0 +1,156 @@
+
+#ifndef CONCURRENT__TASK_HPP_
+#define CONCURRENT__TASK_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace concurrent {
+
+/**
+ * @brief Move-only, type-erased `void()` callable with small buffer
+ * optimization.
+ *
+ * Callables up to inline_size bytes which are nothrow move constructible are
+ * stored in place, so queueing them does not touch the heap. Larger ones are
+ * moved into a single heap allocation.
+ */
+class Task {
+ public:
+  static constexpr std::size_t inline_size = 6 * sizeof(void*);
+
+  Task() noexcept = default;
+
+  template <typename F, typename D = std::decay_t<F>,
+            typename = std::enable_if_t<!std::is_same<D, Task>::value>>
+  Task(F&& func) {
+    if constexpr (fits_inline<D>()) {
+      ::new (static_cast<void*>(&storage_)) D(std::forward<F>(func));
+      vtable_ = &inline_vtable<D>;
+    } else {
+      ::new (static_cast<void*>(&storage_)) D*(new D(std::forward<F>(func)));
+      vtable_ = &heap_vtable<D>;
+    }
+  }
+
+  Task(Task&& other) noexcept : vtable_(other.vtable_) {
+    if (vtable_) {
+      vtable_->move(&storage_, &other.storage_);
+      other.vtable_ = nullptr;
+    }
+  }
+
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      reset();
+      if (other.vtable_) {
+        other.vtable_->move(&storage_, &other.storage_);
+        vtable_ = other.vtable_;
+        other.vtable_ = nullptr;
+      }
+    }
+    return *this;
+  }
+
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  ~Task() { reset(); }
+
+  explicit operator bool() const noexcept { return vtable_ != nullptr; }
+
+  void operator()() { vtable_->invoke(&storage_); }
+
+  void reset() noexcept {
+    if (vtable_) {
+      vtable_->destroy(&storage_);
+      vtable_ = nullptr;
+    }
+  }
+
+ private:
+  using Storage =
+      std::aligned_storage_t<inline_size, alignof(std::max_align_t)>;
+
+  struct VTable {
+    void (*invoke)(void*);
+    void (*move)(void* dst, void* src) noexcept;
+    void (*destroy)(void*) noexcept;
+  };
+
+  template <typename D>
+  static constexpr bool fits_inline() {
+    return sizeof(D) <= inline_size &&
+           alignof(D) <= alignof(std::max_align_t) &&
+           std::is_nothrow_move_constructible<D>::value;
+  }
+
+  template <typename D>
+  static constexpr VTable inline_vtable{
+      [](void* p) { (*static_cast<D*>(p))(); },
+      [](void* dst, void* src) noexcept {
+        ::new (dst) D(std::move(*static_cast<D*>(src)));
+        static_cast<D*>(src)->~D();
+      },
+      [](void* p) noexcept { static_cast<D*>(p)->~D(); }};
+
+  template <typename D>
+  static constexpr VTable heap_vtable{
+      [](void* p) { (**static_cast<D**>(p))(); },
+      [](void* dst, void* src) noexcept {
+        ::new (dst) D*(*static_cast<D**>(src));
+      },
+      [](void* p) noexcept { delete *static_cast<D**>(p); }};
+
+  Storage storage_;
+  const VTable* vtable_ = nullptr;
+};
+
+/**
+ * @brief FIFO of tasks on a growable ring buffer.
+ *
+ * Unlike std::deque, popped slots are reused, so a queue that has reached its
+ * working size stops allocating.
+ */
+class TaskQueue {
+ public:
+  bool empty() const noexcept { return size_ == 0; }
+  std::size_t size() const noexcept { return size_; }
+
+  void push(Task&& task) {
+    if (size_ == capacity_) grow();
+    slots_[(head_ + size_) & (capacity_ - 1)] = std::move(task);
+    ++size_;
+  }
+
+  Task pop() {
+    Task task = std::move(slots_[head_]);
+    head_ = (head_ + 1) & (capacity_ - 1);
+    --size_;
+    return task;
+  }
+
+ private:
+  void grow() {
+    std::size_t capacity = capacity_ ? capacity_ * 2 : 64;
+    std::unique_ptr<Task[]> slots(new Task[capacity]);
+    for (std::size_t i = 0; i < size_; ++i) {
+      slots[i] = std::move(slots_[(head_ + i) & (capacity_ - 1)]);
+    }
+    slots_ = std::move(slots);
+    capacity_ = capacity;
+    head_ = 0;
+  }
+
+  std::unique_ptr<Task[]> slots_;
+  std::size_t capacity_ = 0;
+  std::size_t head_ = 0;
+  std::size_t size_ = 0;
+};
+
+}  // namespace concurrent
+
+#endif
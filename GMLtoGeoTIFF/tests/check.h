@@ -0,0 +1,56 @@
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+/**
+ * @file check.h
+ * @brief The assertions of the unit tests. A failed CHECK is reported with
+ * its location and the test goes on; main() returns test::result(), which
+ * ctest sees as the exit code.
+ */
+
+#include <iostream>
+
+namespace gistool {
+namespace test {
+
+inline int& failures() {
+  static int count = 0;
+  return count;
+}
+
+inline bool check(bool ok, const char* expression, const char* file,
+                  int line) {
+  if (!ok) {
+    ++failures();
+    std::cerr << file << ":" << line << ": CHECK(" << expression
+              << ") failed" << std::endl;
+  }
+  return ok;
+}
+
+template <typename A, typename B>
+bool check_eq(const A& a, const B& b, const char* expression, const char* file,
+              int line) {
+  if (a == b) return true;
+  ++failures();
+  std::cerr << file << ":" << line << ": CHECK_EQ(" << expression << ") failed: "
+            << a << " != " << b << std::endl;
+  return false;
+}
+
+inline int result() {
+  if (failures() == 0) return 0;
+  std::cerr << failures() << " check(s) failed" << std::endl;
+  return 1;
+}
+
+}  // namespace test
+}  // namespace gistool
+
+#define CHECK(expression)                                                  \
+  ::gistool::test::check(static_cast<bool>(expression), #expression, __FILE__, \
+                         __LINE__)
+#define CHECK_EQ(a, b) \
+  ::gistool::test::check_eq((a), (b), #a ", " #b, __FILE__, __LINE__)
+
+#endif  // !TESTS_CHECK_H
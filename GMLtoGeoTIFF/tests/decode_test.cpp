@@ -0,0 +1,168 @@
+// decode_tuple_list against the stringstream/std::stof decoder it replaced:
+// every valid tupleList must decode to the same bits, so recorded golden
+// outputs stay valid. Malformed values must be reported, not thrown.
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "DemGenerator.h"
+#include "GmlDoc.h"
+#include "check.h"
+
+using namespace gistool;
+
+namespace {
+
+const std::string surface = "\xe5\x9c\xb0\xe8\xa1\xa8\xe9\x9d\xa2";  // 地表面
+
+/// The decoder before in-place strtof parsing (start was not supported).
+void reference_decode(const char* text, std::uint32_t cols, std::uint32_t rows,
+                      float* dst) {
+  std::stringstream ss{std::string(text)};
+  std::string buf;
+  std::getline(ss, buf);
+  for (std::uint32_t row = 0; row < rows; row++) {
+    for (std::uint32_t col = 0; col < cols; col++, dst++) {
+      if (std::getline(ss, buf)) {
+        std::stringstream splited(buf);
+        std::string h_buf("");
+        for (std::size_t i = 0; i < 2; i++) {
+          std::getline(splited, h_buf, ',');
+          if (i == 1) *dst = std::stof(h_buf);
+        }
+      } else {
+        *dst = -9999.f;
+      }
+    }
+  }
+}
+
+bool same_bits(const std::vector<float>& a, const std::vector<float>& b) {
+  return a.size() == b.size() &&
+         std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+/// Both decoders on one tupleList, compared bit for bit.
+void compare(const std::string& text, std::uint32_t cols, std::uint32_t rows) {
+  const std::size_t cells = static_cast<std::size_t>(cols) * rows;
+  std::vector<float> expected(cells), actual(cells);
+  reference_decode(text.c_str(), cols, rows, expected.data());
+  std::string error;
+  if (!CHECK(decode_tuple_list(text.c_str(), cols, rows, 0, actual.data(),
+                               error))) {
+    std::cerr << "  " << error << std::endl;
+    return;
+  }
+  if (!CHECK(same_bits(expected, actual))) {
+    for (std::size_t i = 0; i < cells; ++i) {
+      if (std::memcmp(&expected[i], &actual[i], sizeof(float)) != 0) {
+        std::cerr << "  cell " << i << ": " << expected[i]
+                  << " != " << actual[i] << std::endl;
+        break;
+      }
+    }
+  }
+}
+
+/// The text of the tupleList element, as rapidxml hands it to the decoder.
+std::string tuple_list(const std::string& xml) {
+  const std::string open = "<gml:tupleList>";
+  const auto begin = xml.find(open) + open.size();
+  return xml.substr(begin, xml.find("</gml:tupleList>") - begin);
+}
+
+void generated_dems() {
+  const bench::DemSpec shapes[] = {
+      {225, 150, 0.0}, {225, 150, 0.3}, {1125, 750, 0.05}, {1, 1, 0.0},
+      {45, 30, 1.0},   {3, 200, 0.0},
+  };
+  std::uint64_t seed = 1;
+  for (auto spec : shapes) {
+    spec.seed = seed++;
+    compare(tuple_list(bench::generate_dem(spec)), spec.cols, spec.rows);
+  }
+}
+
+void number_forms() {
+  // Spellings that appear in GSI files or that strtof and stof could treat
+  // differently at the edges of a line.
+  const char* values[] = {
+      "-9999.", "0",      "-0.00",   "12.",      ".5",       "+4.25",
+      "1e2",    "1.5E-3", "3776.24", "-28.06",   " 7.5",     "7.5 ",
+      "7.5\r",  "7.5,x",  "0x1p3",   "1e-30",    "3.4e38",   "123456789",
+      "0.1",    "16.3",   "-0.005",  "99999.99", "2.675",    "1.00000001",
+  };
+  std::string text = "\n";
+  for (const char* v : values) text += surface + "," + v + "\n";
+  compare(text, 4, 6);
+  compare(text, 5, 6);  // short list: the rest is -9999
+
+  // Random values in every printf form tlgml could meet.
+  std::mt19937_64 rng(48);
+  std::uniform_real_distribution<double> height(-500.0, 4000.0);
+  std::uniform_int_distribution<int> form(0, 4);
+  const char* formats[] = {"%.2f", "%.1f", "%g", "%.9g", "%.6e"};
+  text = "<gml:tupleList>\n";
+  char value[64];
+  for (int i = 0; i < 40000; ++i) {
+    std::snprintf(value, sizeof(value), formats[form(rng)], height(rng));
+    text += surface + "," + value + (i % 7 == 0 ? "\r\n" : "\n");
+  }
+  compare(text, 200, 200);
+}
+
+void start_point() {
+  std::string text = "\n";
+  for (int i = 0; i < 10; ++i) text += surface + "," + std::to_string(i) + "\n";
+  std::vector<float> cells(4 * 5, 1.f);
+  std::string error;
+  CHECK(decode_tuple_list(text.c_str(), 4, 5, 7, cells.data(), error));
+  for (std::size_t i = 0; i < cells.size(); ++i) {
+    const float expected =
+        i < 7 || i >= 17 ? -9999.f : static_cast<float>(i - 7);
+    CHECK_EQ(cells[i], expected);
+  }
+  // A start past the grid leaves nothing to decode.
+  CHECK(decode_tuple_list(text.c_str(), 4, 5, 99, cells.data(), error));
+  for (float v : cells) CHECK_EQ(v, -9999.f);
+}
+
+void malformed() {
+  const std::pair<const char*, const char*> cases[] = {
+      {"a,1\nb,\n", "tuple 2 (row 1, col 2)"},
+      {"a,1\nb,x\n", "tuple 2 (row 1, col 2)"},
+      {"a,1\nb,2\nno comma\n", "tuple 3 (row 2, col 1)"},
+      {"a,1.5x\n", "tuple 1 (row 1, col 1)"},
+      {"a,\nb,7\n", "tuple 1 (row 1, col 1)"},
+      // Out of float range: std::stof threw, a cell must not become inf.
+      {"a,1\nb,3.4e39\n", "tuple 2 (row 1, col 2)"},
+      {"a,-1e300\n", "tuple 1 (row 1, col 1)"},
+      {"a,inf\n", "tuple 1 (row 1, col 1)"},
+      {"a,1\nb,2\nc,nan\n", "tuple 3 (row 2, col 1)"},
+  };
+  for (const auto& [body, where] : cases) {
+    const std::string text = std::string("\n") + body;
+    std::vector<float> cells(2 * 2);
+    std::string error;
+    if (CHECK(!decode_tuple_list(text.c_str(), 2, 2, 0, cells.data(),
+                                 error))) {
+      if (!CHECK(error.find(where) != std::string::npos)) {
+        std::cerr << "  " << error << std::endl;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int main() {
+  generated_dems();
+  number_forms();
+  start_point();
+  malformed();
+  return gistool::test::result();
+}
@@ -0,0 +1,22 @@
+// Golden outputs: converts every fixture in bench/golden.tsv through GDAL as
+// tlgml does and compares with the recorded fingerprints, like
+// tlgml_bench --verify. Usage: tlgml_test_golden <golden.tsv>
+
+#include <gdal_priv.h>
+
+#include <iostream>
+
+#include "Golden.h"
+
+int main(int argc, char* argv[]) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <golden.tsv>" << std::endl;
+    return 2;
+  }
+  GDALAllRegister();
+  CPLPushErrorHandler(CPLQuietErrorHandler);
+  // Two workers, so conversions also run concurrently under sanitizers.
+  const int failed = gistool::bench::run_golden(argv[1], false, 2);
+  GDALDestroyDriverManager();
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+// cppglob::iglob over a temporary tree: the matches, their agreement with
+// glob(), and the input iterator interface.
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <cppglob/glob.hpp>
+#include <cppglob/iglob.hpp>
+
+#include "check.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+class TempTree {
+ public:
+  TempTree() {
+    const auto stamp = std::chrono::steady_clock::now().time_since_epoch();
+    root = fs::temp_directory_path() /
+           ("tlgml_iglob_test_" + std::to_string(stamp.count()));
+    fs::remove_all(root);
+    for (const char* file :
+         {"a.xml", "b.xml", ".hidden.xml", "c.txt", "sub/d.xml",
+          "sub/deep/e.xml", "sub/.dot/f.xml", "other/g.xml", "other/h.XML"}) {
+      const auto path = root / fs::path(file).make_preferred();
+      fs::create_directories(path.parent_path());
+      std::ofstream(path) << file;
+    }
+  }
+  ~TempTree() {
+    std::error_code ec;
+    fs::remove_all(root, ec);
+  }
+
+  fs::path root;
+};
+
+/// Matches relative to root, '/' separated and sorted.
+std::vector<std::string> relative(std::vector<fs::path> paths,
+                                  const fs::path& root) {
+  std::vector<std::string> ret;
+  for (const auto& p : paths) {
+    ret.push_back(p.lexically_relative(root).generic_string());
+  }
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+std::vector<fs::path> collect(const fs::path& pattern, bool recursive) {
+  std::vector<fs::path> ret;
+  for (auto it = cppglob::iglob(pattern, recursive); it != cppglob::iglob();
+       ++it) {
+    ret.push_back(*it);
+  }
+  return ret;
+}
+
+void expect(const TempTree& tree, const std::string& pattern, bool recursive,
+            std::vector<std::string> expected) {
+  const auto full = tree.root / fs::path(pattern).make_preferred();
+  std::sort(expected.begin(), expected.end());
+  const auto lazy = relative(collect(full, recursive), tree.root);
+  const auto eager = relative(cppglob::glob(full, recursive), tree.root);
+  if (!CHECK(lazy == expected) || !CHECK(eager == lazy)) {
+    std::cerr << "  pattern " << pattern << ": iglob";
+    for (const auto& p : lazy) std::cerr << " " << p;
+    std::cerr << "; glob";
+    for (const auto& p : eager) std::cerr << " " << p;
+    std::cerr << std::endl;
+  }
+}
+
+void matches(const TempTree& tree) {
+  expect(tree, "*.xml", false, {"a.xml", "b.xml"});
+  expect(tree, "?.xml", false, {"a.xml", "b.xml"});
+  expect(tree, "[!a].*", false, {"b.xml", "c.txt"});
+  expect(tree, ".*.xml", false, {".hidden.xml"});
+  expect(tree, "*/*.xml", false, {"other/g.xml", "sub/d.xml"});
+  expect(tree, "sub/*/*.xml", false, {"sub/deep/e.xml"});
+  expect(tree, "*/*.[xX][mM][lL]", false,
+         {"other/g.xml", "other/h.XML", "sub/d.xml"});
+  // Without magic the path itself is the only candidate.
+  expect(tree, "sub/d.xml", false, {"sub/d.xml"});
+  expect(tree, "sub/z.xml", false, {});
+  expect(tree, "missing/*.xml", false, {});
+  // '**' spans zero or more directories, hidden ones excluded.
+  expect(tree, "**/*.xml", true,
+         {"a.xml", "b.xml", "other/g.xml", "sub/d.xml", "sub/deep/e.xml"});
+  expect(tree, "sub/**/*.xml", true, {"sub/d.xml", "sub/deep/e.xml"});
+  // Not recursive, '**' is just '*'.
+  expect(tree, "**/*.xml", false, {"other/g.xml", "sub/d.xml"});
+}
+
+void iterator_interface(const TempTree& tree) {
+  const auto pattern = tree.root / "*.xml";
+  CHECK(cppglob::iglob() == cppglob::iglob());
+
+  auto it = cppglob::iglob(pattern, false);
+  CHECK(it != cppglob::iglob());
+  const fs::path first = *it;
+  CHECK(it->filename() == first.filename());
+
+  // Copies share the walk.
+  auto copy = it;
+  ++copy;
+  CHECK(it != cppglob::iglob());
+  CHECK(*it != first);
+  CHECK(*it == *copy);
+
+  // it++ still refers to the match it was on.
+  it = cppglob::iglob(pattern, false);
+  const fs::path a = *it;
+  auto previous = it++;
+  CHECK(*previous == a);
+  CHECK(it != cppglob::iglob());
+  CHECK(*it != a);
+  ++it;
+  CHECK(it == cppglob::iglob());
+}
+
+}  // namespace
+
+int main() {
+  TempTree tree;
+  matches(tree);
+  iterator_interface(tree);
+  return gistool::test::result();
+}
@@ -0,0 +1,117 @@
+// --inputs-from records: newline and NUL separators, the optional size
+// column, and what is taken literally as part of a path.
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "InputList.h"
+#include "check.h"
+
+using namespace gistool;
+
+namespace {
+
+std::vector<SourceFile> read_all(const std::string& text,
+                                 std::size_t* records = nullptr) {
+  std::istringstream in(text);
+  InputList list(in);
+  std::vector<SourceFile> sources;
+  SourceFile source;
+  while (list.next(source)) sources.push_back(source);
+  if (records) *records = list.records();
+  return sources;
+}
+
+std::vector<std::string> paths(const std::vector<SourceFile>& sources) {
+  std::vector<std::string> ret;
+  for (const auto& s : sources) ret.push_back(s.path.u8string());
+  return ret;
+}
+
+void newline_records() {
+  std::size_t records = 0;
+  auto sources = read_all("a.xml\r\n\nb dir/b.xml\n\r\n c.xml \nlast.xml",
+                          &records);
+  CHECK(paths(sources) ==
+        std::vector<std::string>({"a.xml", "b dir/b.xml", " c.xml ",
+                                  "last.xml"}));
+  CHECK_EQ(records, 6u);
+  CHECK(read_all("").empty());
+  CHECK(read_all("\n\n\r\n").empty());
+}
+
+void nul_records() {
+  // The first separator decides; after a NUL, newlines belong to the path.
+  auto sources = read_all(std::string("a.xml\0line\nbreak.xml\0\0tail\r", 27));
+  CHECK(paths(sources) ==
+        std::vector<std::string>({"a.xml", "line\nbreak.xml", "tail\r"}));
+
+  // After a newline, NUL is an ordinary byte of the record.
+  sources = read_all(std::string("a.xml\nb\0c.xml\n", 14));
+  if (CHECK_EQ(sources.size(), 2u)) {
+    CHECK_EQ(sources[1].path.string().size(), 7u);
+  }
+}
+
+void sizes() {
+  auto sources = read_all(
+      "FG-GML-5339-45-00-DEM5A-20161001.xml\t1234\n"
+      "tab\tname.xml\t0\n"
+      "big.xml\t9999999999999999999\n"
+      "\xe5\x9c\xb0\xe5\x9b\xb3.xml\t7\r\n");
+  if (CHECK_EQ(sources.size(), 4u)) {
+    CHECK(sources[0].path == "FG-GML-5339-45-00-DEM5A-20161001.xml");
+    CHECK_EQ(sources[0].size, 1234u);
+    CHECK(sources[1].path == "tab\tname.xml");
+    CHECK_EQ(sources[1].size, 0u);
+    CHECK_EQ(sources[2].size, 9999999999999999999u);
+    CHECK(sources[3].path.u8string() == "\xe5\x9c\xb0\xe5\x9b\xb3.xml");
+    CHECK_EQ(sources[3].size, 7u);
+    // Not stat'ed: the manifest compares hashes.
+    for (const auto& s : sources) CHECK_EQ(s.mtime, 0);
+  }
+
+  // Anything that is not a plain size is part of the path.
+  const std::vector<std::string> literal = {
+      "trailing.xml\t", "sign.xml\t+12", "hex.xml\t0x10", "space.xml\t 12",
+      "long.xml\t12345678901234567890", "suffix.xml\t12k"};
+  for (const auto& record : literal) {
+    sources = read_all(record + "\n");
+    if (CHECK_EQ(sources.size(), 1u)) {
+      CHECK(sources[0].path == record);
+      CHECK_EQ(sources[0].size, 0u);
+    }
+  }
+}
+
+void stat_without_size() {
+  const auto stamp = std::chrono::steady_clock::now().time_since_epoch();
+  const auto file = fs::temp_directory_path() /
+                    ("tlgml_input_list_" + std::to_string(stamp.count()));
+  std::ofstream(file, std::ios::binary) << "0123456789";
+
+  auto sources = read_all(file.u8string() + "\n" + file.u8string() + "\t3\n");
+  if (CHECK_EQ(sources.size(), 2u)) {
+    CHECK_EQ(sources[0].size, 10u);
+    CHECK(sources[0].mtime != 0);
+    CHECK_EQ(sources[1].size, 3u);
+    CHECK_EQ(sources[1].mtime, 0);
+  }
+  fs::remove(file);
+
+  sources = read_all(file.u8string() + "\n");
+  if (CHECK_EQ(sources.size(), 1u)) CHECK_EQ(sources[0].size, 0u);
+}
+
+}  // namespace
+
+int main() {
+  newline_records();
+  nul_records();
+  sizes();
+  stat_without_size();
+  return gistool::test::result();
+}
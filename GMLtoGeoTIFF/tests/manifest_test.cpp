@@ -0,0 +1,167 @@
+// Manifest and journal lines: escaping of awkward paths, rejection of broken
+// lines, and a save/load and journal replay round trip.
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Journal.h"
+#include "Manifest.h"
+#include "check.h"
+
+using namespace gistool;
+
+namespace {
+
+/// Sources and outputs a manifest must carry through unchanged.
+const std::vector<std::string>& awkward_paths() {
+  static const std::vector<std::string> paths = {
+      "",
+      "FG-GML-5339-45-00-DEM5A-20161001.xml",
+      "dir/sub dir/file.xml",
+      "tab\there.xml",
+      "line\nbreak.xml",
+      "carriage\rreturn.xml",
+      "back\\slash.xml",
+      "trailing\\",
+      "\\t literally",
+      "\\\\\t\n\r\\",
+      "archive.zip!/member.xml",
+      "\xe5\x9f\xba\xe7\x9b\xa4\xe5\x9c\xb0\xe5\x9b\xb3.xml",  // UTF-8
+      "\x8a\xee\x94\xd5.xml",  // CP932 bytes, not valid UTF-8
+  };
+  return paths;
+}
+
+ManifestEntry entry_for(const std::string& source, const std::string& output) {
+  ManifestEntry e;
+  e.source = source;
+  e.output = output;
+  e.size = 589379;
+  e.mtime = -1234567890123;
+  e.hash = 0xfedcba9876543210ULL;
+  e.status = ConvertStatus::InvalidHeader;
+  return e;
+}
+
+bool same(const ManifestEntry& a, const ManifestEntry& b) {
+  return a.source == b.source && a.output == b.output && a.size == b.size &&
+         a.mtime == b.mtime && a.hash == b.hash && a.status == b.status;
+}
+
+void round_trip() {
+  for (const auto& path : awkward_paths()) {
+    const auto e = entry_for(path, path + ".tiff");
+    const auto line = format_entry(e);
+    CHECK(line.find('\n') == std::string::npos);
+    CHECK(line.find('\r') == std::string::npos);
+    CHECK_EQ(std::count(line.begin(), line.end(), '\t'), 5);
+    ManifestEntry parsed;
+    if (!CHECK(parse_entry(line, parsed)) || !CHECK(same(parsed, e))) {
+      std::cerr << "  line: " << line << std::endl;
+    }
+  }
+}
+
+void statuses() {
+  for (auto s : {ConvertStatus::Ok, ConvertStatus::OpenFailed,
+                 ConvertStatus::ParseFailed, ConvertStatus::InvalidHeader,
+                 ConvertStatus::WriteFailed, ConvertStatus::TooLarge}) {
+    auto e = entry_for("a.xml", "a.tiff");
+    e.status = s;
+    ManifestEntry parsed;
+    CHECK(parse_entry(format_entry(e), parsed));
+    CHECK(parsed.status == s);
+  }
+}
+
+void broken_lines() {
+  ManifestEntry e;
+  const char* const lines[] = {
+      "",
+      "a.xml\t1\t2\t3\ta.tiff",               // five columns
+      "a.xml\t1\t2\t3\ta.tiff\tok\textra",    // seven
+      "a\\\t1\t2\t3\ta.tiff\tok",            // trailing backslash
+      "a\\x.xml\t1\t2\t3\ta.tiff\tok",        // unknown escape
+      "a.xml\t1\t2\t3\ta.tiff\\q\tok",        // unknown escape in output
+      "a.xml\tsize\t2\t3\ta.tiff\tok",        // not a number
+      "a.xml\t1\t2\tnothex\ta.tiff\tok",      // not hex
+      "a.xml\t1\t2\t3\ta.tiff\tconverted",    // unknown status
+  };
+  for (const char* line : lines) {
+    if (!CHECK(!parse_entry(line, e))) {
+      std::cerr << "  line: " << line << std::endl;
+    }
+  }
+  CHECK(parse_entry("a.xml\t1\t2\t3\ta.tiff\tok", e));
+}
+
+fs::path temp_dir() {
+  const auto stamp = std::chrono::steady_clock::now().time_since_epoch();
+  auto dir = fs::temp_directory_path() /
+             ("tlgml_manifest_test_" + std::to_string(stamp.count()));
+  fs::create_directories(dir);
+  return dir;
+}
+
+void save_load_and_replay() {
+  const auto dir = temp_dir();
+  const auto source_root = dir / "in";
+  const auto target_root = dir / "out";
+  Manifest manifest(source_root, target_root);
+  for (const auto& path : awkward_paths()) {
+    manifest.update(entry_for(path, path + ".tiff"));
+  }
+  const auto manifest_path = dir / Manifest::file_name;
+  CHECK(manifest.save(manifest_path));
+
+  Manifest loaded(source_root, target_root);
+  CHECK(loaded.load(manifest_path));
+  CHECK_EQ(loaded.size(), manifest.size());
+  for (const auto& path : awkward_paths()) {
+    auto e = loaded.find(path);
+    if (!CHECK(e != nullptr)) continue;
+    CHECK(same(*e, entry_for(path, path + ".tiff")));
+  }
+
+  // The journal writes the same lines; replaying it updates the manifest.
+  const auto journal_path = dir / Journal::file_name;
+  {
+    Journal journal;
+    CHECK(journal.open(journal_path, false));
+    for (const auto& path : awkward_paths()) {
+      auto e = entry_for(path, path + ".tif");
+      e.status = ConvertStatus::Ok;
+      journal.append(e);
+    }
+  }
+  Manifest replayed(source_root, target_root);
+  CHECK(replayed.load(manifest_path));
+  CHECK_EQ(Journal::replay(journal_path, replayed), awkward_paths().size());
+  for (const auto& path : awkward_paths()) {
+    auto e = replayed.find(path);
+    if (!CHECK(e != nullptr)) continue;
+    CHECK_EQ(e->output, path + ".tif");
+    CHECK(e->status == ConvertStatus::Ok);
+  }
+
+  // A missing manifest is an empty one.
+  Manifest missing(source_root, target_root);
+  CHECK(missing.load(dir / "none.tsv"));
+  CHECK_EQ(missing.size(), 0u);
+
+  std::error_code ec;
+  fs::remove_all(dir, ec);
+}
+
+}  // namespace
+
+int main() {
+  round_trip();
+  statuses();
+  broken_lines();
+  save_load_and_replay();
+  return gistool::test::result();
+}
@@ -0,0 +1,144 @@
+// cppglob::matcher against the std::regex of cppglob::translate(), which it
+// replaces, and against POSIX fnmatch(3) where there is one.
+
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <cppglob/fnmatch.hpp>
+#include <cppglob/matcher.hpp>
+
+#ifndef _WIN32
+#include <fnmatch.h>
+#endif
+
+#include "check.h"
+
+namespace {
+
+using cppglob::string_type;
+
+string_type native(const std::string& s) {
+  return std::filesystem::path(s).native();
+}
+
+bool regex_match(const std::string& pattern, const std::string& name) {
+  const std::basic_regex<cppglob::char_type> regex(
+      cppglob::translate(native(pattern)));
+  return std::regex_match(native(name), regex);
+}
+
+/// Every string of up to max_length items of alphabet, shortest first.
+std::vector<std::string> strings_of(const std::vector<std::string>& alphabet,
+                                    std::size_t max_length) {
+  std::vector<std::string> ret{""};
+  std::size_t begin = 0;
+  for (std::size_t length = 1; length <= max_length; ++length) {
+    const std::size_t end = ret.size();
+    for (std::size_t i = begin; i < end; ++i) {
+      for (const auto& item : alphabet) ret.push_back(ret[i] + item);
+    }
+    begin = end;
+  }
+  return ret;
+}
+
+/// All short patterns over the supported syntax against all short names.
+void exhaustive() {
+  const auto patterns = strings_of(
+      {"a", "b", ".", "*", "?", "[ab]", "[!a]", "[a-b]", "[^a]", "[]a]"}, 3);
+  const auto names = strings_of({"a", "b", "^", "]"}, 5);
+  for (const auto& pattern : patterns) {
+    const cppglob::matcher match(native(pattern));
+    const std::basic_regex<cppglob::char_type> regex(
+        cppglob::translate(native(pattern)));
+    for (const auto& name : names) {
+      const bool got = match(native(name));
+      const bool want = std::regex_match(native(name), regex);
+      if (!CHECK(got == want)) {
+        std::cerr << "  pattern \"" << pattern << "\" name \"" << name
+                  << "\": matcher " << got << ", regex " << want << std::endl;
+        return;
+      }
+#ifndef _WIN32
+      // glibc reads "[^" as "[!"; Python's fnmatch, which cppglob follows,
+      // takes '^' literally.
+      if (pattern.find("[^") != std::string::npos) continue;
+      const bool posix = ::fnmatch(pattern.c_str(), name.c_str(), 0) == 0;
+      if (!CHECK(got == posix)) {
+        std::cerr << "  pattern \"" << pattern << "\" name \"" << name
+                  << "\": matcher " << got << ", fnmatch " << posix
+                  << std::endl;
+        return;
+      }
+#endif
+    }
+  }
+}
+
+void matches(const std::string& pattern, const std::string& name,
+             bool expected) {
+  const cppglob::matcher match(native(pattern));
+  if (!CHECK_EQ(match(native(name)), expected) ||
+      !CHECK_EQ(regex_match(pattern, name), expected)) {
+    std::cerr << "  pattern \"" << pattern << "\" name \"" << name << "\""
+              << std::endl;
+  }
+}
+
+void gsi_names() {
+  const std::string dem5a = "FG-GML-5339*-DEM5A*.xml";
+  matches(dem5a, "FG-GML-5339-45-00-DEM5A-20161001.xml", true);
+  matches(dem5a, "FG-GML-5339-45-00-DEM5B-20161001.xml", false);
+  matches(dem5a, "FG-GML-5340-45-00-DEM5A-20161001.xml", false);
+  matches(dem5a, "FG-GML-5339-45-00-DEM5A-20161001.xml.partial", false);
+  matches("FG-GML-53[34]?-*-DEM10B-*.xml",
+          "FG-GML-5349-07-77-DEM10B-20161001.xml", true);
+  matches("FG-GML-53[!34]?-*", "FG-GML-5349-07-77-DEM10B-20161001.xml", false);
+}
+
+void edge_cases() {
+  matches("", "", true);
+  matches("", "a", false);
+  matches("*", "", true);
+  matches("**", "abc", true);
+  matches("*a*a*a*", "aaa", true);
+  matches("*a*a*a*", "aa", false);
+  matches("a*b*c", "abbbcbc", true);
+  matches("a*b*c", "abbbcb", false);
+  // An unterminated set is a literal '['.
+  matches("[ab", "[ab", true);
+  matches("[ab", "a", false);
+  // ']' first in a set is a member.
+  matches("[]a]", "]", true);
+  matches("[!]a]", "b", true);
+  matches("[!]a]", "]", false);
+  // '^' is not negation in a shell pattern.
+  matches("[^a]", "^", true);
+  matches("[^a]", "b", false);
+  // Characters that are special in a regular expression are literals.
+  matches("a.b+(c)", "a.b+(c)", true);
+  matches("a.b", "axb", false);
+}
+
+/// More than 63 non-'*' characters take the std::regex fallback.
+void long_patterns() {
+  const std::string long_name(80, 'x');
+  matches(long_name, long_name, true);
+  matches(long_name + "*", long_name + "yz", true);
+  matches(std::string(70, '?'), std::string(70, 'q'), true);
+  matches(std::string(70, '?'), std::string(69, 'q'), false);
+  // 63 tokens is the last pattern the automaton holds itself.
+  matches(std::string(63, '?') + "*", std::string(63, 'q'), true);
+  matches(std::string(63, '?'), std::string(64, 'q'), false);
+}
+
+}  // namespace
+
+int main() {
+  exhaustive();
+  gsi_names();
+  edge_cases();
+  long_patterns();
+  return gistool::test::result();
+}
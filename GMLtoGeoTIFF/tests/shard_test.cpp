@@ -0,0 +1,172 @@
+// --shard: the FNV-1a hash and the resulting assignment must not change
+// between releases or platforms, or nodes running different builds would
+// convert overlapping parts. Expected values are computed independently.
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Shard.h"
+#include "check.h"
+
+using namespace gistool;
+
+namespace {
+
+void hash_values() {
+  CHECK_EQ(stable_hash(""), 0x811c9dc5u);
+  CHECK_EQ(stable_hash("a"), 0xe40c292cu);
+  CHECK_EQ(stable_hash("foobar"), 0xbf9cf968u);
+  CHECK_EQ(stable_hash("5339-45-00"), 0xd09cb19au);
+  CHECK_EQ(stable_hash("5339-45-01"), 0xd19cb32du);
+  CHECK_EQ(stable_hash("5340-00-99"), 0x57c017c1u);
+  CHECK_EQ(stable_hash("dir/x.xml"), 0x7828d7acu);
+  // Bytes, not chars: must not depend on the signedness of char.
+  CHECK_EQ(stable_hash("\xe5\x9c\xb0\xe5\x9b\xb3/a.xml"), 0xa9dc0826u);
+}
+
+void mesh_codes() {
+  CHECK_EQ(mesh_code("in/FG-GML-5339-45-00-DEM5A-20161001.xml"),
+           std::string("5339-45-00"));
+  CHECK_EQ(mesh_code("FG-GML-5339-45-DEM10B-20161001.xml"),
+           std::string("5339-45"));
+  CHECK_EQ(mesh_code("a.zip!/FG-GML-5340-00-99-DEM5B-20161001.xml"),
+           std::string("5340-00-99"));
+  CHECK_EQ(mesh_code("FG-GML-5339.xml"), std::string());
+  CHECK_EQ(mesh_code("other-5339-45-00.xml"), std::string());
+}
+
+SourceFile source(const fs::path& path, std::uint64_t size = 0) {
+  SourceFile s;
+  s.path = path;
+  s.size = size;
+  return s;
+}
+
+/// The shard every node must compute for each source, with N = 8 and 3.
+void pinned_assignment() {
+  const fs::path root = "/data/dem";
+  struct Case {
+    fs::path path;
+    std::uint32_t of8, of3;
+  };
+  const Case cases[] = {
+      {"/data/dem/FG-GML-5339-45-00-DEM5A-20161001.xml", 2, 2},
+      {"/data/dem/x/FG-GML-5339-45-00-DEM10B-20161001.xml", 2, 2},
+      {"/data/dem/FG-GML-5339-45-01-DEM5A-20161001.xml", 5, 1},
+      {"/data/dem/FG-GML-5340-00-99-DEM5A-20161001.xml", 1, 0},
+      {"/data/dem/FG-GML-5339-DEM10B-20161001.xml", 5, 2},
+      {"/data/dem/dir/x.xml", 4, 1},
+      {fs::u8path("/data/dem/\xe5\x9c\xb0\xe5\x9b\xb3/a.xml"), 6, 0},
+  };
+  for (const auto& c : cases) {
+    const std::pair<std::uint32_t, std::uint32_t> counts[] = {{8, c.of8},
+                                                              {3, c.of3}};
+    for (auto [count, expected] : counts) {
+      for (std::uint32_t i = 0; i < count; ++i) {
+        ShardSpec shard;
+        shard.index = i;
+        shard.count = count;
+        if (!CHECK_EQ(in_shard(source(c.path), shard, root), i == expected)) {
+          std::cerr << "  " << c.path << " " << i << "/" << count << std::endl;
+        }
+      }
+    }
+  }
+}
+
+std::vector<SourceFile> listing() {
+  std::vector<SourceFile> sources;
+  for (int i = 0; i < 200; ++i) {
+    const auto n = std::to_string(10 + i % 90);
+    sources.push_back(source("/data/dem/FG-GML-53" + n + "-" +
+                                 std::to_string(i % 7) + "0-0" +
+                                 std::to_string(i % 10) + "-DEM5A-20161001.xml",
+                             1000 + (i * 7919) % 5000));
+    sources.push_back(
+        source("/data/dem/misc/file" + std::to_string(i) + ".xml", i));
+  }
+  return sources;
+}
+
+void partition(bool balance_by_size) {
+  const auto sources = listing();
+  for (std::uint32_t count : {1u, 2u, 5u, 16u}) {
+    std::multiset<std::string> seen;
+    std::uint64_t largest = 0, smallest = ~std::uint64_t(0);
+    for (std::uint32_t i = 0; i < count; ++i) {
+      ShardSpec shard;
+      shard.index = i;
+      shard.count = count;
+      shard.balance_by_size = balance_by_size;
+      std::uint64_t bytes = 0;
+      for (const auto& s : select_shard(sources, shard, "/data/dem")) {
+        seen.insert(s.path.string());
+        bytes += s.size;
+      }
+      largest = std::max(largest, bytes);
+      smallest = std::min(smallest, bytes);
+    }
+    // Every source on exactly one node.
+    CHECK_EQ(seen.size(), sources.size());
+    CHECK_EQ(std::set<std::string>(seen.begin(), seen.end()).size(),
+             sources.size());
+    if (balance_by_size) CHECK(largest - smallest <= 5000);
+  }
+
+  // Independent of the listing order.
+  auto reversed = sources;
+  std::reverse(reversed.begin(), reversed.end());
+  ShardSpec shard;
+  shard.index = 3;
+  shard.count = 5;
+  shard.balance_by_size = balance_by_size;
+  std::set<std::string> a, b;
+  for (const auto& s : select_shard(sources, shard, "/data/dem")) {
+    a.insert(s.path.string());
+  }
+  for (const auto& s : select_shard(reversed, shard, "/data/dem")) {
+    b.insert(s.path.string());
+  }
+  CHECK(a == b);
+}
+
+void relative_keys() {
+  // Nodes mounting the inputs at different roots agree.
+  ShardSpec shard;
+  shard.count = 8;
+  for (shard.index = 0; shard.index < shard.count; ++shard.index) {
+    CHECK_EQ(in_shard(source("/mnt/a/dir/x.xml"), shard, "/mnt/a"),
+             in_shard(source("/data/dem/dir/x.xml"), shard, "/data/dem"));
+  }
+}
+
+void specs() {
+  ShardSpec shard;
+  CHECK(parse_shard("2/8", shard));
+  CHECK_EQ(shard.index, 2u);
+  CHECK_EQ(shard.count, 8u);
+  CHECK(shard.active());
+  CHECK(shard.file("out", "manifest.tsv") ==
+        fs::path("out") / "manifest.shard-2-of-8.tsv");
+  for (const char* bad : {"8/8", "1/0", "2", "a/8", "2/8x", "2/", "/8", ""}) {
+    CHECK(!parse_shard(bad, shard));
+  }
+  CHECK(parse_shard("0/1", shard));
+  CHECK(!shard.active());
+  CHECK(shard.file("out", "manifest.tsv") == fs::path("out") / "manifest.tsv");
+}
+
+}  // namespace
+
+int main() {
+  hash_values();
+  mesh_codes();
+  pinned_assignment();
+  partition(false);
+  partition(true);
+  relative_keys();
+  specs();
+  return gistool::test::result();
+}
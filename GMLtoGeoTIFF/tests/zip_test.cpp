@@ -0,0 +1,333 @@
+// ZipArchive central directory parsing on archives written here: stored and
+// deflated members, ZIP64 records, an archive comment, nested archives named
+// with "!/", and corrupt input.
+
+#include <zlib.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "ZipArchive.h"
+#include "check.h"
+
+using namespace gistool;
+
+namespace {
+
+struct Member {
+  std::string name;
+  std::string data;
+  bool deflate = false;
+};
+
+struct ZipOptions {
+  /// Saturate sizes, offsets and the count, and write the ZIP64 records.
+  bool zip64 = false;
+  std::string comment;
+};
+
+void put16(std::string& s, unsigned v) {
+  s += static_cast<char>(v & 0xff);
+  s += static_cast<char>((v >> 8) & 0xff);
+}
+void put32(std::string& s, std::uint32_t v) {
+  put16(s, v & 0xffff);
+  put16(s, v >> 16);
+}
+void put64(std::string& s, std::uint64_t v) {
+  put32(s, static_cast<std::uint32_t>(v));
+  put32(s, static_cast<std::uint32_t>(v >> 32));
+}
+
+std::string raw_deflate(const std::string& data) {
+  z_stream zs;
+  std::memset(&zs, 0, sizeof(zs));
+  deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+               Z_DEFAULT_STRATEGY);
+  std::string out(deflateBound(&zs, static_cast<uLong>(data.size())), '\0');
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  zs.avail_in = static_cast<uInt>(data.size());
+  zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  zs.avail_out = static_cast<uInt>(out.size());
+  deflate(&zs, Z_FINISH);
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  return out;
+}
+
+/// A ZIP as written by common tools (no data descriptors).
+std::string make_zip(const std::vector<Member>& members,
+                     const ZipOptions& options = {}) {
+  const std::uint32_t saturated = 0xFFFFFFFF;
+  std::string zip, cd;
+  for (const auto& m : members) {
+    const std::string packed = m.deflate ? raw_deflate(m.data) : m.data;
+    const auto crc = static_cast<std::uint32_t>(
+        crc32(0L, reinterpret_cast<const Bytef*>(m.data.data()),
+              static_cast<uInt>(m.data.size())));
+    const std::uint64_t offset = zip.size();
+    const unsigned method = m.deflate ? 8 : 0;
+    const unsigned version = options.zip64 ? 45 : 20;
+
+    std::string local_extra;
+    if (options.zip64) {
+      put16(local_extra, 0x0001);
+      put16(local_extra, 16);
+      put64(local_extra, m.data.size());
+      put64(local_extra, packed.size());
+    }
+    put32(zip, 0x04034b50);
+    put16(zip, version);
+    put16(zip, 0);  // flags
+    put16(zip, method);
+    put16(zip, 0x6000);  // 12:00
+    put16(zip, 0x4941);  // 2016-10-01
+    put32(zip, crc);
+    put32(zip, options.zip64 ? saturated : packed.size());
+    put32(zip, options.zip64 ? saturated : m.data.size());
+    put16(zip, static_cast<unsigned>(m.name.size()));
+    put16(zip, static_cast<unsigned>(local_extra.size()));
+    zip += m.name + local_extra + packed;
+
+    std::string extra;
+    if (options.zip64) {
+      put16(extra, 0x0001);
+      put16(extra, 24);
+      put64(extra, m.data.size());
+      put64(extra, packed.size());
+      put64(extra, offset);
+    }
+    put32(cd, 0x02014b50);
+    put16(cd, version);
+    put16(cd, version);
+    put16(cd, 0);
+    put16(cd, method);
+    put16(cd, 0x6000);
+    put16(cd, 0x4941);
+    put32(cd, crc);
+    put32(cd, options.zip64 ? saturated : packed.size());
+    put32(cd, options.zip64 ? saturated : m.data.size());
+    put16(cd, static_cast<unsigned>(m.name.size()));
+    put16(cd, static_cast<unsigned>(extra.size()));
+    put16(cd, 0);  // comment
+    put16(cd, 0);  // disk
+    put16(cd, 0);  // internal attributes
+    put32(cd, 0);  // external attributes
+    put32(cd, options.zip64 ? saturated : static_cast<std::uint32_t>(offset));
+    cd += m.name + extra;
+  }
+
+  const std::uint64_t cd_offset = zip.size();
+  zip += cd;
+  if (options.zip64) {
+    const std::uint64_t eocd64 = zip.size();
+    put32(zip, 0x06064b50);
+    put64(zip, 44);  // size of the rest of the record
+    put16(zip, 45);
+    put16(zip, 45);
+    put32(zip, 0);
+    put32(zip, 0);
+    put64(zip, members.size());
+    put64(zip, members.size());
+    put64(zip, cd.size());
+    put64(zip, cd_offset);
+    put32(zip, 0x07064b50);  // locator
+    put32(zip, 0);
+    put64(zip, eocd64);
+    put32(zip, 1);
+  }
+  put32(zip, 0x06054b50);
+  put16(zip, 0);
+  put16(zip, 0);
+  put16(zip, options.zip64 ? 0xFFFF : static_cast<unsigned>(members.size()));
+  put16(zip, options.zip64 ? 0xFFFF : static_cast<unsigned>(members.size()));
+  put32(zip, options.zip64 ? saturated : static_cast<std::uint32_t>(cd.size()));
+  put32(zip, options.zip64 ? saturated : static_cast<std::uint32_t>(cd_offset));
+  put16(zip, static_cast<unsigned>(options.comment.size()));
+  zip += options.comment;
+  return zip;
+}
+
+std::string dem_text(int seed) {
+  std::string s = "<?xml version=\"1.0\"?>\n<Dataset>";
+  for (int i = 0; i < 2000; ++i) {
+    s += "\xe5\x9c\xb0\xe8\xa1\xa8\xe9\x9d\xa2," +
+         std::to_string((i * 37 + seed) % 1000) + ".25\n";
+  }
+  return s + "</Dataset>\n";
+}
+
+class TempDir {
+ public:
+  TempDir() {
+    const auto stamp = std::chrono::steady_clock::now().time_since_epoch();
+    path = fs::temp_directory_path() /
+           ("tlgml_zip_test_" + std::to_string(stamp.count()));
+    fs::create_directories(path);
+  }
+  ~TempDir() {
+    std::error_code ec;
+    fs::remove_all(path, ec);
+  }
+  fs::path write(const std::string& name, const std::string& data) const {
+    const auto file = path / name;
+    std::ofstream(file, std::ios::binary) << data;
+    return file;
+  }
+
+  fs::path path;
+};
+
+std::string as_string(const IoBuffer& buffer) {
+  return buffer.empty() ? std::string()
+                        : std::string(buffer.data(), buffer.size() - 1);
+}
+
+std::vector<Member> sample_members() {
+  return {{"FG-GML-5339-45-00-DEM5A-20161001.xml", dem_text(1), true},
+          {"FG-GML-5339-45-01-DEM5A-20161001.xml", dem_text(2), false},
+          {"dir/", "", false},
+          {"empty.xml", "", false},
+          {"readme.txt", "not a DEM", true}};
+}
+
+void check_archive(const fs::path& file, const std::vector<Member>& members) {
+  ZipArchive zip;
+  if (!CHECK(!zip.open(file))) return;
+  if (!CHECK_EQ(zip.entries().size(), members.size())) return;
+  for (const auto& m : members) {
+    auto entry = zip.find(m.name);
+    if (!CHECK(entry != nullptr)) continue;
+    CHECK_EQ(entry->method, m.deflate ? 8u : 0u);
+    CHECK_EQ(entry->uncompressed_size, m.data.size());
+    CHECK_EQ(entry->dos_date, 0x4941u);
+    IoBuffer out;
+    if (!CHECK(!zip.extract(*entry, out))) continue;
+    CHECK(as_string(out) == m.data);
+    CHECK_EQ(out.back(), '\0');
+  }
+  CHECK(zip.find("missing.xml") == nullptr);
+}
+
+void stored_and_deflated(const TempDir& dir) {
+  const auto members = sample_members();
+  check_archive(dir.write("plain.zip", make_zip(members)), members);
+
+  ZipOptions commented;
+  commented.comment = "GSI FG-GML DEM5A, 2016-10-01";
+  check_archive(dir.write("comment.zip", make_zip(members, commented)),
+                members);
+}
+
+void zip64(const TempDir& dir) {
+  ZipOptions options;
+  options.zip64 = true;
+  const auto members = sample_members();
+  check_archive(dir.write("zip64.zip", make_zip(members, options)), members);
+}
+
+void nested(const TempDir& dir) {
+  const auto inner = make_zip({{"m.xml", dem_text(3), true}});
+  const auto innermost = make_zip({{"deep.xml", dem_text(4), false}});
+  const auto middle = make_zip({{"deep.zip", innermost, true}});
+  const auto outer = dir.write(
+      "outer.zip", make_zip({{"top.xml", dem_text(5), true},
+                             {"inner.zip", inner, false},
+                             {"sub/Middle.ZIP", middle, true},
+                             {"notes.txt", "skip", false}}));
+
+  std::vector<SourceFile> sources;
+  CHECK(!list_archive(outer, sources));
+  std::vector<std::string> names;
+  for (const auto& s : sources) names.push_back(s.path.string());
+  const std::string o = outer.string();
+  const std::vector<std::string> expected = {
+      o + "!/top.xml", o + "!/inner.zip!/m.xml",
+      o + "!/sub/Middle.ZIP!/deep.zip!/deep.xml"};
+  if (!CHECK(names == expected)) {
+    for (const auto& n : names) std::cerr << "  " << n << std::endl;
+  }
+  for (const auto& s : sources) CHECK(is_archive_member(s.path));
+
+  const std::pair<std::string, std::string> reads[] = {
+      {o + "!/top.xml", dem_text(5)},
+      {o + "!/inner.zip!/m.xml", dem_text(3)},
+      {o + "!/sub/Middle.ZIP!/deep.zip!/deep.xml", dem_text(4)},
+  };
+  for (const auto& [path, data] : reads) {
+    IoBuffer buffer;
+    CHECK(!read_source(path, buffer));
+    CHECK(as_string(buffer) == data);
+    // Twice, the second time from the archive cache.
+    CHECK(!read_source(path, buffer));
+    CHECK(as_string(buffer) == data);
+  }
+  IoBuffer buffer;
+  CHECK(read_source(o + "!/inner.zip!/none.xml", buffer));
+  CHECK(read_source(o + "!/none.zip!/m.xml", buffer));
+
+  // Rewritten in place: the cache notices and reads the new archive.
+  dir.write("outer.zip", make_zip({{"top.xml", "replaced", false},
+                                   {"inner.zip", inner, false}}));
+  CHECK(!read_source(o + "!/top.xml", buffer));
+  CHECK(as_string(buffer) == "replaced");
+  CHECK(read_source(o + "!/sub/Middle.ZIP!/deep.zip!/deep.xml", buffer));
+}
+
+void names() {
+  CHECK(is_zip_path("a/FG-GML-5339.zip"));
+  CHECK(is_zip_path("a/FG-GML-5339.ZIP"));
+  CHECK(is_zip_path("x.Zip"));
+  CHECK(!is_zip_path("zip"));
+  CHECK(!is_zip_path("a.xml"));
+  CHECK(is_archive_member("a.zip!/b.xml"));
+  CHECK(is_archive_member("A.ZIP!/b.xml"));
+  CHECK(is_archive_member("a.zip!/b.zip!/c.xml"));
+  CHECK(!is_archive_member("a.zip"));
+  CHECK(!is_archive_member("wow!/b.xml"));
+}
+
+void corrupt(const TempDir& dir) {
+  const auto members = sample_members();
+  const auto good = make_zip(members);
+  ZipArchive zip;
+
+  CHECK(zip.open(dir.write("short.zip", "PK\x05\x06")));
+  CHECK(zip.open(dir.write("truncated.zip", good.substr(0, good.size() / 2))));
+
+  // Count beyond what the central directory can hold.
+  auto counted = good;
+  const auto eocd = counted.size() - 22;
+  counted[eocd + 10] = counted[eocd + 8] = '\xff';
+  CHECK(zip.open(dir.write("count.zip", counted)));
+
+  // Central directory offset past the end.
+  auto offset = good;
+  offset[eocd + 19] = '\x7f';
+  CHECK(zip.open(dir.write("offset.zip", offset)));
+
+  // A changed byte in a stored member fails its CRC.
+  auto flipped = good;
+  const auto at = flipped.find("<Dataset>", flipped.find(members[1].name));
+  flipped[at + 1] ^= 0x20;
+  if (CHECK(!zip.open(dir.write("crc.zip", flipped)))) {
+    IoBuffer out;
+    CHECK(zip.extract(*zip.find(members[1].name), out));
+    CHECK(!zip.extract(*zip.find(members[0].name), out));
+  }
+}
+
+}  // namespace
+
+int main() {
+  TempDir dir;
+  stored_and_deflated(dir);
+  zip64(dir);
+  nested(dir);
+  names();
+  corrupt(dir);
+  return gistool::test::result();
+}
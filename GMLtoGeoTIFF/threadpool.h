@@ -3,15 +3,22 @@
 #define CONCURRENT__THREAD_POOL_EXECUTOR_HPP_
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
+#include <tuple>
 #include <type_traits>
 
+#include "numa_alloc.h"
+#include "task.h"
+#include "trace.h"
+
 namespace concurrent {
 
 // This code based on
@@ -25,14 +32,23 @@ class ThreadPoolExecutor {
   using ui64 = std::uint_fast64_t;
 
  public:
+  /**
+   * @brief Construct the thread pool.
+   *
+   * @param thread_count number of workers, 0 means hardware concurrency.
+   * @param pin_threads pin each worker to its own core, so that buffers a task
+   * allocates stay on the worker's NUMA node.
+   */
   ThreadPoolExecutor(
-      const ui32& thread_count = std::thread::hardware_concurrency())
+      const ui32& thread_count = std::thread::hardware_concurrency(),
+      bool pin_threads = false)
       : thread_count_{thread_count ? thread_count
-                                   : std::thread::hardware_concurrency()} {
+                                   : std::thread::hardware_concurrency()},
+        pin_threads_{pin_threads} {
     threads.reset(new std::thread[thread_count_]);
 
     for (ui32 i = 0; i < thread_count_; ++i) {
-      threads[i] = std::thread(&ThreadPoolExecutor::worker, this);
+      threads[i] = std::thread(&ThreadPoolExecutor::worker, this, i);
     }
   }
 
@@ -58,6 +74,15 @@ class ThreadPoolExecutor {
 
   ui32 thread_count() const { return thread_count_; }
 
+  bool pinned() const { return pin_threads_; }
+
+  /**
+   * @brief Total time all workers have spent running tasks.
+   */
+  std::chrono::nanoseconds busy_time() const {
+    return std::chrono::nanoseconds(busy_nanos.load(std::memory_order_relaxed));
+  }
+
 #if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
   /**
    * @brief Submit a function with zero or more arguments and a return value
@@ -71,18 +96,45 @@ class ThreadPoolExecutor {
             typename R = typename std::result_of<
                 std::decay_t<F>(std::decay_t<Args>...)>::type>
 #endif
-  std::future<R> submit(F&& func, const Args&&... args) {
-    auto task = std::make_shared<std::packaged_task<R()>>(
-        [func, args...]() { return func(args...); });
-    auto future = task->get_future();
-
-    push_task([task]() { (*task)(); });
+  std::future<R> submit(F&& func, Args&&... args) {
+    // The packaged_task is moved into the queued Task; only its shared state
+    // is allocated.
+    std::packaged_task<R()> task(
+        [func = std::forward<F>(func),
+         args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+          return std::apply(func, std::move(args));
+        });
+    auto future = task.get_future();
+
+    push_task(Task(std::move(task)));
     return future;
   }
 
- private:
+  /**
+   * @brief Queue a function without creating a future.
+   *
+   * Small callables are stored inline in the task, so this does not allocate
+   * per call. Exceptions thrown by func terminate the program, so report
+   * errors through captured state instead.
+   */
   template <typename F>
-  void push_task(const F& task) {
+  void post(F&& func) {
+    push_task(Task(std::forward<F>(func)));
+  }
+
+ private:
+  void push_task(Task&& task) {
+    if (Tracer::enabled()) {
+      // Time in the queue overlaps other tasks, so it gets its own track.
+      task = Task([task = std::move(task),
+                   queued = Tracer::Clock::now()]() mutable {
+        const auto begin = Tracer::Clock::now();
+        Tracer::async("queued", "pool", queued, begin);
+        task();
+        Tracer::complete("task", "pool", begin, Tracer::Clock::now());
+      });
+    }
+
     {
       const std::lock_guard<std::mutex> lock(tasks_mutex);
 
@@ -90,7 +142,7 @@ class ThreadPoolExecutor {
         throw std::runtime_error("Cannot schedule new task after shutdown.");
       }
 
-      tasks.push(std::function<void()>(task));
+      tasks.push(std::move(task));
     }
 
     condition.notify_one();
@@ -102,9 +154,16 @@ class ThreadPoolExecutor {
    *  Continuously pops tasks out of the queue and executes them, as long as the
    * atomic variable running is set to true.
    */
-  void worker() {
+  void worker(ui32 index) {
+    if (pin_threads_) {
+      pin_current_thread(static_cast<std::uint32_t>(index));
+    }
+    if (Tracer::enabled()) {
+      Tracer::name_thread("worker " + std::to_string(index));
+    }
+
     for (;;) {
-      std::function<void()> task;
+      Task task;
 
       {
         std::unique_lock<std::mutex> lock(tasks_mutex);
@@ -114,11 +173,16 @@ class ThreadPoolExecutor {
           return;
         }
 
-        task = std::move(tasks.front());
-        tasks.pop();
+        task = tasks.pop();
       }
 
+      const auto begin = std::chrono::steady_clock::now();
       task();
+      busy_nanos.fetch_add(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - begin)
+              .count(),
+          std::memory_order_relaxed);
     }
   }
 
@@ -136,16 +200,26 @@ class ThreadPoolExecutor {
    */
   std::atomic<bool> running{true};
 
+  /**
+   * @brief Nanoseconds spent in tasks, summed over the workers.
+   */
+  std::atomic<std::int64_t> busy_nanos{0};
+
   /**
    * @brief A queue of tasks to be executed by the threads.
    */
-  std::queue<std::function<void()>> tasks{};
+  TaskQueue tasks{};
 
   /**
    * @brief The number of threads in the pool.
    */
   const ui32 thread_count_;
 
+  /**
+   * @brief Whether workers are pinned to cores.
+   */
+  const bool pin_threads_;
+
   /**
    * @brief A smart pointer to manage the memory allocated for the threads.
    */
@@ -0,0 +1,65 @@
+
+#ifndef CONCURRENT__THROTTLE_HPP_
+#define CONCURRENT__THROTTLE_HPP_
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace concurrent {
+
+/**
+ * @brief Counting limit on work in flight.
+ *
+ * The producer acquires before queueing work and the consumer releases when
+ * it is done, so memory held by queued work stays bounded.
+ */
+class Throttle {
+  using ui64 = std::uint_fast64_t;
+
+ public:
+  explicit Throttle(ui64 limit) : limit_{limit ? limit : 1} {}
+
+  /**
+   * @brief Block until n units are available. A request larger than the
+   * limit is admitted once nothing else is in flight.
+   */
+  void acquire(ui64 n = 1) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return used_ == 0 || used_ + n <= limit_; });
+    used_ += n;
+  }
+
+  void release(ui64 n = 1) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      used_ -= n;
+    }
+    cv_.notify_all();
+  }
+
+  /**
+   * @brief Block until everything acquired has been released.
+   */
+  void wait_idle() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [&] { return used_ == 0; });
+  }
+
+  ui64 in_use() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return used_;
+  }
+
+  ui64 limit() const { return limit_; }
+
+ private:
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  const ui64 limit_;
+  ui64 used_ = 0;
+};
+
+}  // namespace concurrent
+
+#endif
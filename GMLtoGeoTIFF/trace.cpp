@@ -0,0 +1,149 @@
+#include "trace.h"
+
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace concurrent {
+namespace {
+
+struct Event {
+  const char* name;
+  const char* category;
+  std::int64_t begin_ns;
+  std::int64_t duration_ns;
+  /// 0 for complete events, otherwise the async span id.
+  std::uint64_t id;
+};
+
+struct Ring {
+  std::vector<Event> events;
+  /// Total events appended; only the owning thread stores.
+  std::atomic<std::uint64_t> written{0};
+  std::string thread_name;
+  std::uint32_t tid = 0;
+};
+
+struct State {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<Ring>> rings;
+  std::size_t capacity = 0;
+  Tracer::Clock::time_point origin;
+  std::atomic<std::uint64_t> next_id{1};
+};
+
+// Never destroyed, so rings of threads exiting late stay valid.
+State& state() {
+  static State* s = new State;
+  return *s;
+}
+
+Ring& local_ring() {
+  thread_local std::shared_ptr<Ring> ring;
+  if (!ring) {
+    auto& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    ring = std::make_shared<Ring>();
+    ring->events.resize(s.capacity);
+    ring->tid = static_cast<std::uint32_t>(s.rings.size() + 1);
+    s.rings.push_back(ring);
+  }
+  return *ring;
+}
+
+void append(const char* name, const char* category,
+            Tracer::Clock::time_point begin, Tracer::Clock::time_point end,
+            std::uint64_t id) {
+  auto& ring = local_ring();
+  const auto origin = state().origin;
+  const auto n = ring.written.load(std::memory_order_relaxed);
+  ring.events[n % ring.events.size()] = Event{
+      name, category,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(begin - origin)
+          .count(),
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+          .count(),
+      id};
+  ring.written.store(n + 1, std::memory_order_release);
+}
+
+void write_common(std::ostream& os, const Event& e, const char* phase,
+                  std::int64_t ns, std::uint32_t tid) {
+  os << "{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+     << "\",\"ph\":\"" << phase << "\",\"ts\":" << ns / 1000 << "."
+     << std::setw(3) << std::setfill('0') << ns % 1000 << std::setfill(' ')
+     << ",\"pid\":1,\"tid\":" << tid;
+}
+
+}  // namespace
+
+void Tracer::start(std::size_t events_per_thread) {
+  auto& s = state();
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.capacity = events_per_thread ? events_per_thread : 1;
+    s.origin = Clock::now();
+  }
+  enabled_.store(true, std::memory_order_release);
+}
+
+void Tracer::complete(const char* name, const char* category,
+                      Clock::time_point begin, Clock::time_point end) {
+  append(name, category, begin, end, 0);
+}
+
+void Tracer::async(const char* name, const char* category,
+                   Clock::time_point begin, Clock::time_point end) {
+  append(name, category, begin, end,
+         state().next_id.fetch_add(1, std::memory_order_relaxed));
+}
+
+void Tracer::name_thread(std::string name) {
+  local_ring().thread_name = std::move(name);
+}
+
+bool Tracer::write(const std::string& path) {
+  std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+  if (!ofs) return false;
+
+  auto& s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  ofs << "{\"traceEvents\":[\n";
+  bool first = true;
+  auto separator = [&]() {
+    if (!first) ofs << ",\n";
+    first = false;
+  };
+  for (const auto& ring : s.rings) {
+    if (!ring->thread_name.empty()) {
+      separator();
+      ofs << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+          << ring->tid << ",\"args\":{\"name\":\"" << ring->thread_name
+          << "\"}}";
+    }
+    const auto written = ring->written.load(std::memory_order_acquire);
+    const auto capacity = ring->events.size();
+    const auto first_kept = written > capacity ? written - capacity : 0;
+    for (auto i = first_kept; i < written; ++i) {
+      const auto& e = ring->events[i % capacity];
+      separator();
+      if (e.id == 0) {
+        write_common(ofs, e, "X", e.begin_ns, ring->tid);
+        ofs << ",\"dur\":" << e.duration_ns / 1000 << "." << std::setw(3)
+            << std::setfill('0') << e.duration_ns % 1000 << std::setfill(' ')
+            << "}";
+      } else {
+        write_common(ofs, e, "b", e.begin_ns, ring->tid);
+        ofs << ",\"id\":" << e.id << "},\n";
+        write_common(ofs, e, "e", e.begin_ns + e.duration_ns, ring->tid);
+        ofs << ",\"id\":" << e.id << "}";
+      }
+    }
+  }
+  ofs << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return static_cast<bool>(ofs);
+}
+
+}  // namespace concurrent
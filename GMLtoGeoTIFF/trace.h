@@ -0,0 +1,81 @@
+#ifndef CONCURRENT__TRACE_HPP_
+#define CONCURRENT__TRACE_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace concurrent {
+
+/**
+ * @brief Timeline in Chrome Trace Event format (chrome://tracing, Perfetto).
+ *
+ * Every thread appends to its own fixed size ring: no locks and no
+ * allocation after a thread's first event. A full ring overwrites its oldest
+ * events. Rings outlive their threads and are written by write() once the
+ * work has finished. Names and categories must be string literals, because
+ * only the pointers are stored.
+ */
+class Tracer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Start recording. Call before the threads to be traced do work.
+   */
+  static void start(std::size_t events_per_thread = 1 << 16);
+
+  /**
+   * @brief A span of work on the calling thread; spans of a thread nest.
+   */
+  static void complete(const char* name, const char* category,
+                       Clock::time_point begin, Clock::time_point end);
+
+  /**
+   * @brief A span that overlaps other work (a queue wait, a request in
+   * flight). Shown on its own track instead of the calling thread's.
+   */
+  static void async(const char* name, const char* category,
+                    Clock::time_point begin, Clock::time_point end);
+
+  static void name_thread(std::string name);
+
+  /**
+   * @brief Write all recorded events. False when the file cannot be written.
+   */
+  static bool write(const std::string& path);
+
+ private:
+  static inline std::atomic<bool> enabled_{false};
+};
+
+/**
+ * @brief Records the enclosing scope as a complete event when tracing.
+ */
+class TraceScope {
+ public:
+  TraceScope(const char* name, const char* category)
+      : name_(name), category_(category) {
+    if (Tracer::enabled()) begin_ = Tracer::Clock::now();
+  }
+  ~TraceScope() {
+    if (Tracer::enabled() && begin_ != Tracer::Clock::time_point()) {
+      Tracer::complete(name_, category_, begin_, Tracer::Clock::now());
+    }
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+ private:
+  const char* name_;
+  const char* category_;
+  Tracer::Clock::time_point begin_{};
+};
+
+}  // namespace concurrent
+
+#endif